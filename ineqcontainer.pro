@@ -17,6 +17,7 @@
 ########################################################################################################################
 
 TEMPLATE = subdirs
-SUBDIRS = ineqcontainer test
+SUBDIRS = ineqcontainer test ineqcontainer_tool
 
 test.depends = ineqcontainer
+ineqcontainer_tool.depends = ineqcontainer
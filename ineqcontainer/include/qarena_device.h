@@ -0,0 +1,207 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref QArenaDevice class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineqcontainer */
+
+#ifndef QARENA_DEVICE_H
+#define QARENA_DEVICE_H
+
+#include <QList>
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+
+/**
+ * Class that provides an in-memory, random access, QIODevice.  Data is stored in a list of fixed size chunks so the
+ * device can grow to large sizes without reallocating or copying previously written data.  The device supports
+ * truncation and can be used as the backing store for a \ref QContainer.  When a \ref QContainer is backed by this
+ * device, the container accesses the chunks directly, bypassing the block cache and write combining buffer.
+ *
+ * Data held by the device can be written to any other QIODevice, chunk by chunk, using \ref QArenaDevice::writeTo.
+ */
+class QArenaDevice:public QIODevice {
+    Q_OBJECT
+
+    public:
+        /**
+         * The default chunk size, in bytes.
+         */
+        static constexpr unsigned defaultChunkSize = 1024 * 1024;
+
+        /**
+         * Constructor
+         *
+         * \param[in] parent Pointer to the parent object.
+         */
+        QArenaDevice(QObject* parent = Q_NULLPTR);
+
+        /**
+         * Constructor
+         *
+         * \param[in] chunkSize The size of each chunk of storage, in bytes.
+         *
+         * \param[in] parent    Pointer to the parent object.
+         */
+        QArenaDevice(unsigned chunkSize, QObject* parent = Q_NULLPTR);
+
+        ~QArenaDevice() override;
+
+        /**
+         * Method you can use to determine the size of each chunk of storage.
+         *
+         * \return Returns the chunk size, in bytes.
+         */
+        unsigned chunkSize() const;
+
+        /**
+         * Method you can use to open the device.  The QIODevice::Truncate flag discards all data held by the device.
+         * The QIODevice::Append flag positions the device at the end of the data.
+         *
+         * \param[in] mode The open mode.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool open(OpenMode mode) override;
+
+        /**
+         * Method you can use to determine the current size of the data held by the device.
+         *
+         * \return Returns the size of the data, in bytes.
+         */
+        qint64 size() const override;
+
+        /**
+         * Method you can use to change the size of the data held by the device.  Growing the device fills the new
+         * space with zeros.  Shrinking the device releases chunks that are no longer needed.
+         *
+         * \param[in] newSize The new size, in bytes.
+         *
+         * \return Returns true on success, returns false if the size is invalid.
+         */
+        bool resize(qint64 newSize);
+
+        /**
+         * Method you can use to discard all data held by the device.
+         */
+        void clear();
+
+        /**
+         * Method you can use to read data at a specific offset without changing the device position.
+         *
+         * \param[in] offset  The zero based offset of the first byte to read.
+         *
+         * \param[in] data    The buffer to receive the data.
+         *
+         * \param[in] maxSize The maximum number of bytes to read.
+         *
+         * \return Returns the number of bytes read.  A value of -1 is returned if the offset is invalid.
+         */
+        qint64 readAt(qint64 offset, char* data, qint64 maxSize) const;
+
+        /**
+         * Method you can use to write data at a specific offset without changing the device position.  Writing past
+         * the end of the device grows the device, filling any gap with zeros.
+         *
+         * \param[in] offset The zero based offset of the first byte to write.
+         *
+         * \param[in] data   The data to be written.
+         *
+         * \param[in] size   The number of bytes to write.
+         *
+         * \return Returns the number of bytes written.  A value of -1 is returned if the offset is invalid.
+         */
+        qint64 writeAt(qint64 offset, const char* data, qint64 size);
+
+        /**
+         * Method you can use to write the data held by this device to another device.  Data is written directly from
+         * each chunk, without intermediate copies.  The position of this device is not modified.
+         *
+         * \param[in] device The device to receive the data.  The device must be open for writing.
+         *
+         * \return Returns the number of bytes written.  A value of -1 is returned on error.
+         */
+        qint64 writeTo(QIODevice* device) const;
+
+        /**
+         * Method you can use to obtain a copy of the data held by this device as a single byte array.
+         *
+         * \return Returns a copy of the data.
+         */
+        QByteArray toByteArray() const;
+
+    protected:
+        /**
+         * Method that reads data from the current position.
+         *
+         * \param[in] data    The buffer to receive the data.
+         *
+         * \param[in] maxSize The maximum number of bytes to read.
+         *
+         * \return Returns the number of bytes read.
+         */
+        qint64 readData(char* data, qint64 maxSize) override;
+
+        /**
+         * Method that writes data at the current position.
+         *
+         * \param[in] data The data to be written.
+         *
+         * \param[in] size The number of bytes to write.
+         *
+         * \return Returns the number of bytes written.
+         */
+        qint64 writeData(const char* data, qint64 size) override;
+
+    private:
+        /**
+         * Method that allocates enough chunks to hold a given number of bytes.  The contents of newly allocated
+         * chunks are undefined.
+         *
+         * \param[in] newSize The number of bytes that must fit in the allocated chunks.
+         */
+        void allocate(qint64 newSize);
+
+        /**
+         * Method that grows the storage to hold a given number of bytes.  Bytes between the current size and the new
+         * size are filled with zeros.
+         *
+         * \param[in] newSize The new size, in bytes.  The value must be larger than the current size.
+         */
+        void grow(qint64 newSize);
+
+        /**
+         * The size of each chunk, in bytes.
+         */
+        unsigned currentChunkSize;
+
+        /**
+         * The list of chunks.  Each chunk is allocated at the full chunk size.
+         */
+        QList<QByteArray> chunks;
+
+        /**
+         * The current size of the data, in bytes.
+         */
+        qint64 currentSize;
+};
+
+#endif
@@ -26,25 +26,211 @@
 #define QCONTAINER_H
 
 #include <QMap>
+#include <QList>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
 #include <QIODevice>
 #include <QPointer>
 #include <QObject>
+#include <QMutex>
+#include <QThreadPool>
+
+#include <memory>
 
 #include <container_container.h>
 
-class QVirtualFile;
+#include "qvirtual_file.h"
+#include "qvirtual_file_handle.h"
+
+class QContainerBlockCache;
+class QArenaDevice;
+class QFileDevice;
+class QContainerSnapshotPages;
 
 /**
  * Class that extends and Qt-ify's the Container::Container class to provide an interface to an underlying QIODevice.
- * Note that the default implementation does not support file truncation.
+ * File truncation is supported when the underlying device is a QFileDevice (such as QFile or QSaveFile), a QBuffer,
+ * or a \ref QArenaDevice.  Other devices do not support file truncation.  Containers built in memory should use a
+ * \ref QArenaDevice which is accessed directly by the container and grows without reallocating existing data.
+ *
+ * Containers stored in files can be accessed using positional I/O or, for read-only files, through a memory mapping
+ * of the file by selecting an I/O mode prior to calling \ref QContainer::open.  The container tracks its own size and
+ * position, so the underlying device must not be modified by other means while the container is open.
+ *
+ * The container can optionally maintain a least-recently-used cache of blocks read from the underlying device.  The
+ * cache is shared by all virtual files in the container and is disabled by default.  When the cache is enabled,
+ * reads from virtual files marked with the \ref QVirtualFile::AccessHint::SEQUENTIAL hint trigger adaptive read-ahead
+ * into the cache.  Access hints and read-ahead state are tracked per virtual file so readers of different virtual
+ * files do not disturb each other.
+ *
+ * Small writes can also be merged into larger device writes by enabling write combining.  Combined data is written
+ * to the device in order, before any non-adjacent write, read of the same range, truncation or flush, so the ordering
+ * of data and directory updates seen by the device is preserved.
+ *
+ * Sequential devices, such as QProcess or QLocalSocket, are supported by staging the container in a
+ * \ref QArenaDevice.  When reading, the device is drained into the arena when the container is opened.  When writing,
+ * the staged container is written to the device, in a single forward pass, when the container is closed.
+ *
+ * Streaming is not incremental.  The container engine owns the on-disk layout, including the location of the
+ * directory, which may follow the data, so no virtual file can be read until the whole stream has arrived and
+ * nothing can be emitted until the directory is final.  The whole container is therefore held in memory, in both
+ * directions, and memory use grows with the size of the container.  Use a random access device for containers that
+ * do not fit comfortably in memory.
+ *
+ * Virtual files support asynchronous operations that are executed on a dedicated, per-container, I/O thread.  All
+ * accesses to the container engine, whether synchronous or asynchronous, are serialized by a single container lock.
+ * Use \ref QContainer::openReader to obtain independent read-only containers for parallel reads from several threads.
+ *
+ * Related updates can be grouped into a transaction using \ref QContainer::beginTransaction.  While a transaction is
+ * active, writes and truncations are held in a page overlay and flushes are deferred.  Committing the transaction
+ * writes the overlay to the device followed by a single durable flush.  Rolling back the transaction, or closing the
+ * container without committing, discards the overlay and restores the container to its state at the start of the
+ * transaction.
+ *
+ * Fragmented containers can be compacted, while they remain open, by repeatedly calling
+ * \ref QContainer::compactStep.  A pass first samples where each virtual file is stored, then moves the files that
+ * are fragmented or that follow free space, one chunk at a time, until a byte or time budget is used.  Moving a file
+ * lets the container engine place it in one contiguous run and release the space it previously occupied.
+ *
+ * Use \ref QContainer::snapshot to obtain a consistent, read-only, view of a file based container while it continues
+ * to be updated.  Before the container overwrites or truncates data visible to a snapshot, the original pages are
+ * preserved for the snapshot.  Snapshots read from their own file handle so reads from a snapshot do not take the
+ * container lock.
+ *
+ * Virtual files whose names start with \ref QContainer::metadataPrefix hold container metadata, such as the
+ * compression manifest and the files used by compaction.  They are not listed by \ref QContainer::directory,
+ * \ref QContainer::handles, \ref QContainer::listPrefix or \ref QContainer::glob and are not extracted.  Metadata
+ * files can still be read and written by name.
  */
 class QContainer:public QObject, public Container::Container {
+    friend class QVirtualFile;
+    friend class QVirtualFileHandle;
+
     public:
         /**
          * Type used for maps of virtual files by name.
          */
         typedef QMap<QString, QPointer<QVirtualFile>> DirectoryMap;
 
+        /**
+         * Type used for maps of virtual file handles by name.
+         */
+        typedef QMap<QString, QVirtualFileHandle> HandleMap;
+
+        /**
+         * The prefix reserved for virtual files holding container metadata.  Files with this prefix are not listed.
+         */
+        static constexpr const char* metadataPrefix = ".ineqcontainer/";
+
+        /**
+         * Enumeration of supported methods used to access the underlying device.
+         */
+        enum class IoMode {
+            /**
+             * Indicates that all accesses are performed using the QIODevice seek, read, and write methods.
+             */
+            DEVICE,
+
+            /**
+             * Indicates that reads and writes should be issued as positional (pread/pwrite style) operations
+             * directly against the file descriptor of the underlying device.  The container tracks its own size and
+             * position so each access requires a single system call.  This mode is only available when the device
+             * is an open QFileDevice on a platform that supports positional I/O.  The container will fall back to
+             * \ref QContainer::IoMode::DEVICE if the device has no file descriptor, the platform does not support
+             * positional I/O, or buffered data can not be flushed to the device.
+             */
+            POSITIONAL,
+
+            /**
+             * Indicates that reads should be serviced directly from a memory mapping of the underlying device.  This
+             * mode is only available when the device is a non-empty QFileDevice opened for read-only access.  If the
+             * device is writable, is empty, or can not be mapped, the container falls back to
+             * \ref QContainer::IoMode::POSITIONAL and, where positional I/O can not be used either, to
+             * \ref QContainer::IoMode::DEVICE.
+             */
+            MAPPED
+        };
+
+        /**
+         * Enumeration of supported methods used to flush data to the underlying device.
+         */
+        enum class FlushMode {
+            /**
+             * Indicates that flushing should push any data buffered by the QIODevice to the operating system.
+             */
+            BUFFERED,
+
+            /**
+             * Indicates that flushing should push any buffered data to the operating system and then wait for the
+             * operating system to commit the data to the storage media (fsync).  This mode is only meaningful for
+             * QFileDevice instances and behaves as \ref QContainer::FlushMode::BUFFERED for other devices.
+             */
+            DURABLE
+        };
+
+        /**
+         * Enumeration of directions used when the underlying device is sequential.
+         */
+        enum class StreamMode {
+            /**
+             * Indicates that the direction should be selected from the device open mode.  Readable devices are read
+             * and write-only devices are written.
+             */
+            AUTOMATIC,
+
+            /**
+             * Indicates that the container should be read from the sequential device.
+             */
+            READ,
+
+            /**
+             * Indicates that the container should be written to the sequential device.
+             */
+            WRITE
+        };
+
+        /**
+         * Structure holding space usage statistics for the container.
+         *
+         * The structure does not report free blocks, the number of extents per virtual file or a fragmentation
+         * score.  The container engine keeps its allocation map private and exposes only the name and size of each
+         * virtual file, so this information can not be obtained from metadata.  The only way to locate stored data
+         * is to read it and trace the device offsets used, as \ref compactStep does, which reads payload data.
+         */
+        struct Statistics {
+            /**
+             * The total size of the container, in bytes.
+             */
+            unsigned long long totalSize;
+
+            /**
+             * The number of bytes held by virtual files.
+             */
+            unsigned long long liveSize;
+
+            /**
+             * The number of bytes not held by virtual files.  This includes the container header, the directory and
+             * any space released by erased or truncated virtual files.
+             */
+            unsigned long long slackSize;
+
+            /**
+             * The size of each virtual file, in bytes, keyed by name.
+             */
+            QMap<QString, unsigned long long> fileSizes;
+
+            /**
+             * The fraction of the container not held by virtual files, between 0 and 1.  The value is
+             * \ref slackSize divided by \ref totalSize and includes the fixed cost of the header and directory, so it
+             * approaches 1 for small containers.  The value does not describe how virtual files are laid out and a
+             * file stored in many separate runs does not raise it.  Large values in large containers indicate that
+             * erased or truncated data could be reclaimed by compaction.
+             */
+            double slackRatio;
+        };
+
         /**
          * Constructor
          *
@@ -85,17 +271,169 @@ class QContainer:public QObject, public Container::Container {
          */
         QIODevice* device();
 
+        /**
+         * Method you can use to select the method used to access the underlying device.  The new mode will take
+         * effect the next time the container is opened.  Use \ref QContainer::ioMode to determine the mode actually
+         * selected once the container is open.
+         *
+         * \param[in] newIoMode The desired I/O mode.
+         */
+        void setIoMode(IoMode newIoMode);
+
+        /**
+         * Method you can use to determine the I/O mode requested by \ref QContainer::setIoMode.
+         *
+         * \return Returns the requested I/O mode.
+         */
+        IoMode requestedIoMode() const;
+
+        /**
+         * Method you can use to determine the I/O mode currently being used to access the underlying device.  The
+         * value may differ from the requested I/O mode if the requested mode is not supported by the device.
+         *
+         * \return Returns the I/O mode currently in use.
+         */
+        IoMode ioMode() const;
+
+        /**
+         * Method you can use to select how data is flushed to the underlying device.  The default is
+         * \ref QContainer::FlushMode::BUFFERED.
+         *
+         * \param[in] newFlushMode The desired flush mode.
+         */
+        void setFlushMode(FlushMode newFlushMode);
+
+        /**
+         * Method you can use to determine how data is flushed to the underlying device.
+         *
+         * \return Returns the current flush mode.
+         */
+        FlushMode flushMode() const;
+
+        /**
+         * Method you can use to select the direction used when the underlying device is sequential.  The default is
+         * \ref QContainer::StreamMode::AUTOMATIC.  Use \ref QContainer::StreamMode::WRITE to write a container to a
+         * device, such as a socket, that is open for both reading and writing.  The value is ignored for random
+         * access devices.  The whole container is staged in memory in either direction.
+         *
+         * \param[in] newStreamMode The desired stream mode.
+         */
+        void setStreamMode(StreamMode newStreamMode);
+
+        /**
+         * Method you can use to determine the direction used when the underlying device is sequential.
+         *
+         * \return Returns the current stream mode.
+         */
+        StreamMode streamMode() const;
+
+        /**
+         * Method you can use to set the memory budget for the block cache.  The block cache holds recently read
+         * blocks from the underlying device and is shared by all virtual files in the container.  Blocks are evicted
+         * in least-recently-used order.
+         *
+         * \param[in] newBlockCacheSize The maximum number of bytes to hold in the block cache.  A value of zero
+         *                              disables the block cache.
+         */
+        void setBlockCacheSize(unsigned long long newBlockCacheSize);
+
+        /**
+         * Method you can use to determine the memory budget for the block cache.
+         *
+         * \return Returns the maximum number of bytes to hold in the block cache.
+         */
+        unsigned long long blockCacheSize() const;
+
+        /**
+         * Method you can use to determine the number of block reads that were serviced by the block cache.
+         *
+         * \return Returns the number of block cache hits.
+         */
+        unsigned long long blockCacheHits() const;
+
+        /**
+         * Method you can use to determine the number of block reads that required access to the underlying device.
+         *
+         * \return Returns the number of block cache misses.
+         */
+        unsigned long long blockCacheMisses() const;
+
+        /**
+         * Method you can use to reset the block cache hit and miss counters.
+         */
+        void resetBlockCacheStatistics();
+
+        /**
+         * Method you can use to set the maximum read-ahead window used for sequential virtual files.  The window
+         * starts small and doubles on each sequential read up to this limit.  Read-ahead is only performed when the
+         * block cache is enabled and is limited to a quarter of the block cache size.
+         *
+         * \param[in] newMaximumReadAhead The maximum read-ahead window, in bytes.  A value of zero disables
+         *                                read-ahead.
+         */
+        void setMaximumReadAhead(unsigned long long newMaximumReadAhead);
+
+        /**
+         * Method you can use to determine the maximum read-ahead window used for sequential virtual files.
+         *
+         * \return Returns the maximum read-ahead window, in bytes.
+         */
+        unsigned long long maximumReadAhead() const;
+
+        /**
+         * Method you can use to set the size of the write combining buffer.  Writes that overlap or directly follow
+         * previously buffered data, from any virtual file, are merged into the buffer and sent to the device as a
+         * single sequential write.
+         *
+         * \param[in] newWriteCombiningSize The size of the write combining buffer, in bytes.  A value of zero
+         *                                  disables write combining.  Write combining is disabled by default.
+         *
+         * \return Returns true on success.  Returns false if data already held in the write combining buffer could
+         *         not be written to the device.
+         */
+        bool setWriteCombiningSize(unsigned long long newWriteCombiningSize);
+
+        /**
+         * Method you can use to determine the size of the write combining buffer.
+         *
+         * \return Returns the size of the write combining buffer, in bytes.
+         */
+        unsigned long long writeCombiningSize() const;
+
+        /**
+         * Method you can use to enable or disable lazy opening.  When lazy opening is enabled, \ref QContainer::open
+         * only confirms that the identifier field in the header of a non-empty, random access device holds the file
+         * identifier.  Loading and validating the directory is deferred until the directory or a virtual file is
+         * first accessed or until \ref QContainer::validate is called.  If the deferred open fails, accessors return
+         * empty results and operations fail.  Lazy opening is disabled by default.
+         *
+         * Lazy opening only defers work.  The container engine can only load its directory as a whole, so the first
+         * access to any virtual file, including a lookup by name, loads and validates the entire directory.  Lazy
+         * opening helps callers that open many containers and use few of them, not callers that need one file from a
+         * large container.
+         *
+         * \param[in] nowLazyOpen If true, lazy opening will be enabled.  If false, lazy opening will be disabled.
+         */
+        void setLazyOpen(bool nowLazyOpen);
+
+        /**
+         * Method you can use to determine if lazy opening is enabled.
+         *
+         * \return Returns true if lazy opening is enabled.  Returns false if lazy opening is disabled.
+         */
+        bool lazyOpen() const;
+
         /**
          * Method that should be called to open the container.  If the container is empty, the method will attempt
          * to create a file header.  If the container is not empty, the method will verify that the file container
-         * is valid.
+         * is valid.  See \ref QContainer::setLazyOpen for details on deferring validation.
          *
          * You must call this method before performing any operations on the container.  You must also be sure that
          * there are no Container::VirtualFile instances instantiated for this container when this method is called.
          *
          * \return Returns true on success, returns false on error.
          */
-        bool open();
+        virtual bool open();
 
         /**
          * Method that should be called after all file operations are complete.  Forces all underlying virtual files
@@ -103,136 +441,1457 @@ class QContainer:public QObject, public Container::Container {
          *
          * \return Returns true on success, returns false on error.
          */
-        bool close();
+        virtual bool close();
+
+        /**
+         * Method you can use to load and validate the container directory if loading was deferred by lazy opening.
+         *
+         * \return Returns true if the container is open and valid.  Returns false if the container is not open or
+         *         could not be validated.
+         */
+        bool validate();
+
+        /**
+         * Method you can use to open an additional, independent, read-only container over the same file.  Each
+         * reader has its own device, I/O state and lock, so virtual files can be read from several threads in
+         * parallel by giving each thread its own reader.  Readers use positional I/O, rather than a memory mapping,
+         * so a reader is not affected if this container later shrinks the file.
+         *
+         * Staged, combined and engine buffered writes are committed and the directory is written to the file before
+         * the reader is opened so the reader sees the current contents of this container.  If a transaction is
+         * active, the reader sees the state at the start of the transaction.  Changes made after the reader is
+         * opened are not guaranteed to be visible to the reader.  Readers are only supported when the underlying
+         * device is a QFileDevice with a file name.
+         *
+         * Virtual files should be obtained from a reader on the thread that owns the reader.  The resulting
+         * \ref QVirtualFile instances can then be used from a worker thread.
+         *
+         * \param[in] parent Pointer to the parent object for the reader.
+         *
+         * \return Returns a pointer to the opened reader.  The caller is responsible for closing and deleting the
+         *         reader.  A null pointer is returned if a reader could not be opened.
+         */
+        QContainer* openReader(QObject* parent = Q_NULLPTR);
+
+        /**
+         * Method you can use to take a read-only snapshot of the container.  The snapshot presents the container as
+         * it was when the snapshot was taken, regardless of later updates made through this container.  Pages
+         * overwritten by this container are preserved until the snapshot is deleted.  The first 64 MiB of preserved
+         * pages are held in memory and the remainder in a temporary file.  Snapshots are only supported when the
+         * underlying device is a QFileDevice with a file name.
+         *
+         * Staged, combined and engine buffered writes are committed and the directory is written to the file before
+         * the snapshot is taken, so virtual files created, erased or resized since the container was opened are
+         * visible to the snapshot.  Mapped containers do not rewrite their directory while open, so the snapshot of
+         * a mapped container sees the directory as it was when the container was opened.  If a transaction is
+         * active, the snapshot sees the state at the start of the transaction.
+         *
+         * \param[in] parent Pointer to the parent object for the snapshot.
+         *
+         * \return Returns a pointer to the opened snapshot.  The caller is responsible for closing and deleting the
+         *         snapshot.  A null pointer is returned if a snapshot could not be taken.
+         */
+        QContainer* snapshot(QObject* parent = Q_NULLPTR);
+
+        /**
+         * Method you can use to start a transaction.  Updates to the container are held in memory until the
+         * transaction is committed or rolled back.  Transactions are not supported on memory mapped containers.
+         *
+         * If virtual files were created, erased or written outside of a transaction since the directory was last
+         * written, the directory is written first so that rolling back restores that state.  Starting a transaction
+         * on an unchanged container, including directly after a commit, does not touch the device.
+         *
+         * \return Returns true on success.  Returns false if the container is not open, is memory mapped, or a
+         *         transaction is already active.
+         */
+        bool beginTransaction();
+
+        /**
+         * Method you can use to commit the active transaction.  Data staged by virtual files, data held by the
+         * container engine and the container directory are added to the transaction before the transaction is
+         * written to the device, so virtual files created or erased during the transaction are committed together
+         * with their data.  The device is flushed once, durably, after all updates are written.
+         *
+         * \return Returns true on success.  Returns false if no transaction is active or the transaction could not be
+         *         written.  On failure the transaction remains active so it can be committed again or rolled back.
+         */
+        bool commitTransaction();
+
+        /**
+         * Method you can use to discard the active transaction.  The container directory is reloaded from the device
+         * so virtual files created during the transaction are removed from the directory.
+         *
+         * \return Returns true on success.  Returns false if no transaction is active or the directory could not be
+         *         reloaded.
+         */
+        bool rollbackTransaction();
+
+        /**
+         * Method you can use to determine if a transaction is active.
+         *
+         * \return Returns true if a transaction is active.  Returns false if no transaction is active.
+         */
+        bool inTransaction() const;
+
+        /**
+         * Method you can use to perform one step of an incremental compaction.  The step resumes where the previous
+         * step stopped and ends once the byte or time budget is used.  At least one chunk of
+         * \ref compactionChunkSize bytes is copied per step so a pass always makes progress.
+         *
+         * A pass starts by sampling where the data of each virtual file is stored.  Files that are stored in one run
+         * directly after the preceding file are left in place.  The remaining files are copied to a hidden file and
+         * back again, chunk by chunk, which lets the container engine place them in one contiguous run.  Writes to a
+         * file while it is being moved restart the copy in progress.  Virtual files that are open when they are
+         * reached are skipped.  The directory is written at the end of each pass so the engine can release the space
+         * freed at the end of the container.
+         *
+         * Operations that replace, erase or create a virtual file, and operations that write the directory, complete
+         * or abandon the move in progress first.  As with any other update, a move becomes durable when the
+         * directory is next written.  If a transaction is active, the step becomes part of the transaction.  Steps
+         * are not performed on mapped or read-only containers.
+         *
+         * The hidden copy is named after the file it holds and the copy back is marked by a second, empty, hidden
+         * file.  If the process ends while a file is being copied back, the hidden copy is used in place of the file
+         * when the container is next opened and the move is completed once the container can be written.  A copy
+         * that had not reached the copy back is discarded since the file itself is intact.
+         *
+         * Compaction is limited by what the container engine exposes.  The engine can not rename a virtual file so
+         * each moved file is copied twice.  The engine does not report where data is stored so the layout is
+         * inferred from sampled reads and may miss small gaps or fragments.  The engine only releases free space at
+         * the end of the container, when the directory is written, so space freed elsewhere is reused by later
+         * writes rather than returned to the file system.
+         *
+         * \param[in] byteBudget The number of bytes to copy before the step ends.  A value of 0 disables the limit.
+         *
+         * \param[in] timeBudget The time, in milliseconds, to spend before the step ends.  A value of 0 disables the
+         *                       limit.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool compactStep(unsigned long long byteBudget = 0, unsigned long timeBudget = 0);
+
+        /**
+         * Method you can use to determine if the last compaction step completed a pass over the container.  The next
+         * step starts a new pass.
+         *
+         * \return Returns true if the last step completed a pass.  Returns false if the pass is still in progress or
+         *         no step has been performed.
+         */
+        bool compactionComplete() const;
+
+        /**
+         * Method you can use to obtain space usage statistics for the container.  The statistics are calculated from
+         * the directory and the container size.  No virtual file data is read.  See \ref Statistics for the layout
+         * information that is not available.
+         *
+         * \return Returns the container statistics.  All values are zero if the container is not open.
+         */
+        Statistics statistics();
 
         /**
-         * Returns a directory of all the streams in the container.
+         * Returns a directory of all the streams in the container.  The directory is maintained incrementally as
+         * virtual files are created and erased so this method does not rebuild the directory.  Note that this method
+         * creates a \ref QVirtualFile instance for every stream on first use.  Use \ref QContainer::handles for large
+         * containers.  Metadata files are not listed.
          *
          * \return Returns a map, keyed by the stream name, of streams in the container.
          */
         DirectoryMap directory();
 
         /**
-         * Method you can call to create a new virtual file in the container.  The newly created file will be
-         * added to the directory.
-         *
-         * \param[in] newVirtualFileName The new name to assign to this file.
+         * Returns lightweight handles to all the streams in the container.  The \ref QVirtualFile instance for a
+         * stream is only created when the stream is accessed through its handle.  Metadata files are not listed.
          *
-         * \return Returns the newly created virtual file.  A null pointer is returned on error.
+         * \return Returns a map, keyed by the stream name, of handles to streams in the container.
          */
-        QPointer<QVirtualFile> newVirtualFile(const QString& newVirtualFileName);
+        HandleMap handles();
 
         /**
-         * Method you can use to obtain an error string from the last operation performed.
+         * Method you can use to obtain a lightweight handle to a virtual file by name.
          *
-         * \return Returns a description of the error.
+         * \param[in] virtualFileName The name of the desired virtual file.
+         *
+         * \return Returns a handle to the requested virtual file.  An invalid handle is returned if the file does not
+         *         exist or is a metadata file.
          */
-        QString errorString() const;
+        QVirtualFileHandle handle(const QString& virtualFileName);
 
-    protected:
         /**
-         * Method that is called to determine the current size of the underlying data store, in bytes.
+         * Method you can use to obtain handles to all streams whose names start with a given prefix.  The lookup uses
+         * the sorted directory so only the matching entries are visited.  Metadata files are not listed.
          *
-         * \return Returns the size of the underlying data store, in bytes.  A negative value should be returned if
-         *         an error occurs.
+         * The sorted name index is held in memory and is not stored in the container.  It is rebuilt from the
+         * engine directory each time the directory is loaded.  The engine reads its whole directory at that point
+         * anyway, so building the index adds one sorted insertion per name and no device I/O.
+         *
+         * \param[in] prefix The desired name prefix, for example "textures/".
+         *
+         * \return Returns a map, keyed by the stream name, of handles to the matching streams.
          */
-        long long size() final;
+        HandleMap listPrefix(const QString& prefix);
 
         /**
-         * Method that is called to seek to a position in the underlying data store prior to performing a call to
-         * Container::Container::read, Container::Container::write, or Container::Container::truncate.
+         * Method you can use to obtain handles to all streams whose names match a wildcard pattern.  The pattern
+         * must match the entire name and is interpreted the same way on every platform:
          *
-         * \param[in] newOffset The new position in the underlying data store to seek to.
+         * - '*' matches any sequence of characters, including '/', so "*.png" matches "textures/a.png".
+         * - '?' matches any single character, including '/'.
+         * - "[...]" matches any one of the enclosed characters.  Ranges such as "[a-z]" are supported and a leading
+         *   '!' negates the class.  A ']' immediately following the opening bracket is taken literally.
+         * - All other characters, including '\\' and an unterminated '[', match themselves.
          *
-         * \return Returns the status from this operation.
+         * Only entries starting with the literal text preceding the first wildcard character are examined.  Metadata
+         * files are not listed.
+         *
+         * \param[in] pattern The wildcard pattern, for example "*.png".
+         *
+         * \return Returns a map, keyed by the stream name, of handles to the matching streams.
          */
-        ::Container::Status setPosition(unsigned long long newOffset) final;
+        HandleMap glob(const QString& pattern);
 
         /**
-         * Method that is called to seek to the last just past the last byte in the underlying data store.
+         * Method you can use to locate a virtual file by name.
          *
-         * \return Returns the status from this operation.
+         * \param[in] virtualFileName The name of the desired virtual file.
+         *
+         * \return Returns the requested virtual file.  A null pointer is returned if the file does not exist.
          */
-        ::Container::Status setPositionLast() final;
+        QPointer<QVirtualFile> virtualFile(const QString& virtualFileName);
 
         /**
-         * Method that is called to determine the current byte offset from the beginning of the container.
+         * Method you can use to create a virtual file from a block of data in a single operation.  The data is
+         * written under a single acquisition of the container lock so the container engine can allocate space for
+         * the whole file in one run.  No \ref QVirtualFile instance is created.  An existing virtual file with the
+         * same name is replaced.
          *
-         * \return Returns the current byte offset from the beginning of the container.
+         * \param[in] virtualFileName The name of the virtual file.
+         *
+         * \param[in] data            The contents of the virtual file.
+         *
+         * \return Returns true on success.  Returns false if the file could not be written or if an existing file
+         *         with the same name is open.
          */
-        unsigned long long position() const final;
+        bool writeVirtualFile(const QString& virtualFileName, const QByteArray& data);
 
         /**
-         * Method that is called to read a specified number of bytes of data from the underlying data store.
+         * Method you can use to append a block of data to an existing virtual file in a single operation.  The data
+         * is written under a single acquisition of the container lock.  No \ref QVirtualFile instance is created.
+         * Use this method after \ref QContainer::writeVirtualFile to build a large file in pieces.  Data staged by a
+         * device for the file is committed first so the new data is placed after it.
          *
-         * \param[in] buffer       The buffer to receive the data.  The buffer is guaranteed to be large enough to
-         *                         hold all the requested data.
+         * \param[in] virtualFileName The name of the virtual file.
          *
-         * \param[in] desiredCount The number of bytes that are expected to be read.
+         * \param[in] data            The data to be appended.
          *
-         * \return Returns the status from the read operation.  An instance of Container::ReadSuccessful should be
-         *         returned on success.
+         * \return Returns true on success.  Returns false if the file does not exist, is open or could not be
+         *         written.
          */
-        ::Container::Status read(std::uint8_t* buffer, unsigned desiredCount) final;
+        bool appendVirtualFile(const QString& virtualFileName, const QByteArray& data);
 
         /**
-         * Method that is called to write a specified number of bytes of data to the underlying data store.
+         * Method you can use to read the entire contents of a virtual file in a single operation.  The data is read
+         * under a single acquisition of the container lock.  No \ref QVirtualFile instance is created.  Data staged
+         * by a device for the file is committed first.
          *
-         * \param[in] buffer The buffer holding the data to be written.
+         * \param[in]  virtualFileName The name of the virtual file.
          *
-         * \param[in] count  The number of bytes to be written.
+         * \param[out] data            The contents of the virtual file.
          *
-         * \return Returns the status from the write operation.  An instance of Container::Status should be returned
-         *         on success.
+         * \return Returns true on success.  Returns false if the file does not exist or could not be read.
          */
-        ::Container::Status write(const std::uint8_t* buffer, unsigned count) final;
+        bool readVirtualFile(const QString& virtualFileName, QByteArray& data);
 
         /**
-         * Method you can overload to indicate whether the derived class supports file truncation.
+         * Method you can use to read part of a virtual file in a single operation.  Use this method to stream large
+         * virtual files in pieces.  No \ref QVirtualFile instance is created.  Data staged by a device for the file
+         * is committed first.
          *
-         * \return Returns true if file truncation is supported.  Returns false if file truncation is not supported.
+         * \param[in]  virtualFileName The name of the virtual file.
+         *
+         * \param[in]  offset          The offset of the first byte to read.
+         *
+         * \param[in]  maximumLength   The maximum number of bytes to read.  The value must not exceed the maximum
+         *                             size of a QByteArray.
+         *
+         * \param[out] data            The data read.  Fewer bytes than requested are returned at the end of the
+         *                             file and none are returned past the end of the file.
+         *
+         * \return Returns true on success.  Returns false if the file does not exist or could not be read.
          */
-        bool supportsTruncation() const final;
+        bool readVirtualFile(
+            const QString&     virtualFileName,
+            unsigned long long offset,
+            unsigned long long maximumLength,
+            QByteArray&        data
+        );
 
         /**
-         * Method that is called to truncate the container at the current file position.
+         * Method you can use to estimate where the data of a virtual file starts on the device.  The container engine
+         * does not report where data is stored, so the first byte of the file is read and the device offset the
+         * engine reads it from is traced, as done by \ref compactStep.  Sort files by this value to read many files
+         * in device order.
          *
-         * \return Returns the status from the truncate operation.
+         * \param[in] virtualFileName The name of the virtual file.
+         *
+         * \return Returns the estimated device offset.  The largest possible value is returned if the file is empty,
+         *         does not exist, or the engine returned the byte without reading the device.
          */
-        ::Container::Status truncate() final;
+        unsigned long long storageOffset(const QString& virtualFileName);
 
         /**
-         * Method that is called to force any written data to be flushed to the media.
+         * Method you can use to copy a virtual file into another container, or into this container under a new name.
+         * Data is moved directly between the container engines in fixed size chunks through a single buffer.  No
+         * \ref QVirtualFile instances are created.  Data staged by devices for the source and destination files is
+         * committed first.  Both containers are locked for the duration of the copy.  An existing virtual file in the
+         * destination with the new name is replaced.
          *
-         * \return Returns the status from the flush operation.
+         * The copy passes through the buffer rather than being made by the kernel.  The container engine stores file
+         * data in blocks interleaved with its own headers, so a virtual file does not occupy a byte range of the
+         * container file that copy_file_range or a similar call could transfer.
+         *
+         * \param[in] virtualFileName    The name of the virtual file to be copied.
+         *
+         * \param[in] destination        The container to receive the copy.  The destination may be this container.
+         *
+         * \param[in] newVirtualFileName The name to assign to the copy.
+         *
+         * \return Returns true on success.  Returns false if the source file does not exist, if the copy would
+         *         replace the source file, if an existing destination file is open, or if the data could not be
+         *         copied.
          */
-        ::Container::Status flush() final;
+        bool copyVirtualFile(
+            const QString& virtualFileName,
+            QContainer*    destination,
+            const QString& newVirtualFileName
+        );
 
-    private:
         /**
-         * Factory method that is called by the streaming API to create new virtual file instances.  You should
-         * overload this method if you wish to use the stremaing API to instantiate classes derived from
-         * Container::VirtualFile.
+         * Convenience method that copies a virtual file to a new name within this container.  The data is copied in
+         * full, as by \ref QContainer::copyVirtualFile.  The container engine can not share storage between virtual
+         * files, so the duplicate occupies as much space as the original.
          *
-         * Upon creation, the newly created stream will be added to the directory.
+         * \param[in] virtualFileName    The name of the virtual file to be duplicated.
          *
-         * This version marshalls a call to QContainer::createFile(const QString&).
+         * \param[in] newVirtualFileName The name to assign to the duplicate.
          *
-         * \param[in] virtualFileName The name of the virtual file that should be created.
+         * \return Returns true on success, returns false on error.
+         */
+        bool duplicateVirtualFile(const QString& virtualFileName, const QString& newVirtualFileName);
+
+        /**
+         * Method you can call to create a new virtual file in the container.  The newly created file will be
+         * added to the directory.
          *
-         * \return Returns a newly created virtual file with the assigned name.
+         * \param[in] newVirtualFileName The new name to assign to this file.
+         *
+         * \return Returns the newly created virtual file.  A null pointer is returned on error.
          */
-        ::Container::VirtualFile* createFile(const std::string& virtualFileName) final;
+        QPointer<QVirtualFile> newVirtualFile(const QString& newVirtualFileName);
+
+        /**
+         * Method you can use to obtain an error string from the last operation performed.
+         *
+         * \return Returns a description of the error.
+         */
+        virtual QString errorString() const;
 
+    protected:
         /**
-         * Current list of translated virtual files.
+         * Type used to pass the pages written by a transaction, keyed by the zero based byte offset of each page.
          */
-        DirectoryMap directoryMap;
+        typedef QMap<unsigned long long, QByteArray> PageImages;
 
         /**
-         * Pointer to the underlying device being used for I/O.
+         * Method you can use to set the device used for I/O without changing the ownership of the device or of this
+         * container.
+         *
+         * \param[in] device The device used for I/O.
          */
-        QIODevice* currentDevice;
+        void attachDevice(QIODevice* device);
+
+        /**
+         * Method that starts a transaction that is committed, rather than discarded, when the container is closed.
+         * Derived classes can use this method to make the directory update written by the container engine on close
+         * atomic.
+         *
+         * \return Returns true on success.  Returns false if a transaction could not be started.
+         */
+        bool beginCloseTransaction();
+
+        /**
+         * Method that is called when a transaction is committed, before any pages are written to the device.  Derived
+         * classes can overload this method to record the transaction in a journal.  The default implementation does
+         * nothing.  The method is called with the container lock held.
+         *
+         * \param[in]  pageImages    The pages to be written, keyed by byte offset.  Pages at the end of the container
+         *                           are trimmed to the container size.
+         *
+         * \param[in]  truncatedSize The number of bytes at the start of the device kept by the transaction.  The
+         *                           device is truncated to this size before the pages are written.
+         *
+         * \param[in]  containerSize The size of the container after the transaction.
+         *
+         * \param[out] durable       Set to true if the transaction was durably recorded.  Durably recorded
+         *                           transactions are not flushed to stable storage when the pages are written.
+         *
+         * \return Returns true on success.  Returns false if the transaction could not be recorded.
+         */
+        virtual bool writeJournal(
+            const PageImages&  pageImages,
+            unsigned long long truncatedSize,
+            unsigned long long containerSize,
+            bool&              durable
+        );
+
+        /**
+         * Method that is called after the pages of a durably recorded transaction have been written to the device.
+         * Derived classes can overload this method to checkpoint the journal.  The default implementation does
+         * nothing.  The method is called with the container lock held.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        virtual bool journalApplied();
+
+        /**
+         * Method that is called before data that is not part of a transaction is written to, or truncated from, the
+         * device.  Derived classes can overload this method to checkpoint a journal whose records would otherwise
+         * overwrite the data if replayed.  The default implementation does nothing.  The method is called with the
+         * container lock held.
+         *
+         * \return Returns true on success.  Returns false if the write must not proceed.
+         */
+        virtual bool beginUnjournaledWrite();
+
+        /**
+         * Method that is called to determine if committed transactions are journaled.  When this method returns true,
+         * directory updates made outside of a transaction are written as a transaction so that they reach the device
+         * through the journal.  The default implementation returns false.  The method is called with the container
+         * lock held.
+         *
+         * \return Returns true if transactions are journaled.  Returns false if they are not.
+         */
+        virtual bool journalActive() const;
+
+        /**
+         * Method that flushes a file device, optionally to stable storage.
+         *
+         * \param[in]  fileDevice The device to be flushed.
+         *
+         * \param[in]  durable    If true, the data is also flushed to stable storage.
+         *
+         * \param[out] errorCode  A platform specific error code set if an error occurs.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        static bool syncDevice(QFileDevice* fileDevice, bool durable, int& errorCode);
+
+        /**
+         * Method that is called to determine the current size of the underlying data store, in bytes.
+         *
+         * \return Returns the size of the underlying data store, in bytes.  A negative value should be returned if
+         *         an error occurs.
+         */
+        long long size() final;
+
+        /**
+         * Method that is called to seek to a position in the underlying data store prior to performing a call to
+         * Container::Container::read, Container::Container::write, or Container::Container::truncate.
+         *
+         * \param[in] newOffset The new position in the underlying data store to seek to.
+         *
+         * \return Returns the status from this operation.
+         */
+        ::Container::Status setPosition(unsigned long long newOffset) final;
+
+        /**
+         * Method that is called to seek to the last just past the last byte in the underlying data store.
+         *
+         * \return Returns the status from this operation.
+         */
+        ::Container::Status setPositionLast() final;
+
+        /**
+         * Method that is called to determine the current byte offset from the beginning of the container.
+         *
+         * \return Returns the current byte offset from the beginning of the container.
+         */
+        unsigned long long position() const final;
+
+        /**
+         * Method that is called to read a specified number of bytes of data from the underlying data store.
+         *
+         * \param[in] buffer       The buffer to receive the data.  The buffer is guaranteed to be large enough to
+         *                         hold all the requested data.
+         *
+         * \param[in] desiredCount The number of bytes that are expected to be read.
+         *
+         * \return Returns the status from the read operation.  An instance of Container::ReadSuccessful should be
+         *         returned on success.
+         */
+        ::Container::Status read(std::uint8_t* buffer, unsigned desiredCount) final;
+
+        /**
+         * Method that is called to write a specified number of bytes of data to the underlying data store.
+         *
+         * \param[in] buffer The buffer holding the data to be written.
+         *
+         * \param[in] count  The number of bytes to be written.
+         *
+         * \return Returns the status from the write operation.  An instance of Container::Status should be returned
+         *         on success.
+         */
+        ::Container::Status write(const std::uint8_t* buffer, unsigned count) final;
+
+        /**
+         * Method you can overload to indicate whether the derived class supports file truncation.
+         *
+         * \return Returns true if file truncation is supported.  Returns false if file truncation is not supported.
+         */
+        bool supportsTruncation() const final;
+
+        /**
+         * Method that is called to truncate the container at the current file position.
+         *
+         * \return Returns the status from the truncate operation.
+         */
+        ::Container::Status truncate() final;
+
+        /**
+         * Method that is called to force any written data to be flushed to the media.
+         *
+         * \return Returns the status from the flush operation.
+         */
+        ::Container::Status flush() final;
+
+    private:
+        /**
+         * The default maximum read-ahead window, in bytes.
+         */
+        static constexpr unsigned long long defaultMaximumReadAhead = 1024 * 1024;
+
+        /**
+         * The initial read-ahead window, in block cache blocks.
+         */
+        static constexpr unsigned minimumReadAheadBlocks = 16;
+
+        /**
+         * The number of bytes requested per read when draining a sequential device.
+         */
+        static constexpr unsigned streamReadSize = 64 * 1024;
+
+        /**
+         * The size of the pages held in the transaction overlay, in bytes.
+         */
+        static constexpr unsigned transactionPageSize = 4096;
+
+        /**
+         * The size of the chunks used to copy virtual files during compaction, in bytes.  Stored data is also sampled
+         * at this interval to locate it.
+         */
+        static constexpr unsigned compactionChunkSize = 1024 * 1024;
+
+        /**
+         * The distance, in bytes, by which sampled device offsets may differ from a contiguous layout before a
+         * virtual file is considered fragmented or separated from the preceding file by free space.
+         */
+        static constexpr unsigned compactionTolerance = 16 * 1024;
+
+        /**
+         * The prefix of the hidden virtual file that holds a file while it is moved by compaction.  The name of the
+         * file being moved follows the prefix.
+         */
+        static constexpr const char* compactionFilePrefix = ".ineqcontainer/compaction/";
+
+        /**
+         * The prefix of the empty hidden virtual file that marks a file being copied back from its hidden copy.
+         * While the marker exists the hidden copy is the only complete version of the file.  The name of the file
+         * being moved follows the prefix.
+         */
+        static constexpr const char* compactionRestorePrefix = ".ineqcontainer/restore/";
+
+        /**
+         * Factory method that is called by the streaming API to create new virtual file instances.  You should
+         * overload this method if you wish to use the stremaing API to instantiate classes derived from
+         * Container::VirtualFile.
+         *
+         * Upon creation, the newly created stream will be added to the directory.
+         *
+         * This version marshalls a call to QContainer::createFile(const QString&).
+         *
+         * \param[in] virtualFileName The name of the virtual file that should be created.
+         *
+         * \return Returns a newly created virtual file with the assigned name.
+         */
+        ::Container::VirtualFile* createFile(const std::string& virtualFileName) final;
+
+        /**
+         * Method that converts a wildcard pattern, as described for \ref glob, to an anchored regular expression.
+         *
+         * \param[in] pattern The wildcard pattern.
+         *
+         * \return Returns the regular expression pattern.
+         */
+        static QString wildcardExpression(const QString& pattern);
+
+        /**
+         * Method that sets the initial state of the container.  The method is called by the constructors.
+         *
+         * \param[in] fileIdentifier The identifier placed at the start of the container.
+         */
+        void initialize(const QString& fileIdentifier);
+
+        /**
+         * Method that selects the I/O mode to use based on the requested I/O mode and the capabilities of the
+         * underlying device.
+         */
+        void configureIoMode();
+
+        /**
+         * Method that rebuilds the directory from the container engine.  The method is called after the container is
+         * opened.  The caller must hold the container lock.
+         */
+        void synchronizeDirectory();
+
+        /**
+         * Method that determines if a virtual file holds container metadata.
+         *
+         * \param[in] virtualFileName The name of the virtual file.
+         *
+         * \return Returns true if the name starts with \ref metadataPrefix.  Returns false otherwise.
+         */
+        static bool isMetadata(const QString& virtualFileName);
+
+        /**
+         * Method that samples where the next virtual file of the compaction pass is stored.  Once every file has been
+         * sampled, the method queues the files to be moved and advances the pass.  The caller must hold the container
+         * lock.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool scanCompaction();
+
+        /**
+         * Method that starts moving the next queued virtual file, or completes the compaction pass once the queue is
+         * empty.  The caller must hold the container lock.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool selectCompaction();
+
+        /**
+         * Method that copies one chunk of the virtual file being moved by compaction and advances the move once the
+         * copy is complete.  The caller must hold the container lock.
+         *
+         * \param[in,out] bytesCopied Running count of bytes copied, updated by this method.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool copyCompactionChunk(unsigned long long& bytesCopied);
+
+        /**
+         * Method that abandons a copy to the hidden compaction file or completes a copy back from it, so that no
+         * virtual file is held by the hidden file afterwards.  The caller must hold the container lock.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool settleCompaction();
+
+        /**
+         * Method that discards the state of the compaction pass so the next step starts a new pass.  The caller must
+         * hold the container lock.
+         */
+        void resetCompaction();
+
+        /**
+         * Method that cleans up after a compaction move interrupted by the process ending.  Hidden copies made
+         * before the copy back started are erased.  A move that was copying a file back is completed.  The caller
+         * must hold the container lock and no move may be in progress.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool recoverCompaction();
+
+        /**
+         * Method that is called when a virtual file is written through a device.  A write to the virtual file being
+         * moved by compaction restarts the copy in progress.  The caller must hold the container lock.
+         *
+         * \param[in] virtualFileName The name of the virtual file that was written.
+         */
+        void virtualFileWritten(const QString& virtualFileName);
+
+        /**
+         * Method that erases any existing virtual file with a given name and creates an empty replacement.  The
+         * caller must hold the container lock.
+         *
+         * \param[in] virtualFileName The name of the virtual file.
+         *
+         * \return Returns the newly created engine file.  A null pointer is returned if an existing file with the
+         *         same name is open or if the file could not be created.
+         */
+        std::shared_ptr<::Container::VirtualFile> replaceVirtualFile(const QString& virtualFileName);
+
+        /**
+         * Method that waits for data staged by all materialized virtual files to be committed.  The caller must not
+         * hold the container lock.
+         *
+         * \return Returns true on success.  Returns false if any staged data could not be committed.
+         */
+        bool commitStagedWrites();
+
+        /**
+         * Method that waits for data staged by a single virtual file to be committed.  The caller must not hold the
+         * container lock.
+         *
+         * \param[in] virtualFileName The name of the virtual file.
+         *
+         * \return Returns true on success.  Returns false if the staged data could not be committed.
+         */
+        bool commitStagedWrites(const QString& virtualFileName);
+
+        /**
+         * Method that writes the current directory to the device so that independent readers of the device see the
+         * current set of virtual files.  Nothing is written while a transaction is active since the device then
+         * holds the state at the start of the transaction, and nothing is written if the directory has not changed
+         * since it was last written.  When transactions are journaled, the directory is written as a transaction so
+         * an interruption can not leave a partly written directory.  The caller must commit staged writes and wait
+         * for the I/O thread before taking the container lock.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool persistDirectory(int& errorCode);
+
+        /**
+         * Method that writes the directory through the current write path.  The container engine is closed, which
+         * writes the directory, and reopened.  Existing devices are rebound to the reloaded virtual files with their
+         * positions preserved.  While a transaction is active the directory is written into the transaction.  The
+         * caller must hold the container lock.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool writeDirectory(int& errorCode);
+
+        /**
+         * Method that writes the directory as a transaction so that it reaches the device through the journal.  If
+         * the transaction can not be committed, the directory last written to the device is reloaded.  The caller
+         * must hold the container lock and no transaction may be active.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool writeJournaledDirectory(int& errorCode);
+
+        /**
+         * Method that determines if the directory held by the container engine differs from the directory last
+         * written to the device.  The caller must hold the container lock.
+         *
+         * \return Returns true if the directory must be written.  Returns false if the device is up to date.
+         */
+        bool directoryChanged() const;
+
+        /**
+         * Method that opens the container engine and loads the directory.  The caller must hold the container lock.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool openEngine();
+
+        /**
+         * Method that completes a deferred open, if needed.  The caller must hold the container lock.
+         *
+         * \return Returns true if the container is open.  Returns false if the container is not open or the deferred
+         *         open failed.
+         */
+        bool ensureOpen();
+
+        /**
+         * Method that checks that the identifier field in the header of the device holds the file identifier.  The
+         * location of the field is taken from the header of an empty container built in memory.  The caller must
+         * hold the container lock.
+         *
+         * \return Returns true if the identifier matches.  Returns false if the identifier does not match.
+         */
+        bool checkFileIdentifier();
+
+        /**
+         * Method that is called to remove an erased virtual file from the directory.  The caller must hold the
+         * container lock.
+         *
+         * \param[in] virtualFileName The name of the erased virtual file.
+         */
+        void removeFromDirectory(const QString& virtualFileName);
+
+        /**
+         * Method that creates, on first use, the \ref QVirtualFile instance for a directory entry.  The caller must
+         * hold the container lock.
+         *
+         * \param[in] virtualFileName The name of the virtual file.
+         *
+         * \return Returns the virtual file device.  A null pointer is returned if the file does not exist.
+         */
+        QPointer<QVirtualFile> materialize(const QString& virtualFileName);
+
+        /**
+         * Method that collects handles to all streams whose names start with a given prefix.  The caller must hold
+         * the container lock.
+         *
+         * \param[in] prefix The desired name prefix.
+         *
+         * \return Returns a map, keyed by the stream name, of handles to the matching streams.
+         */
+        HandleMap handlesWithPrefix(const QString& prefix) const;
+
+        /**
+         * Method that determines the direction to use for a sequential device.
+         *
+         * \return Returns \ref QContainer::StreamMode::READ or \ref QContainer::StreamMode::WRITE.
+         */
+        StreamMode activeStreamMode() const;
+
+        /**
+         * Method that prepares the staging arena for a sequential device, draining the device into the arena when
+         * reading.
+         *
+         * \return Returns true on success.  Returns false if the device does not support the required direction.
+         */
+        bool loadStream();
+
+        /**
+         * Method that writes the staging arena to a sequential device when writing.  The method does nothing for
+         * random access devices or when reading.
+         *
+         * \return Returns true on success.  Returns false if the data could not be written.
+         */
+        bool storeStream();
+
+        /**
+         * Method that releases any resources tied to the current I/O mode and reverts to
+         * \ref QContainer::IoMode::DEVICE.
+         */
+        void releaseIoMode();
+
+        /**
+         * Method that reads data from the underlying device at a specified offset using the current I/O mode.  Any
+         * data held in the write combining buffer that overlaps the requested range is written to the device first.
+         *
+         * \param[in]  offset    The zero based byte offset into the device.
+         *
+         * \param[in]  buffer    The buffer to receive the data.
+         *
+         * \param[in]  count     The number of bytes to be read.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns the number of bytes read.  A negative value is returned on error.
+         */
+        long long deviceRead(unsigned long long offset, std::uint8_t* buffer, unsigned count, int& errorCode);
+
+        /**
+         * Method that reads data directly from the underlying device, bypassing any active transaction.
+         *
+         * \param[in]  offset    The zero based byte offset into the device.
+         *
+         * \param[in]  buffer    The buffer to receive the data.
+         *
+         * \param[in]  count     The number of bytes to be read.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns the number of bytes read.  A negative value is returned on error.
+         */
+        long long storageRead(unsigned long long offset, std::uint8_t* buffer, unsigned count, int& errorCode);
+
+        /**
+         * Method that writes data to the underlying device at a specified offset using the current I/O mode.
+         *
+         * \param[in]  offset    The zero based byte offset into the device.
+         *
+         * \param[in]  buffer    The buffer holding the data to be written.
+         *
+         * \param[in]  count     The number of bytes to be written.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns the number of bytes written.  A negative value is returned on error.
+         */
+        long long deviceWrite(unsigned long long offset, const std::uint8_t* buffer, unsigned count, int& errorCode);
+
+        /**
+         * Method that writes data directly to the underlying device, bypassing any active transaction.
+         *
+         * \param[in]  offset    The zero based byte offset into the device.
+         *
+         * \param[in]  buffer    The buffer holding the data to be written.
+         *
+         * \param[in]  count     The number of bytes to be written.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns the number of bytes written.  A negative value is returned on error.
+         */
+        long long storageWrite(unsigned long long offset, const std::uint8_t* buffer, unsigned count, int& errorCode);
+
+        /**
+         * Method that reads data through the transaction overlay.  Pages not held in the overlay are read from the
+         * device.
+         *
+         * \param[in]  offset    The zero based byte offset into the container.
+         *
+         * \param[in]  buffer    The buffer to receive the data.
+         *
+         * \param[in]  count     The number of bytes to be read.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns the number of bytes read.  A negative value is returned on error.
+         */
+        long long overlayRead(unsigned long long offset, std::uint8_t* buffer, unsigned count, int& errorCode);
+
+        /**
+         * Method that writes data into the transaction overlay.  Partially written pages are first loaded from the
+         * device.
+         *
+         * \param[in]  offset    The zero based byte offset into the container.
+         *
+         * \param[in]  buffer    The buffer holding the data to be written.
+         *
+         * \param[in]  count     The number of bytes to be written.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns the number of bytes written.  A negative value is returned on error.
+         */
+        long long overlayWrite(unsigned long long offset, const std::uint8_t* buffer, unsigned count, int& errorCode);
+
+        /**
+         * Method that truncates the transaction overlay.  The device itself is resized when the transaction is
+         * committed.
+         *
+         * \param[in] newSize The new container size, in bytes.
+         */
+        void overlayTruncate(unsigned long long newSize);
+
+        /**
+         * Method that writes the transaction overlay to the device and ends the transaction.  The caller must hold
+         * the container lock.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool commitOverlay(int& errorCode);
+
+        /**
+         * Method that discards the transaction overlay and restores the state tracked at the start of the
+         * transaction.  The caller must hold the container lock.
+         */
+        void rollbackOverlay();
+
+        /**
+         * Method that preserves, for every live snapshot, the pages of a byte range that are about to be
+         * overwritten or truncated.  Released snapshots are discarded.  The caller must hold the container lock.
+         *
+         * \param[in]  offset    The zero based byte offset of the start of the range.
+         *
+         * \param[in]  endOffset The zero based byte offset just past the end of the range.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool preserveSnapshotPages(unsigned long long offset, unsigned long long endOffset, int& errorCode);
+
+        /**
+         * Method that resizes the underlying device.
+         *
+         * \param[in]  newSize   The new device size, in bytes.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool resizeStorage(unsigned long long newSize, int& errorCode);
+
+        /**
+         * Method that flushes the underlying device.
+         *
+         * \param[in]  durable   If true, the data is also flushed to stable storage.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool syncStorage(bool durable, int& errorCode);
+
+        /**
+         * Method that writes data at a specified offset, merging the data into the write combining buffer when
+         * possible.
+         *
+         * \param[in]  offset    The zero based byte offset into the device.
+         *
+         * \param[in]  buffer    The buffer holding the data to be written.
+         *
+         * \param[in]  count     The number of bytes to be written.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns the number of bytes written or buffered.  A negative value is returned on error.
+         */
+        long long combinedWrite(unsigned long long offset, const std::uint8_t* buffer, unsigned count, int& errorCode);
+
+        /**
+         * Method that writes any data held in the write combining buffer to the device.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool flushPendingWrite(int& errorCode);
+
+        /**
+         * Method that reads data from the underlying device at a specified offset, servicing the request from the
+         * block cache when possible.
+         *
+         * \param[in]  offset    The zero based byte offset into the device.
+         *
+         * \param[in]  buffer    The buffer to receive the data.
+         *
+         * \param[in]  count     The number of bytes to be read.
+         *
+         * \param[in]  readState The read state of the virtual file performing the read.  A null pointer indicates
+         *                       a read with no access hint, such as a directory read by the container engine.
+         *
+         * \param[out] errorCode A platform specific error code set if an error occurs.
+         *
+         * \return Returns the number of bytes read.  A negative value is returned on error.
+         */
+        long long cachedRead(
+            unsigned long long       offset,
+            std::uint8_t*            buffer,
+            unsigned                 count,
+            QVirtualFile::ReadState* readState,
+            int&                     errorCode
+        );
+
+        /**
+         * Method that updates the read-ahead window of a virtual file based on the location of a new read.
+         *
+         * \param[in]     offset    The zero based byte offset of the read.
+         *
+         * \param[in]     count     The number of bytes requested.
+         *
+         * \param[in,out] readState The read state of the virtual file performing the read.
+         *
+         * \return Returns the number of bytes to read ahead past the requested data.
+         */
+        unsigned long long updateReadAhead(
+            unsigned long long       offset,
+            unsigned                 count,
+            QVirtualFile::ReadState& readState
+        );
+
+        /**
+         * Method that passes an access hint to the operating system for a range of the underlying device.  Hints
+         * are ignored for devices that are not files and on platforms that do not support them.
+         *
+         * \param[in] hint   The access hint to be applied.
+         *
+         * \param[in] offset The zero based byte offset of the range.
+         *
+         * \param[in] length The length of the range, in bytes.
+         */
+        void adviseDevice(QVirtualFile::AccessHint hint, unsigned long long offset, unsigned long long length);
+
+        /**
+         * Method that reads from an engine virtual file on behalf of a \ref QVirtualFile.  The read state is made
+         * available to the device reads issued by the container engine for the duration of the call.  The caller
+         * must hold the I/O mutex.
+         *
+         * \param[in]     virtualFile The engine virtual file to read from.
+         *
+         * \param[in]     buffer      The buffer to receive the data.
+         *
+         * \param[in]     count       The number of bytes to be read.
+         *
+         * \param[in,out] readState   The read state of the virtual file performing the read.
+         *
+         * \return Returns the status from the engine read.
+         */
+        ::Container::Status readWithState(
+            ::Container::VirtualFile& virtualFile,
+            std::uint8_t*             buffer,
+            unsigned long long        count,
+            QVirtualFile::ReadState&  readState
+        );
+
+        /**
+         * Current list of materialized virtual files.
+         */
+        DirectoryMap directoryMap;
+
+        /**
+         * The file identifier.
+         */
+        QString currentFileIdentifier;
+
+        /**
+         * Flag indicating if lazy opening is enabled.
+         */
+        bool currentLazyOpen;
+
+        /**
+         * Flag indicating that opening the container engine has been deferred.
+         */
+        bool openPending;
+
+        /**
+         * Flag indicating that the container engine is open.
+         */
+        bool engineOpen;
+
+        /**
+         * Flag indicating that virtual files were created, erased or written outside of a transaction since the
+         * directory was last written to the device.
+         */
+        bool directoryDirty;
+
+        /**
+         * Structure holding the state tracked for each virtual file in the container.
+         */
+        struct DirectoryEntry {
+            /**
+             * The underlying container virtual file.
+             */
+            std::shared_ptr<::Container::VirtualFile> virtualFile;
+
+            /**
+             * The device for this virtual file.  The value is null until the device is requested.
+             */
+            QPointer<QVirtualFile> device;
+        };
+
+        /**
+         * Type used for the hash index of directory entries by name.
+         */
+        typedef QHash<QString, DirectoryEntry> DirectoryIndex;
+
+        /**
+         * Hash index of all virtual files in the container, by name.  \ref QContainer::directoryMap only holds the
+         * virtual files that have been materialized.
+         */
+        DirectoryIndex directoryIndex;
+
+        /**
+         * Sorted map of handles to all virtual files in the container.
+         */
+        HandleMap handleMap;
+
+        /**
+         * Pointer to the underlying device being used for I/O.
+         */
+        QIODevice* currentDevice;
+
+        /**
+         * The I/O mode requested by the user.
+         */
+        IoMode currentRequestedIoMode;
+
+        /**
+         * The I/O mode currently in use.
+         */
+        IoMode currentIoMode;
+
+        /**
+         * The current flush mode.
+         */
+        FlushMode currentFlushMode;
+
+        /**
+         * The file descriptor used for I/O.  The value is only valid in \ref QContainer::IoMode::POSITIONAL mode.
+         */
+        int fileDescriptor;
+
+        /**
+         * Pointer to the memory mapped data.  The value is only valid in \ref QContainer::IoMode::MAPPED mode.
+         */
+        const std::uint8_t* mappedData;
+
+        /**
+         * Structure describing a range of a virtual file that is stored verbatim in the memory mapping.
+         */
+        struct MappedExtent {
+            /**
+             * The zero based offset into the virtual file of the first byte of the range.
+             */
+            unsigned long long fileOffset;
+
+            /**
+             * The length of the range, in bytes.  A value of zero indicates that no range is known.
+             */
+            unsigned long long length;
+
+            /**
+             * The device offset of the first byte of the range.
+             */
+            unsigned long long deviceOffset;
+        };
+
+        /**
+         * Ranges of virtual files known to be stored verbatim in the memory mapping, by virtual file name.  The
+         * ranges are discovered by \ref QVirtualFile::view and are only valid while the mapping is held.
+         */
+        QHash<QString, MappedExtent> mappedExtents;
+
+        /**
+         * Flag indicating that device reads are being traced by \ref QVirtualFile::view.
+         */
+        bool viewTracing;
+
+        /**
+         * The number of device reads traced since tracing was enabled.
+         */
+        unsigned viewTraceReads;
+
+        /**
+         * The destination buffer of the last traced read.
+         */
+        const std::uint8_t* viewTraceBuffer;
+
+        /**
+         * The device offset of the last traced read.
+         */
+        unsigned long long viewTraceOffset;
+
+        /**
+         * The number of bytes requested by the last traced read.
+         */
+        unsigned viewTraceCount;
+
+        /**
+         * Pointer to the underlying device when the device is a \ref QArenaDevice.  The arena is accessed directly,
+         * without seeking the device.  The value is only valid while the container is open.
+         */
+        QArenaDevice* arenaDevice;
+
+        /**
+         * The direction used when the underlying device is sequential.
+         */
+        StreamMode currentStreamMode;
+
+        /**
+         * Arena used to stage the container when the underlying device is sequential.  The arena is created on first
+         * use.
+         */
+        QArenaDevice* streamArena;
+
+        /**
+         * Type used to hold transaction pages by page index.
+         */
+        typedef QHash<unsigned long long, QByteArray> PageMap;
+
+        /**
+         * Flag indicating if a transaction is active.
+         */
+        bool transactionActive;
+
+        /**
+         * Flag indicating if the active transaction should be committed when the container is closed.
+         */
+        bool transactionCommitOnClose;
+
+        /**
+         * Pages written during the active transaction, by page index.
+         */
+        PageMap transactionPages;
+
+        /**
+         * The container size at the start of the active transaction.
+         */
+        unsigned long long transactionStartSize;
+
+        /**
+         * The number of bytes, from the start of the device, that are still valid during the active transaction.  The
+         * value is lowered when the container is truncated.
+         */
+        unsigned long long transactionStorageSize;
+
+        /**
+         * Pages preserved for each snapshot taken from this container.  Entries are removed once the snapshot is
+         * deleted.
+         */
+        QList<std::weak_ptr<QContainerSnapshotPages>> snapshotPages;
+
+        /**
+         * Enumeration of the phases of a compaction pass.
+         */
+        enum class CompactionPhase {
+            /**
+             * Indicates that the layout of the virtual files is being sampled.
+             */
+            SCAN,
+
+            /**
+             * Indicates that the next queued virtual file is to be moved.
+             */
+            SELECT,
+
+            /**
+             * Indicates that a virtual file is being copied to the hidden compaction file.
+             */
+            COPY,
+
+            /**
+             * Indicates that a virtual file is being copied back from the hidden compaction file.
+             */
+            RESTORE
+        };
+
+        /**
+         * Structure describing where the data of a virtual file was found by a compaction scan.
+         */
+        struct CompactionExtent {
+            /**
+             * The name of the virtual file.
+             */
+            QString name;
+
+            /**
+             * The device offset just past the last sampled byte of the virtual file.
+             */
+            unsigned long long end;
+
+            /**
+             * Flag indicating that the samples are consistent with the file being stored in one run.
+             */
+            bool contiguous;
+        };
+
+        /**
+         * The current phase of the compaction pass.
+         */
+        CompactionPhase compactionPhase;
+
+        /**
+         * Name of the last virtual file sampled by the current compaction pass.  A null string indicates that the
+         * scan starts at the first virtual file.
+         */
+        QString compactionCursor;
+
+        /**
+         * The extents found by the compaction scan, keyed by the device offset of the first sample.
+         */
+        QMultiMap<unsigned long long, CompactionExtent> compactionLayout;
+
+        /**
+         * The names of the virtual files still to be moved by the current compaction pass, in device order.
+         */
+        QStringList compactionQueue;
+
+        /**
+         * The name of the virtual file being moved by compaction.
+         */
+        QString compactionName;
+
+        /**
+         * The virtual file being copied from by compaction.
+         */
+        std::shared_ptr<::Container::VirtualFile> compactionSource;
+
+        /**
+         * The virtual file being copied to by compaction.
+         */
+        std::shared_ptr<::Container::VirtualFile> compactionTarget;
+
+        /**
+         * The hidden virtual file marking that the file being moved is being copied back.
+         */
+        std::shared_ptr<::Container::VirtualFile> compactionMarker;
+
+        /**
+         * The number of bytes of the source copied to the target.
+         */
+        unsigned long long compactionOffset;
+
+        /**
+         * Flag indicating that the virtual file being moved was written since the copy in progress started.
+         */
+        bool compactionDirty;
+
+        /**
+         * Flag indicating that device reads are being traced by a compaction scan.
+         */
+        bool compactionTracing;
+
+        /**
+         * Flag indicating that a device read was traced.
+         */
+        bool compactionTraced;
+
+        /**
+         * The device offset of the last traced read.
+         */
+        unsigned long long compactionTraceOffset;
+
+        /**
+         * Flag indicating if the last compaction step completed a pass.
+         */
+        bool compactionPassComplete;
+
+        /**
+         * The current size of the underlying data store, in bytes.
+         */
+        unsigned long long trackedSize;
+
+        /**
+         * The current position within the underlying data store.
+         */
+        unsigned long long trackedPosition;
+
+        /**
+         * The block cache shared by all virtual files in this container.
+         */
+        QContainerBlockCache* blockCache;
+
+        /**
+         * The read state of the virtual file currently performing a read.  Only valid while the I/O mutex is held
+         * during a call to \ref readWithState.
+         */
+        QVirtualFile::ReadState* activeReadState;
+
+        /**
+         * The maximum read-ahead window, in bytes.
+         */
+        unsigned long long currentMaximumReadAhead;
+
+        /**
+         * The size of the write combining buffer, in bytes.
+         */
+        unsigned long long currentWriteCombiningSize;
+
+        /**
+         * The device offset of the data held in the write combining buffer.
+         */
+        unsigned long long pendingWriteOffset;
+
+        /**
+         * Data waiting to be written to the device.
+         */
+        QByteArray pendingWrite;
+
+        /**
+         * Lock used to serialize access to the container engine.
+         */
+        QMutex ioMutex;
+
+        /**
+         * Thread pool used to perform asynchronous I/O.  The pool holds a single thread so asynchronous operations
+         * are performed in the order they are issued.
+         */
+        QThreadPool* ioThreadPool;
 };
 
 #endif
@@ -0,0 +1,214 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref QContainerExtractor class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineqcontainer */
+
+#ifndef QCONTAINER_EXTRACTOR_H
+#define QCONTAINER_EXTRACTOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+class QContainer;
+
+/**
+ * Class that extracts virtual files from a \ref QContainer to the filesystem.  The calling thread reads virtual files
+ * from the container in chunks of \ref outputChunkSize bytes using \ref QContainer::readVirtualFile, so files of any
+ * size are extracted with bounded memory.  Files are read in the order \ref QContainer::storageOffset estimates they
+ * are stored so the container is read mostly sequentially.  Decompression and writes to the output files are spread
+ * across a pool of worker threads, each chunk being written at its own offset, so that the container is read at full
+ * speed.
+ *
+ * Data is always copied through memory.  The container engine stores virtual files in blocks with its own headers,
+ * so no range of the container file matches the contents of a virtual file and kernel copies such as
+ * copy_file_range or sendfile can not be used.
+ *
+ * Virtual files listed in the manifest written by \ref QContainerImporter are decompressed as they are written.
+ * Virtual files under \ref QContainer::metadataPrefix hold container metadata.  They are not listed by the
+ * container and so are not extracted by \ref QContainerExtractor::extractDirectory.  Virtual file names that would
+ * resolve outside of the output directory are rejected.
+ */
+class QContainerExtractor {
+    public:
+        /**
+         * The default maximum number of files waiting to be written.
+         */
+        static constexpr unsigned defaultMaximumPendingFiles = 64;
+
+        /**
+         * The size of the chunks in which uncompressed virtual files are read and written, in bytes.  Compressed
+         * virtual files are read one compressed chunk, as written by \ref QContainerImporter, at a time.
+         */
+        static constexpr unsigned outputChunkSize = 4 * 1024 * 1024;
+
+        /**
+         * Constructor
+         *
+         * \param[in] container The container holding the files to be extracted.
+         */
+        QContainerExtractor(QContainer* container);
+
+        ~QContainerExtractor();
+
+        /**
+         * Method you can use to set the number of worker threads used to write output files.
+         *
+         * \param[in] newThreadCount The number of worker threads.  A value of zero selects the ideal thread count for
+         *                           the system.
+         */
+        void setThreadCount(unsigned newThreadCount);
+
+        /**
+         * Method you can use to determine the number of worker threads used to write output files.
+         *
+         * \return Returns the number of worker threads.  A value of zero indicates the ideal thread count for the
+         *         system.
+         */
+        unsigned threadCount() const;
+
+        /**
+         * Method you can use to limit the number of files read from the container but not yet written.  Files larger
+         * than \ref outputChunkSize count once for each chunk so the limit bounds the memory used by an extraction.
+         *
+         * \param[in] newMaximumPendingFiles The maximum number of files waiting to be written.
+         */
+        void setMaximumPendingFiles(unsigned newMaximumPendingFiles);
+
+        /**
+         * Method you can use to determine the maximum number of files read from the container but not yet written.
+         *
+         * \return Returns the maximum number of files waiting to be written.
+         */
+        unsigned maximumPendingFiles() const;
+
+        /**
+         * Method you can use to extract every virtual file whose name starts with a prefix.  The prefix is removed
+         * from each name and the remainder, using forward slashes as separators, is used as the path relative to the
+         * output directory.  Missing directories are created.
+         *
+         * \param[in] directoryPath The output directory.
+         *
+         * \param[in] prefix        The prefix of the virtual files to be extracted.  An empty prefix extracts every
+         *                          virtual file.
+         *
+         * \return Returns true on success.  Returns false if any file could not be read or written.
+         */
+        bool extractDirectory(const QString& directoryPath, const QString& prefix = QString());
+
+        /**
+         * Method you can use to extract a list of virtual files.
+         *
+         * \param[in] virtualFileNames The names of the virtual files to be extracted.
+         *
+         * \param[in] filenames        The names of the output files, in the same order as the virtual files.
+         *
+         * \return Returns true on success.  Returns false if any file could not be read or written.
+         */
+        bool extractFiles(const QStringList& virtualFileNames, const QStringList& filenames);
+
+        /**
+         * Method you can use to determine the number of files extracted by the last extraction.
+         *
+         * \return Returns the number of files extracted.
+         */
+        unsigned long long filesExtracted() const;
+
+        /**
+         * Method you can use to determine the number of bytes written to output files by the last extraction.
+         * Compressed files count their decompressed size, matching \ref QContainerImporter::bytesImported.
+         *
+         * \return Returns the number of bytes written.
+         */
+        unsigned long long bytesExtracted() const;
+
+        /**
+         * Method you can use to obtain a description of the last error.
+         *
+         * \return Returns a description of the last error.  An empty string is returned if no error occurred.
+         */
+        QString errorString() const;
+
+    private:
+        /**
+         * Method that creates an empty output file, along with any missing directories.
+         *
+         * \param[in] filename The name of the output file.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        static bool createOutputFile(const QString& filename);
+
+        /**
+         * Method that writes, and optionally decompresses, one chunk of an output file.  The method is called from
+         * worker threads after the output file has been created.
+         *
+         * \param[in] filename   The name of the output file.
+         *
+         * \param[in] offset     The offset in the output file at which the chunk is written.
+         *
+         * \param[in] data       The chunk read from the container.
+         *
+         * \param[in] decompress If true, the chunk holds the output of qCompress, as written by
+         *                       \ref QContainerImporter, and is decompressed before it is written.
+         *
+         * \return Returns the number of bytes written to the output file.  A negative value is returned on error.
+         */
+        static qint64 storeOutputChunk(
+            const QString&     filename,
+            unsigned long long offset,
+            const QByteArray&  data,
+            bool               decompress
+        );
+
+        /**
+         * The container holding the files to be extracted.
+         */
+        QContainer* currentContainer;
+
+        /**
+         * The number of worker threads.
+         */
+        unsigned currentThreadCount;
+
+        /**
+         * The maximum number of files waiting to be written.
+         */
+        unsigned currentMaximumPendingFiles;
+
+        /**
+         * The number of files extracted by the last extraction.
+         */
+        unsigned long long currentFilesExtracted;
+
+        /**
+         * The number of bytes written by the last extraction.
+         */
+        unsigned long long currentBytesExtracted;
+
+        /**
+         * Description of the last error.
+         */
+        QString currentErrorString;
+};
+
+#endif
@@ -0,0 +1,268 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref QContainerImporter class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineqcontainer */
+
+#ifndef QCONTAINER_IMPORTER_H
+#define QCONTAINER_IMPORTER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QStringList>
+#include <QSet>
+
+class QContainer;
+
+/**
+ * Class that imports files from the filesystem into a \ref QContainer.  Source files are read, and optionally
+ * compressed, on a pool of worker threads in chunks of \ref sourceChunkSize bytes so large files are never held in
+ * memory as a whole.  The calling thread acts as the single writer, starting each file with
+ * \ref QContainer::writeVirtualFile and adding later chunks with \ref QContainer::appendVirtualFile.  Files are added
+ * in a stable order, sorted by name, regardless of the order in which the workers finish.
+ *
+ * Each chunk of a compressed file is stored as a 32-bit little endian length followed by the chunk in the format
+ * produced by qCompress.  The names of compressed files are recorded in the virtual file
+ * \ref compressionManifestName so a \ref QContainerExtractor restores them without further configuration.
+ */
+class QContainerImporter {
+    public:
+        /**
+         * The default maximum number of files read ahead of the writer.
+         */
+        static constexpr unsigned defaultMaximumPendingFiles = 64;
+
+        /**
+         * The size of the chunks in which source files are read and compressed, in bytes.
+         */
+        static constexpr unsigned sourceChunkSize = 4 * 1024 * 1024;
+
+        /**
+         * The name of the virtual file listing the compressed virtual files.  Names are stored in UTF-8, each
+         * followed by a zero byte.
+         */
+        static constexpr const char* compressionManifestName = ".ineqcontainer/compressed";
+
+        /**
+         * Constructor
+         *
+         * \param[in] container The container to receive the imported files.
+         */
+        QContainerImporter(QContainer* container);
+
+        ~QContainerImporter();
+
+        /**
+         * Method you can use to enable or disable compression of imported files.
+         *
+         * \param[in] nowEnabled If true, files will be compressed.  If false, files will be stored as is.
+         */
+        void setCompressionEnabled(bool nowEnabled = true);
+
+        /**
+         * Method you can use to determine if imported files are compressed.
+         *
+         * \return Returns true if files are compressed.  Returns false if files are stored as is.
+         */
+        bool compressionEnabled() const;
+
+        /**
+         * Method you can use to set the number of worker threads used to read source files.
+         *
+         * \param[in] newThreadCount The number of worker threads.  A value of zero selects the ideal thread count for
+         *                           the system.
+         */
+        void setThreadCount(unsigned newThreadCount);
+
+        /**
+         * Method you can use to determine the number of worker threads used to read source files.
+         *
+         * \return Returns the number of worker threads.  A value of zero indicates the ideal thread count for the
+         *         system.
+         */
+        unsigned threadCount() const;
+
+        /**
+         * Method you can use to limit the number of files read ahead of the writer.  Files larger than
+         * \ref sourceChunkSize count once for each chunk so the limit bounds the memory used by an import.
+         *
+         * \param[in] newMaximumPendingFiles The maximum number of files read ahead of the writer.
+         */
+        void setMaximumPendingFiles(unsigned newMaximumPendingFiles);
+
+        /**
+         * Method you can use to determine the maximum number of files read ahead of the writer.
+         *
+         * \return Returns the maximum number of files read ahead of the writer.
+         */
+        unsigned maximumPendingFiles() const;
+
+        /**
+         * Method you can use to import every file under a directory.  Each file is stored under its path relative to
+         * the directory, using forward slashes as separators, preceded by an optional prefix.
+         *
+         * \param[in] directoryPath The directory to be imported.
+         *
+         * \param[in] prefix        A prefix added to the name of every imported file.
+         *
+         * \return Returns true on success.  Returns false if any file could not be read or written.
+         */
+        bool importDirectory(const QString& directoryPath, const QString& prefix = QString());
+
+        /**
+         * Method you can use to import a list of files.
+         *
+         * \param[in] filenames        The names of the files to be imported.
+         *
+         * \param[in] virtualFileNames The names to use in the container, in the same order as the source files.
+         *
+         * \return Returns true on success.  Returns false if any file could not be read or written.
+         */
+        bool importFiles(const QStringList& filenames, const QStringList& virtualFileNames);
+
+        /**
+         * Method you can use to determine the number of files imported by the last import.
+         *
+         * \return Returns the number of files imported.
+         */
+        unsigned long long filesImported() const;
+
+        /**
+         * Method you can use to determine the number of bytes read from source files by the last import.
+         *
+         * \return Returns the number of bytes read.
+         */
+        unsigned long long bytesImported() const;
+
+        /**
+         * Method you can use to obtain a description of the last error.
+         *
+         * \return Returns a description of the last error.  An empty string is returned if no error occurred.
+         */
+        QString errorString() const;
+
+        /**
+         * Method you can use to determine which virtual files in a container were compressed on import.
+         *
+         * \param[in] container The container to be checked.
+         *
+         * \return Returns the names of the compressed virtual files.  An empty set is returned if the container
+         *         holds no manifest.
+         */
+        static QSet<QString> compressedVirtualFiles(QContainer* container);
+
+    private:
+        /**
+         * Structure holding a chunk of a source file read by a worker thread.
+         */
+        struct SourceChunk {
+            /**
+             * Flag indicating if the chunk was read successfully.
+             */
+            bool success;
+
+            /**
+             * The index of the source file.
+             */
+            int fileIndex;
+
+            /**
+             * The offset of the chunk in the source file.
+             */
+            unsigned long long offset;
+
+            /**
+             * Flag indicating that this is the last chunk of the source file.
+             */
+            bool last;
+
+            /**
+             * The number of bytes read from the source file.
+             */
+            unsigned long long sourceSize;
+
+            /**
+             * The data to be stored in the container.
+             */
+            QByteArray data;
+        };
+
+        /**
+         * Method that reads, and optionally compresses, a chunk of a source file.  The method is called from worker
+         * threads.
+         *
+         * \param[in] filename  The name of the source file.
+         *
+         * \param[in] fileIndex The index of the source file, recorded in the result.
+         *
+         * \param[in] offset    The offset of the chunk in the source file.
+         *
+         * \param[in] last      Flag indicating that this is the last chunk, recorded in the result.
+         *
+         * \param[in] compress  If true, the chunk is compressed.
+         *
+         * \return Returns the loaded chunk.
+         */
+        static SourceChunk loadSourceChunk(
+            const QString&     filename,
+            int                fileIndex,
+            unsigned long long offset,
+            bool               last,
+            bool               compress
+        );
+
+        /**
+         * The container receiving the imported files.
+         */
+        QContainer* currentContainer;
+
+        /**
+         * Flag indicating if imported files are compressed.
+         */
+        bool currentCompressionEnabled;
+
+        /**
+         * The number of worker threads.
+         */
+        unsigned currentThreadCount;
+
+        /**
+         * The maximum number of files read ahead of the writer.
+         */
+        unsigned currentMaximumPendingFiles;
+
+        /**
+         * The number of files imported by the last import.
+         */
+        unsigned long long currentFilesImported;
+
+        /**
+         * The number of bytes read by the last import.
+         */
+        unsigned long long currentBytesImported;
+
+        /**
+         * Description of the last error.
+         */
+        QString currentErrorString;
+};
+
+#endif
@@ -25,25 +25,48 @@
 #ifndef QFILE_CONTAINER_H
 #define QFILE_CONTAINER_H
 
-#include <QMap>
-#include <QPointer>
+#include <QString>
+#include <QFile>
 #include <QObject>
 
 #include <container_file_container.h>
 
-class QVirtualFile;
+#include "qcontainer.h"
 
 /**
- * Class that extends and Qt-ify's the Container::FileContainer class to provide an interface a container stored in a
- * file.  This class is preferential to the QContainer class in that it uses the underlying Container::FileContainer
- * class an engine, supporting file truncation.
+ * Class that extends the \ref QContainer class to provide an interface to a container stored in a file.  The class
+ * manages the underlying QFile, supports file truncation, and defaults to positional I/O so that the block cache and
+ * the other \ref QContainer facilities apply to file based containers.
+ *
+ * Earlier releases derived this class from Container::FileContainer, which performs its own file I/O and bypasses
+ * \ref QContainer.  Deriving from \ref QContainer lets file based containers share the block cache and, through the
+ * same device hooks, use transactions, the journal, compaction and snapshots.  The on-disk format is unchanged since
+ * it is still produced by the Container::Container engine.  Callers should note the following differences:
+ *
+ * * QFileContainer::DirectoryMap, directory() and newVirtualFile() are now inherited from \ref QContainer.  The
+ *   directory map type is unchanged.
+ *
+ * * The class no longer derives from Container::FileContainer, so it can not be passed where a
+ *   Container::FileContainer is expected.
+ *
+ * * \ref QFileContainer::open, \ref QFileContainer::close, \ref QFileContainer::filename and
+ *   \ref QFileContainer::errorString keep their signatures.  \ref QFileContainer::OpenMode is an alias of the
+ *   engine's open mode so existing open mode values still compile.
+ *
+ * The class can optionally maintain a write-ahead journal in a file named by appending "-journal" to the container
+ * file name.  When journaling is enabled, each committed transaction is appended to the journal and the journal is
+ * flushed to stable storage before the pages are written, in place, to the container file.  The container file is
+ * only flushed to stable storage when the journal is checkpointed, which happens when the journal grows beyond the
+ * checkpoint size and when the container is closed.  The directory update written when the container is closed is
+ * also journaled.  Any journal left behind by an interrupted process is replayed when the container is next opened.
  */
-class QFileContainer:public QObject, public Container::FileContainer {
+class QFileContainer:public QContainer {
     public:
         /**
-         * Type used for maps of virtual files by name.
+         * Type used to select how the file is opened.  The type is shared with Container::FileContainer so existing
+         * callers are unaffected by this class using \ref QContainer as its engine.
          */
-        typedef QMap<QString, QPointer<QVirtualFile>> DirectoryMap;
+        typedef ::Container::FileContainer::OpenMode OpenMode;
 
         /**
          * Constructor
@@ -56,6 +79,11 @@ class QFileContainer:public QObject, public Container::FileContainer {
          */
         QFileContainer(const QString& fileIdentifier, QObject* parent = Q_NULLPTR);
 
+        /**
+         * The default journal size, in bytes, that triggers a checkpoint.
+         */
+        static constexpr unsigned long long defaultJournalCheckpointSize = 16 * 1024 * 1024;
+
         ~QFileContainer() override;
 
         /**
@@ -66,6 +94,10 @@ class QFileContainer:public QObject, public Container::FileContainer {
          * You must call this method before performing any operations on the container.  You must also be sure that
          * there are no Container::VirtualFile instances instantiated for this container when this method is called.
          *
+         * A journal left by an interrupted process is replayed before the file is opened.  Replaying writes to the
+         * container file so a file with a pending journal can not be opened with OpenMode::READ_ONLY; open it for
+         * writing once to complete the interrupted transactions.
+         *
          * \param[in] filename The filename of the file to be opened.
          *
          * \param[in] openMode The open mode for the file.
@@ -74,13 +106,24 @@ class QFileContainer:public QObject, public Container::FileContainer {
          */
         bool open(const QString& filename, OpenMode openMode = OpenMode::READ_WRITE);
 
+        /**
+         * Method that reopens the file last opened with \ref QFileContainer::open(const QString&, OpenMode).  The
+         * same open mode is used except that \ref QFileContainer::OpenMode::OVERWRITE is replaced with
+         * \ref QFileContainer::OpenMode::READ_WRITE so that reopening never discards data.
+         *
+         * \return Returns true on success.  Returns false if no file has been opened or the file could not be
+         *         reopened.
+         */
+        bool open() override;
+
         /**
          * Method that should be called after all file operations are complete.  Forces all underlying virtual files
-         * to be flushed and closed and forces any data contained within the container to be flushed.
+         * to be flushed and closed and forces any data contained within the container to be flushed.  The journal,
+         * if any, is checkpointed and the file is closed.
          *
          * \return Returns true on success, returns false on error.
          */
-        bool close();
+        bool close() override;
 
         /**
          * Method you can use to obtain the filename of the currently open file.  An empty string will be returned
@@ -91,49 +134,229 @@ class QFileContainer:public QObject, public Container::FileContainer {
         QString filename() const;
 
         /**
-         * Returns a directory of all the streams in the container.
+         * Method you can use to obtain an error string from the last operation performed.
          *
-         * \return Returns a map, keyed by the stream name, of streams in the container.
+         * \return Returns a description of the error.
          */
-        DirectoryMap directory();
+        QString errorString() const override;
 
         /**
-         * Method you can call to create a new virtual file in the container.  The newly created file will be
-         * added to the directory.
+         * Method you can use to enable or disable the write-ahead journal.  The setting takes effect the next time
+         * the container is opened for writing.
          *
-         * \param[in] newVirtualFileName The new name to assign to this file.
+         * \param[in] nowEnabled If true, the journal will be enabled.  If false, the journal will be disabled.
+         */
+        void setJournalEnabled(bool nowEnabled = true);
+
+        /**
+         * Method you can use to determine if the write-ahead journal is enabled.
          *
-         * \return Returns the newly created virtual file.  A null pointer is returned on error.
+         * \return Returns true if the journal is enabled.  Returns false if the journal is disabled.
          */
-        QPointer<QVirtualFile> newVirtualFile(const QString& newVirtualFileName);
+        bool journalEnabled() const;
 
         /**
-         * Method you can use to obtain an error string from the last operation performed.
+         * Method you can use to set the journal size that triggers a checkpoint.
          *
-         * \return Returns a description of the error.
+         * \param[in] newCheckpointSize The journal size, in bytes.
          */
-        QString errorString() const;
+        void setJournalCheckpointSize(unsigned long long newCheckpointSize);
+
+        /**
+         * Method you can use to determine the journal size that triggers a checkpoint.
+         *
+         * \return Returns the journal size, in bytes.
+         */
+        unsigned long long journalCheckpointSize() const;
+
+        /**
+         * Method you can use to obtain the name of the journal used for a container file.
+         *
+         * \param[in] filename The name of the container file.
+         *
+         * \return Returns the name of the journal file.
+         */
+        static QString journalFilename(const QString& filename);
+
+        /**
+         * Method you can use to replay the journal for a closed container file.  Every complete transaction in the
+         * journal is written to the container file and the journal is then removed.  Incomplete or damaged records at
+         * the end of the journal are discarded.  Records are read and applied in pieces so journals larger than
+         * available memory can be replayed.  The method is called automatically when a container is opened for
+         * writing.
+         *
+         * \param[in] filename The name of the container file.
+         *
+         * \return Returns true on success or if there is no journal.  Returns false if the journal could not be
+         *         replayed.
+         */
+        static bool replayJournal(const QString& filename);
+
+    protected:
+        /**
+         * Method that is called when a transaction is committed, before any pages are written to the container
+         * file.  Appends the transaction to the journal and flushes the journal to stable storage.
+         *
+         * \param[in]  pageImages    The pages to be written, keyed by byte offset.
+         *
+         * \param[in]  truncatedSize The number of bytes at the start of the file kept by the transaction.
+         *
+         * \param[in]  containerSize The size of the container after the transaction.
+         *
+         * \param[out] durable       Set to true if the transaction was recorded in the journal.
+         *
+         * \return Returns true on success.  Returns false if the journal could not be written.
+         */
+        bool writeJournal(
+            const PageImages&  pageImages,
+            unsigned long long truncatedSize,
+            unsigned long long containerSize,
+            bool&              durable
+        ) override;
+
+        /**
+         * Method that is called after the pages of a journaled transaction have been written to the container file.
+         * Checkpoints the journal if it has grown beyond the checkpoint size.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool journalApplied() override;
+
+        /**
+         * Method that is called before data that is not part of a transaction reaches the container file.
+         * Checkpoints the journal if it holds records so that a later replay can not overwrite the data with older
+         * page images.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool beginUnjournaledWrite() override;
+
+        /**
+         * Method that is called to determine if committed transactions are journaled.
+         *
+         * \return Returns true if the journal is open.  Returns false if it is not.
+         */
+        bool journalActive() const override;
 
     private:
         /**
-         * Factory method that is called by the streaming API to create new virtual file instances.  You should
-         * overload this method if you wish to use the stremaing API to instantiate classes derived from
-         * Container::VirtualFile.
+         * Value used to identify journal records.
+         */
+        static constexpr quint32 journalRecordMagic = 0x4A514349;
+
+        /**
+         * The size of the fixed journal record header, in bytes.  The header holds the magic value, the page count,
+         * the truncated size, the container size and the total record size.
+         */
+        static constexpr unsigned journalHeaderSize = 32;
+
+        /**
+         * The size of the header preceding each page in a journal record, in bytes.  The header holds the page
+         * offset and the page length.
+         */
+        static constexpr unsigned journalPageHeaderSize = 12;
+
+        /**
+         * Method that flushes the container file to stable storage and empties the journal.
          *
-         * Upon creation, the newly created stream will be added to the directory.
+         * \return Returns true on success, returns false on error.
+         */
+        bool checkpointJournal();
+
+        /**
+         * The size of the pieces used to check and copy journal records during a replay, in bytes.
+         */
+        static constexpr unsigned journalReplayChunkSize = 1024 * 1024;
+
+        /**
+         * Method that calculates the CRC-32 checksum used to validate journal records.  The checksum of data
+         * presented in pieces is calculated by passing the checksum of the preceding pieces.
          *
-         * This version marshalls a call to QContainer::createFile(const QString&).
+         * \param[in] data     Pointer to the data to be checked.
+         *
+         * \param[in] count    The number of bytes to be checked.
+         *
+         * \param[in] checksum The checksum of the data preceding this piece.
+         *
+         * \return Returns the calculated checksum.
+         */
+        static quint32 journalChecksum(const char* data, unsigned long long count, quint32 checksum = 0);
+
+        /**
+         * Method that verifies the checksum of a journal record without reading the record into memory at once.
+         *
+         * \param[in] journal      The journal file.
+         *
+         * \param[in] recordOffset The offset of the record in the journal.
+         *
+         * \param[in] recordSize   The size of the record, including the trailing checksum.
+         *
+         * \return Returns true if the record is intact.  Returns false if the record is damaged or can not be read.
+         */
+        static bool checkJournalRecord(QFile& journal, unsigned long long recordOffset, unsigned long long recordSize);
+
+        /**
+         * Method that copies a page image from the journal into the container file.
          *
-         * \param[in] virtualFileName The name of the virtual file that should be created.
+         * \param[in] journal       The journal file.
          *
-         * \return Returns a newly created virtual file with the assigned name.
+         * \param[in] journalOffset The offset of the page image in the journal.
+         *
+         * \param[in] file          The container file.
+         *
+         * \param[in] fileOffset    The offset of the page in the container file.
+         *
+         * \param[in] length        The length of the page image, in bytes.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        static bool copyJournalData(
+            QFile&             journal,
+            unsigned long long journalOffset,
+            QFile&             file,
+            unsigned long long fileOffset,
+            unsigned long long length
+        );
+
+        /**
+         * The file holding the container.  A null pointer indicates the container is closed.
+         */
+        QFile* currentFile;
+
+        /**
+         * The name of the file last opened.  The value is used to reopen the file.
+         */
+        QString lastFilename;
+
+        /**
+         * The open mode last used to open the file.
+         */
+        OpenMode lastOpenMode;
+
+        /**
+         * Error string reported when the underlying file could not be opened.
+         */
+        QString fileErrorString;
+
+        /**
+         * Flag indicating if the write-ahead journal is enabled.
+         */
+        bool currentJournalEnabled;
+
+        /**
+         * The journal size that triggers a checkpoint.
+         */
+        unsigned long long currentJournalCheckpointSize;
+
+        /**
+         * The journal file.  A null pointer indicates that no journal is in use.
          */
-        ::Container::VirtualFile* createFile(const std::string& virtualFileName) final;
+        QFile* journalFile;
 
         /**
-         * Current list of translated virtual files.
+         * Flag indicating that the journal holds records that have not been checkpointed.
          */
-        DirectoryMap directoryMap;
+        bool journalPending;
 };
 
 #endif
@@ -27,8 +27,12 @@
 
 #include <QtGlobal>
 #include <QMap>
+#include <QList>
+#include <QByteArray>
 #include <QIODevice>
 #include <QObject>
+#include <QFuture>
+#include <QMutex>
 
 #include <memory>
 
@@ -51,16 +55,106 @@ class QVirtualFile:public QIODevice {
          *
          * \param[in] containerVirtualFile The underlying virtual file being marshalled by this class instance.
          *
-         * \param[in] parent               Pointer to the parent object.
+         * \param[in] name                 The name of this virtual file.
+         *
+         * \param[in] container            The container holding this virtual file.  The container is also used as
+         *                                 the parent object.
          */
-        QVirtualFile(std::shared_ptr<Container::VirtualFile> containerVirtualFile, QObject* parent);
+        QVirtualFile(
+            std::shared_ptr<Container::VirtualFile> containerVirtualFile,
+            const QString&                          name,
+            QContainer*                             container
+        );
 
     public:
+        /**
+         * Enumeration of access pattern hints you can supply to the container.  Hints are advisory and never alter
+         * the data read from or written to the virtual file.
+         */
+        enum class AccessHint {
+            /**
+             * Indicates no particular access pattern.  This is the default.
+             */
+            NORMAL,
+
+            /**
+             * Indicates the virtual file will be read sequentially.  The container will perform adaptive read-ahead
+             * into the block cache for reads from this virtual file and will advise the operating system accordingly.
+             */
+            SEQUENTIAL,
+
+            /**
+             * Indicates the virtual file will be accessed randomly.  The container will disable read-ahead for reads
+             * from this virtual file and will advise the operating system accordingly.
+             */
+            RANDOM,
+
+            /**
+             * One-shot hint indicating the container data will be needed soon.  The operating system is asked to
+             * begin reading the data in the background.  The current access pattern is not changed.
+             */
+            WILL_NEED,
+
+            /**
+             * One-shot hint indicating the container data is not expected to be needed soon.  The operating system
+             * is told it can release any cached pages.  The current access pattern is not changed.
+             */
+            DONT_NEED
+        };
+
+        /**
+         * Structure describing one buffer of a scatter read.
+         */
+        struct ReadVector {
+            /**
+             * The zero based offset into the virtual file of the first byte to be read into this buffer.
+             */
+            qint64 offset;
+
+            /**
+             * The buffer to receive the data.
+             */
+            char* data;
+
+            /**
+             * The number of bytes to be read into this buffer.
+             */
+            qint64 size;
+        };
+
+        /**
+         * Structure describing one buffer of a gather write.
+         */
+        struct WriteVector {
+            /**
+             * The zero based offset into the virtual file where this buffer should be written.
+             */
+            qint64 offset;
+
+            /**
+             * The buffer holding the data to be written.
+             */
+            const char* data;
+
+            /**
+             * The number of bytes to be written from this buffer.
+             */
+            qint64 size;
+        };
+
         ~QVirtualFile() override;
 
+        /**
+         * Method you can use to obtain the name of this virtual file.
+         *
+         * \return Returns the name of this virtual file.
+         */
+        QString name() const;
+
         /**
          * Method that deletes this file.  This virtual file object will no longer be valid after calling this
-         * method.
+         * method.  Staged data and queued asynchronous operations are committed and the device is closed before the
+         * file is removed from the container directory.  This object is then scheduled for deletion.
          *
          * \return Returns true on success, returns false on error.
          */
@@ -132,6 +226,141 @@ class QVirtualFile:public QIODevice {
          */
         std::shared_ptr<Container::VirtualFile> virtualFile();
 
+        /**
+         * Method you can use to obtain a view of a range of bytes in the virtual file.  The current position of the
+         * QIODevice is not modified.
+         *
+         * In \ref QContainer::IoMode::MAPPED mode, ranges the container engine stores verbatim are returned without
+         * copying, using QByteArray::fromRawData over the memory mapping.  The container learns where a virtual file
+         * is stored by tracing the device reads made the first time a range is viewed, so the first view of a range
+         * is read and copied.  A view over the mapping does not own its data and must not be used after the
+         * container is closed.  Copying the byte array, or modifying it, detaches it from the mapping.
+         *
+         * In all other cases, or when the engine does not store the range verbatim, the data is read directly from
+         * the underlying Container::VirtualFile into a single allocation, bypassing the QIODevice buffers.
+         *
+         * \param[in] offset The zero based offset into the virtual file of the first byte to be included.
+         *
+         * \param[in] length The number of bytes to be included.  Ranges extending past the end of the virtual file
+         *                   are clipped to the end of the virtual file.
+         *
+         * \return Returns a byte array holding the requested bytes.  A null byte array is returned on error.
+         */
+        QByteArray view(qint64 offset, qint64 length);
+
+        /**
+         * Method you can use to describe how this virtual file will be accessed.  The \ref AccessHint::NORMAL,
+         * \ref AccessHint::SEQUENTIAL, and \ref AccessHint::RANDOM hints set the access pattern for this virtual
+         * file only and are passed to the container with each read.  Sequential reads are advised to the operating
+         * system ahead of the reader.  The \ref AccessHint::WILL_NEED and \ref AccessHint::DONT_NEED hints are passed
+         * to the operating system immediately and do not change the access pattern.  As the container engine does
+         * not report where a virtual file is stored, these one-shot hints apply to the whole container.
+         *
+         * \param[in] hint The access hint.
+         */
+        void setAccessHint(AccessHint hint);
+
+        /**
+         * Method you can use to determine the current access pattern for this virtual file.
+         *
+         * \return Returns the current access pattern.  The value will be one of \ref AccessHint::NORMAL,
+         *         \ref AccessHint::SEQUENTIAL, or \ref AccessHint::RANDOM.
+         */
+        AccessHint accessHint() const;
+
+        /**
+         * Method you can use to read a range of the virtual file asynchronously.  The read is performed on the
+         * container's I/O thread and does not modify the current position of this device.  The readyRead signal is
+         * emitted, in the thread of the container, once the data is available.
+         *
+         * \param[in] offset The zero based offset into the virtual file of the first byte to be read.
+         *
+         * \param[in] size   The maximum number of bytes to be read.
+         *
+         * \return Returns a future holding the data read.  The future will hold a null byte array on error.
+         */
+        QFuture<QByteArray> readAsync(qint64 offset, qint64 size);
+
+        /**
+         * Method you can use to write data into the virtual file asynchronously.  The write is performed on the
+         * container's I/O thread and does not modify the current position of this device.  The bytesWritten signal
+         * is emitted, in the thread of the container, once the data has been written.
+         *
+         * \param[in] offset The zero based offset into the virtual file where the data should be written.
+         *
+         * \param[in] data   The data to be written.
+         *
+         * \return Returns a future holding the number of bytes written.  The future will hold -1 on error.
+         */
+        QFuture<qint64> writeAsync(qint64 offset, const QByteArray& data);
+
+        /**
+         * Method you can use to flush the virtual file's write cache asynchronously.  The flush is performed on the
+         * container's I/O thread after any previously queued asynchronous operations.
+         *
+         * \return Returns a future holding true on success or false on error.
+         */
+        QFuture<bool> flushAsync();
+
+        /**
+         * Method you can use to enable staged writes.  When staged writes are enabled, data written to this device
+         * is accumulated in a buffer owned by this virtual file without taking the container lock.  Full buffers, and
+         * buffers interrupted by a seek, are committed to the container on the container's I/O thread, which
+         * performs all block allocation, device writes and directory updates in order.  Several threads, each
+         * writing its own virtual file, can therefore produce data concurrently.
+         *
+         * Staged data is committed before data is read from this device, before vectored and asynchronous
+         * operations are issued, and when this device or the container is closed.  Staged writes are disabled by
+         * default.
+         *
+         * \param[in] newStagedWriteSize The staging buffer size, in bytes.  A value of zero disables staged writes
+         *                               after committing any staged data.
+         */
+        void setStagedWriteSize(qint64 newStagedWriteSize);
+
+        /**
+         * Method you can use to determine the staging buffer size.
+         *
+         * \return Returns the staging buffer size, in bytes.  A value of zero indicates that staged writes are
+         *         disabled.
+         */
+        qint64 stagedWriteSize() const;
+
+        /**
+         * Method you can use to commit any staged data and wait for all staged data to be written to the container.
+         * The method can be called from any thread.  Reads, views, seeks, and vectored and asynchronous operations
+         * call this method first so they are always ordered after previously staged data.
+         *
+         * \return Returns true on success.  Returns false if any staged data could not be written.
+         */
+        bool waitForCommit();
+
+        /**
+         * Method you can use to read several ranges of the virtual file in a single pass.  The ranges are sorted by
+         * offset and read in one pass under a single container lock, with contiguous ranges read back to back without
+         * repositioning.  The current position of this device is not modified.
+         *
+         * \param[in] vectors The buffers to be filled.  Ranges extending past the end of the virtual file are only
+         *                    partially filled.
+         *
+         * \return Returns the total number of bytes read.  A value of -1 is returned on error.
+         */
+        qint64 readv(const QList<ReadVector>& vectors);
+
+        /**
+         * Method you can use to write several ranges of the virtual file in a single pass.  The ranges are sorted by
+         * offset and written in one pass under a single container lock, with contiguous ranges written back to back
+         * without repositioning.  Ranges should not overlap.  The current position of this device is not modified.
+         *
+         * Note that data already held in the QIODevice read buffer is not updated by this method.  Open the device
+         * with QIODevice::Unbuffered if you intend to mix buffered reads with this method.
+         *
+         * \param[in] vectors The buffers to be written.
+         *
+         * \return Returns the total number of bytes written.  A value of -1 is returned on error.
+         */
+        qint64 writev(const QList<WriteVector>& vectors);
+
     protected:
         /**
          * This method is called by the QIODevice to perform all read functions and is used to tie the QIODevice to the
@@ -159,6 +388,106 @@ class QVirtualFile:public QIODevice {
 
     private:
         std::shared_ptr<Container::VirtualFile> currentVirtualFile;
+
+        /**
+         * The name of this virtual file.
+         */
+        QString currentName;
+
+        /**
+         * The container holding this virtual file.
+         */
+        QContainer* currentContainer;
+
+        /**
+         * Structure holding the per-file read state passed to the container with each read.
+         */
+        struct ReadState {
+            /**
+             * The current access pattern.
+             */
+            AccessHint accessHint;
+
+            /**
+             * The current read-ahead window, in bytes.
+             */
+            unsigned long long readAheadWindow;
+
+            /**
+             * The device offset just past the end of the last read.  Used to detect sequential access.
+             */
+            unsigned long long lastReadEnd;
+
+            /**
+             * The device offset up to which the operating system has been advised that data will be needed.
+             */
+            unsigned long long advisedEnd;
+        };
+
+        /**
+         * The read state of this virtual file.
+         */
+        ReadState readState;
+
+        /**
+         * Method that returns a view over the memory mapping for data just read by \ref QVirtualFile::view, if the
+         * traced device reads show the data is stored verbatim in the mapping.  The caller must hold the container
+         * lock.
+         *
+         * \param[in] data   The data read from the virtual file.
+         *
+         * \param[in] offset The zero based offset into the virtual file of the first byte of the data.
+         *
+         * \return Returns a byte array referencing the mapping or, if the data is not stored verbatim, the data.
+         */
+        QByteArray mappedView(const QByteArray& data, unsigned long long offset);
+
+        /**
+         * Method that queues the currently staged data for commit.  The caller must hold the staging lock.
+         */
+        void submitStagedData();
+
+        /**
+         * Lock protecting the staging state below.  The staging lock may be held while taking the container lock
+         * but must never be taken while holding the container lock.
+         */
+        mutable QMutex stagingMutex;
+
+        /**
+         * The staging buffer size.  A value of zero indicates that staged writes are disabled.
+         */
+        qint64 currentStagedWriteSize;
+
+        /**
+         * The offset into the virtual file of the first byte of staged data.
+         */
+        qint64 stagedOffset;
+
+        /**
+         * The staged data.
+         */
+        QByteArray stagedData;
+
+        /**
+         * The end of the furthest range of data queued for commit.
+         */
+        qint64 stagedEnd;
+
+        /**
+         * Commits that have been queued but not yet checked.
+         */
+        QList<QFuture<qint64>> pendingCommits;
+
+        /**
+         * Flag indicating that a commit has failed.
+         */
+        bool commitFailed;
+
+        /**
+         * The position of this device following the last staged write.  The virtual file position is restored to
+         * this value once staged data is committed since commits do not move the virtual file position.
+         */
+        qint64 stagedPosition;
 };
 
 #endif
@@ -0,0 +1,166 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref QVirtualFileHandle class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineqcontainer */
+
+#ifndef QVIRTUAL_FILE_HANDLE_H
+#define QVIRTUAL_FILE_HANDLE_H
+
+#include <QString>
+#include <QPointer>
+#include <QIODevice>
+
+class QContainer;
+class QVirtualFile;
+
+/**
+ * Lightweight value type that references a virtual file in a \ref QContainer by name.  Handles are cheap to create
+ * and copy.  The \ref QVirtualFile device for the referenced file is only created when it is requested through
+ * \ref QVirtualFileHandle::virtualFile or \ref QVirtualFileHandle::open.
+ *
+ * A handle must not be used after the container it references is destroyed.
+ */
+class QVirtualFileHandle {
+    public:
+        /**
+         * Constructor.  Creates an invalid handle.
+         */
+        QVirtualFileHandle();
+
+        /**
+         * Constructor
+         *
+         * \param[in] container The container holding the virtual file.
+         *
+         * \param[in] name      The name of the virtual file.
+         */
+        QVirtualFileHandle(QContainer* container, const QString& name);
+
+        /**
+         * Copy constructor
+         *
+         * \param[in] other The instance to be copied.
+         */
+        QVirtualFileHandle(const QVirtualFileHandle& other);
+
+        ~QVirtualFileHandle();
+
+        /**
+         * Method you can use to determine if this handle references a virtual file that currently exists.
+         *
+         * \return Returns true if the virtual file exists.  Returns false if the handle is invalid or the virtual file
+         *         has been erased.
+         */
+        bool isValid() const;
+
+        /**
+         * Method you can use to obtain the name of the referenced virtual file.
+         *
+         * \return Returns the name of the virtual file.
+         */
+        QString name() const;
+
+        /**
+         * Method you can use to obtain the container holding the referenced virtual file.
+         *
+         * \return Returns a pointer to the container.  A null pointer is returned for invalid handles.
+         */
+        QContainer* container() const;
+
+        /**
+         * Method you can use to determine the size of the referenced virtual file without creating a
+         * \ref QVirtualFile instance.
+         *
+         * \return Returns the size of the virtual file, in bytes.  A value of -1 is returned if the handle is invalid.
+         */
+        qint64 size() const;
+
+        /**
+         * Method you can use to obtain the \ref QVirtualFile device for the referenced virtual file.  The device is
+         * created on first use and is owned by the container.
+         *
+         * \return Returns the virtual file device.  A null pointer is returned if the handle is invalid.
+         */
+        QPointer<QVirtualFile> virtualFile() const;
+
+        /**
+         * Method you can use to obtain and open the \ref QVirtualFile device for the referenced virtual file.  A
+         * device that is already open is returned unchanged.
+         *
+         * \param[in] mode The open mode.
+         *
+         * \return Returns the opened virtual file device.  A null pointer is returned if the handle is invalid or the
+         *         device could not be opened.
+         */
+        QPointer<QVirtualFile> open(QIODevice::OpenMode mode) const;
+
+        /**
+         * Method you can use to erase the referenced virtual file without creating a \ref QVirtualFile instance.  If
+         * a device already exists for the file, the file is erased through \ref QVirtualFile::erase so staged data
+         * is committed and the device is closed first.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool erase() const;
+
+        /**
+         * Assignment operator
+         *
+         * \param[in] other The instance to assign to this instance.
+         *
+         * \return Returns a reference to this instance.
+         */
+        QVirtualFileHandle& operator=(const QVirtualFileHandle& other);
+
+        /**
+         * Comparison operator
+         *
+         * \param[in] other The instance to compare against this instance.
+         *
+         * \return Returns true if the handles reference the same virtual file.  Returns false if the handles
+         *         reference different virtual files.
+         */
+        bool operator==(const QVirtualFileHandle& other) const;
+
+        /**
+         * Comparison operator
+         *
+         * \param[in] other The instance to compare against this instance.
+         *
+         * \return Returns true if the handles reference different virtual files.  Returns false if the handles
+         *         reference the same virtual file.
+         */
+        bool operator!=(const QVirtualFileHandle& other) const;
+
+    private:
+        /**
+         * The container holding the virtual file.
+         */
+        QContainer* currentContainer;
+
+        /**
+         * The name of the virtual file.
+         */
+        QString currentName;
+};
+
+#endif
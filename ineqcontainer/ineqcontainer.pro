@@ -22,7 +22,7 @@ TEMPLATE = lib
 # Basic build characteristics
 #
 
-QT += core
+QT += core concurrent
 CONFIG += static c++14
 
 ########################################################################################################################
@@ -30,23 +30,42 @@ CONFIG += static c++14
 #
 
 INCLUDEPATH += include
-API_HEADERS = include/qcontainer.h \
+API_HEADERS = include/qarena_device.h \
+              include/qcontainer.h \
+              include/qcontainer_extractor.h \
+              include/qcontainer_importer.h \
               include/qfile_container.h \
               include/qvirtual_file.h \
+              include/qvirtual_file_handle.h \
+
+########################################################################################################################
+# Private includes
+#
+
+INCLUDEPATH += source
+PRIVATE_HEADERS = source/qcontainer_block_cache.h \
+                  source/qcontainer_snapshot.h \
 
 ########################################################################################################################
 # Source files
 #
 
-SOURCES = source/qcontainer.cpp \
+SOURCES = source/qarena_device.cpp \
+          source/qcontainer.cpp \
+          source/qcontainer_block_cache.cpp \
+          source/qcontainer_extractor.cpp \
+          source/qcontainer_importer.cpp \
+          source/qcontainer_snapshot.cpp \
           source/qfile_container.cpp \
           source/qvirtual_file.cpp \
+          source/qvirtual_file_handle.cpp \
 
 ########################################################################################################################
 # Setup headers and installation
 #
 
-HEADERS = $$API_HEADERS
+HEADERS = $$API_HEADERS \
+          $$PRIVATE_HEADERS
 
 ########################################################################################################################
 # Libraries
@@ -0,0 +1,254 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref QArenaDevice class.
+***********************************************************************************************************************/
+
+#include <QList>
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+
+#include <cstring>
+
+#include "qarena_device.h"
+
+QArenaDevice::QArenaDevice(QObject* parent):QIODevice(parent) {
+    currentChunkSize = defaultChunkSize;
+    currentSize      = 0;
+}
+
+
+QArenaDevice::QArenaDevice(unsigned chunkSize, QObject* parent):QIODevice(parent) {
+    currentChunkSize = chunkSize > 0 ? chunkSize : defaultChunkSize;
+    currentSize      = 0;
+}
+
+
+QArenaDevice::~QArenaDevice() {}
+
+
+unsigned QArenaDevice::chunkSize() const {
+    return currentChunkSize;
+}
+
+
+bool QArenaDevice::open(QIODevice::OpenMode mode) {
+    bool success = QIODevice::open(mode);
+
+    if (success) {
+        if ((mode & QIODevice::Truncate) != 0) {
+            clear();
+        }
+
+        if ((mode & QIODevice::Append) != 0) {
+            success = seek(currentSize);
+        }
+    }
+
+    return success;
+}
+
+
+qint64 QArenaDevice::size() const {
+    return currentSize;
+}
+
+
+bool QArenaDevice::resize(qint64 newSize) {
+    bool success;
+
+    if (newSize < 0) {
+        success = false;
+    } else {
+        if (newSize > currentSize) {
+            grow(newSize);
+        } else {
+            qint64 requiredChunks = (newSize + currentChunkSize - 1) / currentChunkSize;
+            while (chunks.size() > requiredChunks) {
+                chunks.removeLast();
+            }
+
+            currentSize = newSize;
+
+            if (pos() > newSize) {
+                seek(newSize);
+            }
+        }
+
+        success = true;
+    }
+
+    return success;
+}
+
+
+void QArenaDevice::clear() {
+    chunks.clear();
+    currentSize = 0;
+
+    if (isOpen() && pos() != 0) {
+        seek(0);
+    }
+}
+
+
+qint64 QArenaDevice::readAt(qint64 offset, char* data, qint64 maxSize) const {
+    qint64 bytesRead;
+
+    if (offset < 0 || maxSize < 0) {
+        bytesRead = -1;
+    } else {
+        qint64 endOffset = qMin(offset + maxSize, currentSize);
+        qint64 position  = offset;
+
+        while (position < endOffset) {
+            int    chunkIndex  = static_cast<int>(position / currentChunkSize);
+            qint64 chunkOffset = position % currentChunkSize;
+            qint64 count       = qMin(currentChunkSize - chunkOffset, endOffset - position);
+
+            std::memcpy(
+                data + (position - offset),
+                chunks.at(chunkIndex).constData() + chunkOffset,
+                static_cast<std::size_t>(count)
+            );
+
+            position += count;
+        }
+
+        bytesRead = position > offset ? position - offset : 0;
+    }
+
+    return bytesRead;
+}
+
+
+qint64 QArenaDevice::writeAt(qint64 offset, const char* data, qint64 size) {
+    qint64 bytesWritten;
+
+    if (offset < 0 || size < 0) {
+        bytesWritten = -1;
+    } else {
+        qint64 endOffset = offset + size;
+
+        if (offset > currentSize) {
+            grow(offset);
+        }
+
+        allocate(endOffset);
+
+        qint64 position = offset;
+        while (position < endOffset) {
+            int    chunkIndex  = static_cast<int>(position / currentChunkSize);
+            qint64 chunkOffset = position % currentChunkSize;
+            qint64 count       = qMin(currentChunkSize - chunkOffset, endOffset - position);
+
+            std::memcpy(
+                chunks[chunkIndex].data() + chunkOffset,
+                data + (position - offset),
+                static_cast<std::size_t>(count)
+            );
+
+            position += count;
+        }
+
+        if (endOffset > currentSize) {
+            currentSize = endOffset;
+        }
+
+        bytesWritten = size;
+    }
+
+    return bytesWritten;
+}
+
+
+qint64 QArenaDevice::writeTo(QIODevice* device) const {
+    qint64 bytesWritten = 0;
+
+    int chunkIndex = 0;
+    while (bytesWritten >= 0 && bytesWritten < currentSize) {
+        const char* chunkData = chunks.at(chunkIndex).constData();
+        qint64      count     = qMin(static_cast<qint64>(currentChunkSize), currentSize - bytesWritten);
+        qint64      written   = 0;
+
+        while (written >= 0 && written < count) {
+            qint64 result = device->write(chunkData + written, count - written);
+            if (result > 0) {
+                written += result;
+            } else {
+                written = -1;
+            }
+        }
+
+        if (written < 0) {
+            bytesWritten = -1;
+        } else {
+            bytesWritten += count;
+            ++chunkIndex;
+        }
+    }
+
+    return bytesWritten;
+}
+
+
+QByteArray QArenaDevice::toByteArray() const {
+    QByteArray result(static_cast<int>(currentSize), Qt::Uninitialized);
+    readAt(0, result.data(), currentSize);
+
+    return result;
+}
+
+
+qint64 QArenaDevice::readData(char* data, qint64 maxSize) {
+    return readAt(pos(), data, maxSize);
+}
+
+
+qint64 QArenaDevice::writeData(const char* data, qint64 size) {
+    return writeAt(pos(), data, size);
+}
+
+
+void QArenaDevice::allocate(qint64 newSize) {
+    qint64 requiredChunks = (newSize + currentChunkSize - 1) / currentChunkSize;
+    while (chunks.size() < requiredChunks) {
+        chunks.append(QByteArray(static_cast<int>(currentChunkSize), Qt::Uninitialized));
+    }
+}
+
+
+void QArenaDevice::grow(qint64 newSize) {
+    allocate(newSize);
+
+    // Chunks retained across a shrink may hold stale data so we explicitly zero the new space.
+
+    qint64 position = currentSize;
+    while (position < newSize) {
+        int    chunkIndex  = static_cast<int>(position / currentChunkSize);
+        qint64 chunkOffset = position % currentChunkSize;
+        qint64 count       = qMin(currentChunkSize - chunkOffset, newSize - position);
+
+        std::memset(chunks[chunkIndex].data() + chunkOffset, 0, static_cast<std::size_t>(count));
+        position += count;
+    }
+
+    currentSize = newSize;
+}
@@ -21,15 +21,44 @@
 ***********************************************************************************************************************/
 
 #include <QMap>
+#include <QHash>
 #include <QList>
+#include <QByteArray>
 #include <QIODevice>
+#include <QFileDevice>
+#include <QFile>
+#include <QBuffer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadPool>
 #include <QObject>
+#include <QString>
+#include <QRegularExpression>
+#include <QRegularExpressionMatch>
+#include <QElapsedTimer>
+
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <cerrno>
+#include <functional>
+
+#if (defined(Q_OS_UNIX))
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+#elif (defined(Q_OS_WIN))
+    #include <io.h>
+#endif
 
 #include <container_status.h>
 #include <container_virtual_file.h>
 #include <container_container.h>
 
 #include "qvirtual_file.h"
+#include "qarena_device.h"
+#include "qcontainer_block_cache.h"
+#include "qcontainer_snapshot.h"
 #include "qcontainer.h"
 
 QContainer::QContainer(
@@ -40,7 +69,7 @@ QContainer::QContainer(
     ),Container(
         fileIdentifier.toStdString()
     ) {
-    currentDevice = Q_NULLPTR;
+    initialize(fileIdentifier);
 }
 
 
@@ -53,223 +82,2885 @@ QContainer::QContainer(
     ),Container(
         fileIdentifier.toStdString()
     ) {
+    initialize(fileIdentifier);
     setDevice(device);
 }
 
 
-QContainer::~QContainer() {}
+QContainer::~QContainer() {
+    ioThreadPool->waitForDone();
+    delete blockCache;
+}
+
+
+void QContainer::initialize(const QString& fileIdentifier) {
+    currentDevice             = Q_NULLPTR;
+    currentRequestedIoMode    = IoMode::DEVICE;
+    currentIoMode             = IoMode::DEVICE;
+    currentFlushMode          = FlushMode::BUFFERED;
+    fileDescriptor            = -1;
+    mappedData                = Q_NULLPTR;
+    viewTracing               = false;
+    viewTraceReads            = 0;
+    viewTraceBuffer           = Q_NULLPTR;
+    viewTraceOffset           = 0;
+    viewTraceCount            = 0;
+    arenaDevice               = Q_NULLPTR;
+    currentStreamMode         = StreamMode::AUTOMATIC;
+    currentFileIdentifier     = fileIdentifier;
+    currentLazyOpen           = false;
+    openPending               = false;
+    engineOpen                = false;
+    directoryDirty            = false;
+    streamArena               = Q_NULLPTR;
+    transactionActive         = false;
+    transactionCommitOnClose  = false;
+    compactionPhase           = CompactionPhase::SCAN;
+    compactionPassComplete    = false;
+    compactionOffset          = 0;
+    compactionDirty           = false;
+    compactionTracing         = false;
+    compactionTraced          = false;
+    compactionTraceOffset     = 0;
+    transactionStartSize      = 0;
+    transactionStorageSize    = 0;
+    trackedSize               = 0;
+    trackedPosition           = 0;
+    blockCache                = new QContainerBlockCache;
+    activeReadState           = Q_NULLPTR;
+    currentMaximumReadAhead   = defaultMaximumReadAhead;
+    pendingWriteOffset        = 0;
+    currentWriteCombiningSize = 0;
+    ioThreadPool              = new QThreadPool(this);
+
+    ioThreadPool->setMaxThreadCount(1);
+}
+
+
+void QContainer::setDevice(QIODevice* device) {
+    attachDevice(device);
+    setParent(currentDevice);
+}
+
+
+QIODevice* QContainer::device() {
+    return currentDevice;
+}
+
+
+void QContainer::setIoMode(QContainer::IoMode newIoMode) {
+    currentRequestedIoMode = newIoMode;
+}
+
+
+QContainer::IoMode QContainer::requestedIoMode() const {
+    return currentRequestedIoMode;
+}
+
+
+QContainer::IoMode QContainer::ioMode() const {
+    return currentIoMode;
+}
+
+
+void QContainer::setFlushMode(QContainer::FlushMode newFlushMode) {
+    currentFlushMode = newFlushMode;
+}
+
+
+QContainer::FlushMode QContainer::flushMode() const {
+    return currentFlushMode;
+}
+
+
+void QContainer::setStreamMode(QContainer::StreamMode newStreamMode) {
+    currentStreamMode = newStreamMode;
+}
+
+
+QContainer::StreamMode QContainer::streamMode() const {
+    return currentStreamMode;
+}
+
+
+void QContainer::setBlockCacheSize(unsigned long long newBlockCacheSize) {
+    QMutexLocker locker(&ioMutex);
+
+    blockCache->setMaximumSize(newBlockCacheSize);
+}
+
+
+unsigned long long QContainer::blockCacheSize() const {
+    return blockCache->maximumSize();
+}
+
+
+unsigned long long QContainer::blockCacheHits() const {
+    return blockCache->hits();
+}
+
+
+unsigned long long QContainer::blockCacheMisses() const {
+    return blockCache->misses();
+}
+
+
+void QContainer::resetBlockCacheStatistics() {
+    QMutexLocker locker(&ioMutex);
+
+    blockCache->resetStatistics();
+}
+
+
+void QContainer::setMaximumReadAhead(unsigned long long newMaximumReadAhead) {
+    currentMaximumReadAhead = newMaximumReadAhead;
+}
+
+
+unsigned long long QContainer::maximumReadAhead() const {
+    return currentMaximumReadAhead;
+}
+
+
+bool QContainer::setWriteCombiningSize(unsigned long long newWriteCombiningSize) {
+    QMutexLocker locker(&ioMutex);
+    int          errorCode = 0;
+    bool         success   = flushPendingWrite(errorCode);
+
+    if (success) {
+        currentWriteCombiningSize = newWriteCombiningSize;
+    }
+
+    return success;
+}
+
+
+unsigned long long QContainer::writeCombiningSize() const {
+    return currentWriteCombiningSize;
+}
+
+
+void QContainer::setLazyOpen(bool nowLazyOpen) {
+    currentLazyOpen = nowLazyOpen;
+}
+
+
+bool QContainer::lazyOpen() const {
+    return currentLazyOpen;
+}
+
+
+bool QContainer::open() {
+    QMutexLocker locker(&ioMutex);
+    bool         success;
+
+    if (currentDevice != Q_NULLPTR && currentDevice->isSequential() && !loadStream()) {
+        success = false;
+    } else {
+        configureIoMode();
+
+        if (currentLazyOpen && currentDevice != Q_NULLPTR && !currentDevice->isSequential() && trackedSize > 0) {
+            success = checkFileIdentifier();
+            if (success) {
+                openPending = true;
+            } else {
+                releaseIoMode();
+            }
+        } else {
+            success = openEngine();
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::close() {
+    bool stagedCommitted = commitStagedWrites();
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    bool         success;
+
+    if (openPending) {
+        // The container engine was never opened so there is nothing to write back.
+
+        openPending = false;
+        releaseIoMode();
+
+        success = true;
+    } else {
+        bool                compactionSettled = settleCompaction();
+        ::Container::Status status            = ::Container::Container::close();
+
+        resetCompaction();
+
+        // Combined writes, including the directory written by the engine, must reach the transaction overlay before
+        // the overlay is committed or discarded.
+
+        int  errorCode      = 0;
+        bool pendingFlushed = flushPendingWrite(errorCode);
+
+        if (transactionActive) {
+            // Changes made by an uncommitted transaction, including the directory written by the engine on close,
+            // are discarded unless the transaction was started to be committed on close.
+
+            if (!transactionCommitOnClose || status || !pendingFlushed) {
+                rollbackOverlay();
+            } else if (!commitOverlay(errorCode)) {
+                rollbackOverlay();
+                status = ::Container::FileWriteError("", trackedPosition, errorCode);
+            }
+        }
+
+        bool streamStored = !status && pendingFlushed && storeStream();
+
+        releaseIoMode();
+        engineOpen = false;
+
+        if (streamArena != Q_NULLPTR) {
+            streamArena->clear();
+        }
+
+        if (status || !pendingFlushed || !streamStored || !stagedCommitted || !compactionSettled) {
+            success = false;
+        } else {
+            success = true;
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::beginTransaction() {
+    commitStagedWrites();
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    bool         success;
+
+    // Changes made outside of a transaction are written before the transaction starts so the device holds the state
+    // that a rollback restores.  Snapshots and readers opened during the transaction see this state.  An unchanged
+    // directory is not rewritten.
+
+    int errorCode = 0;
+    if (!ensureOpen() || transactionActive || currentIoMode == IoMode::MAPPED || !persistDirectory(errorCode)) {
+        success = false;
+    } else {
+        transactionActive        = true;
+        transactionCommitOnClose = false;
+        transactionStartSize     = trackedSize;
+        transactionStorageSize   = trackedSize;
+
+        success = true;
+    }
+
+    return success;
+}
+
+
+bool QContainer::commitTransaction() {
+    bool stagedCommitted = commitStagedWrites();
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    bool         success;
+
+    if (!transactionActive) {
+        success = false;
+    } else {
+        // Write the directory, along with data held by the engine and the write combining buffer, into the overlay
+        // so that it is committed with the data it describes.
+
+        int errorCode = 0;
+        success = stagedCommitted && writeDirectory(errorCode) && commitOverlay(errorCode);
+    }
+
+    return success;
+}
+
+
+bool QContainer::rollbackTransaction() {
+    commitStagedWrites();
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    bool         success;
+
+    if (!transactionActive) {
+        success = false;
+    } else {
+        // Closing the engine writes its state into the overlay which is then discarded.  Reopening the engine
+        // reloads the state committed to the device.
+
+        settleCompaction();
+        ::Container::Container::close();
+        rollbackOverlay();
+
+        ::Container::Status status = ::Container::Container::open();
+        if (status) {
+            engineOpen = false;
+            success    = false;
+        } else {
+            synchronizeDirectory();
+
+            directoryDirty = false;
+            success        = true;
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::inTransaction() const {
+    return transactionActive;
+}
+
+
+bool QContainer::beginCloseTransaction() {
+    bool success = beginTransaction();
+
+    if (success) {
+        QMutexLocker locker(&ioMutex);
+        transactionCommitOnClose = true;
+    }
+
+    return success;
+}
+
+
+bool QContainer::writeJournal(const PageImages&, unsigned long long, unsigned long long, bool& durable) {
+    durable = false;
+    return true;
+}
+
+
+bool QContainer::journalApplied() {
+    return true;
+}
+
+
+bool QContainer::beginUnjournaledWrite() {
+    return true;
+}
+
+
+bool QContainer::journalActive() const {
+    return false;
+}
+
+
+bool QContainer::syncDevice(QFileDevice* fileDevice, bool durable, int& errorCode) {
+    bool success = fileDevice->flush();
+
+    if (success && durable) {
+        int handle = fileDevice->handle();
+        if (handle >= 0) {
+            #if (defined(Q_OS_UNIX))
+
+                success = (::fsync(handle) == 0);
+
+            #elif (defined(Q_OS_WIN))
+
+                success = (::_commit(handle) == 0);
+
+            #endif
+
+            if (!success) {
+                errorCode = errno;
+            }
+        }
+    } else if (!success) {
+        errorCode = static_cast<int>(fileDevice->error());
+    }
+
+    return success;
+}
+
+
+bool QContainer::compactStep(unsigned long long byteBudget, unsigned long timeBudget) {
+    commitStagedWrites();
+    ioThreadPool->waitForDone();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QMutexLocker locker(&ioMutex);
+    bool         success = ensureOpen() && currentIoMode != IoMode::MAPPED && currentDevice->isWritable();
+
+    if (success && compactionPassComplete) {
+        resetCompaction();
+    }
+
+    // Each iteration samples one file, selects one file or copies one chunk so the budget is checked often and a
+    // step can stop part way through a file.  The next step resumes from the saved state.
+
+    unsigned long long bytesCopied = 0;
+    bool               budgetUsed  = false;
+
+    while (success && !budgetUsed && !compactionPassComplete) {
+        switch (compactionPhase) {
+            case CompactionPhase::SCAN: {
+                success = scanCompaction();
+                break;
+            }
+
+            case CompactionPhase::SELECT: {
+                success = selectCompaction();
+                break;
+            }
+
+            case CompactionPhase::COPY:
+            case CompactionPhase::RESTORE: {
+                success = copyCompactionChunk(bytesCopied);
+                break;
+            }
+        }
+
+        budgetUsed = (
+               (byteBudget != 0 && bytesCopied >= byteBudget)
+            || (timeBudget != 0 && static_cast<unsigned long>(timer.elapsed()) >= timeBudget)
+        );
+    }
+
+    if (success && compactionPassComplete) {
+        // Writing the directory lets the engine truncate the space freed at the end of the container.
+
+        int errorCode = 0;
+        success = persistDirectory(errorCode);
+    }
+
+    return success;
+}
+
+
+bool QContainer::compactionComplete() const {
+    return compactionPassComplete;
+}
+
+
+QContainer::Statistics QContainer::statistics() {
+    QMutexLocker locker(&ioMutex);
+    Statistics   result;
+    bool         containerOpen = ensureOpen();
+
+    result.totalSize = containerOpen ? trackedSize : 0;
+    result.liveSize  = 0;
+
+    if (containerOpen) {
+        for (DirectoryIndex::const_iterator it=directoryIndex.constBegin() ; it!=directoryIndex.constEnd() ; ++it) {
+            unsigned long long fileSize = it->virtualFile->size();
+
+            result.fileSizes.insert(it.key(), fileSize);
+            result.liveSize += fileSize;
+        }
+    }
+
+    result.slackSize  = result.totalSize > result.liveSize ? result.totalSize - result.liveSize : 0;
+    result.slackRatio = result.totalSize > 0 ? static_cast<double>(result.slackSize) / result.totalSize : 0.0;
+
+    return result;
+}
+
+
+bool QContainer::validate() {
+    QMutexLocker locker(&ioMutex);
+    return ensureOpen();
+}
+
+
+QContainer* QContainer::openReader(QObject* parent) {
+    commitStagedWrites();
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    QContainer*  reader = Q_NULLPTR;
+
+    QFileDevice* fileDevice = qobject_cast<QFileDevice*>(currentDevice);
+    if (ensureOpen() && fileDevice != Q_NULLPTR && !fileDevice->fileName().isEmpty()) {
+        int errorCode = 0;
+        if (persistDirectory(errorCode) && syncStorage(false, errorCode)) {
+            QFile* file = new QFile(fileDevice->fileName());
+            if (file->open(QIODevice::ReadOnly)) {
+                reader = new QContainer(currentFileIdentifier, parent);
+                reader->attachDevice(file);
+                file->setParent(reader);
+
+                // A mapping would fault if this container later shrinks the file so readers use positional I/O.
+
+                reader->setIoMode(IoMode::POSITIONAL);
+                reader->setBlockCacheSize(blockCache->maximumSize());
+                reader->setMaximumReadAhead(currentMaximumReadAhead);
+
+                if (!reader->open()) {
+                    delete reader;
+                    reader = Q_NULLPTR;
+                }
+            } else {
+                delete file;
+            }
+        }
+    }
+
+    return reader;
+}
+
+
+QContainer* QContainer::snapshot(QObject* parent) {
+    commitStagedWrites();
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    QContainer*  result = Q_NULLPTR;
+
+    QFileDevice* fileDevice = qobject_cast<QFileDevice*>(currentDevice);
+    if (ensureOpen() && fileDevice != Q_NULLPTR && !fileDevice->fileName().isEmpty()) {
+        // Push data held by the engine, the directory and the write combining buffer to the file so the snapshot
+        // starts from the current state of the container.  Pages overwritten while the directory is written are
+        // preserved for earlier snapshots.
+
+        bool success = true;
+        for (DirectoryIndex::const_iterator it=directoryIndex.constBegin() ; it!=directoryIndex.constEnd() ; ++it) {
+            if (it->virtualFile->flush()) {
+                success = false;
+            }
+        }
+
+        int errorCode = 0;
+        if (success && persistDirectory(errorCode) && syncStorage(false, errorCode)) {
+            unsigned long long snapshotSize = transactionActive ? transactionStartSize : trackedSize;
+
+            std::shared_ptr<QContainerSnapshotPages> pages = std::make_shared<QContainerSnapshotPages>(snapshotSize);
+            QContainerSnapshot*                      device = new QContainerSnapshot(fileDevice->fileName(), pages);
+
+            if (device->open(QIODevice::ReadOnly)) {
+                snapshotPages.append(pages);
+
+                result = new QContainer(currentFileIdentifier, parent);
+                result->attachDevice(device);
+                device->setParent(result);
+
+                result->setBlockCacheSize(blockCache->maximumSize());
+                result->setMaximumReadAhead(currentMaximumReadAhead);
+
+                if (!result->open()) {
+                    delete result;
+                    result = Q_NULLPTR;
+                }
+            } else {
+                delete device;
+            }
+        }
+    }
+
+    return result;
+}
+
+
+QContainer::DirectoryMap QContainer::directory() {
+    QMutexLocker locker(&ioMutex);
+    DirectoryMap result;
+
+    if (ensureOpen()) {
+        // Only listed files are materialized.  Metadata files materialized by name are left out of the result.
+
+        for (HandleMap::const_iterator it=handleMap.constBegin() ; it!=handleMap.constEnd() ; ++it) {
+            result.insert(it.key(), materialize(it.key()));
+        }
+    }
+
+    return result;
+}
+
+
+QContainer::HandleMap QContainer::handles() {
+    QMutexLocker locker(&ioMutex);
+    return ensureOpen() ? handleMap : HandleMap();
+}
+
+
+QVirtualFileHandle QContainer::handle(const QString& virtualFileName) {
+    QMutexLocker locker(&ioMutex);
+    return ensureOpen() ? handleMap.value(virtualFileName) : QVirtualFileHandle();
+}
+
+
+QContainer::HandleMap QContainer::listPrefix(const QString& prefix) {
+    QMutexLocker locker(&ioMutex);
+    return ensureOpen() ? handlesWithPrefix(prefix) : HandleMap();
+}
+
+
+QContainer::HandleMap QContainer::glob(const QString& pattern) {
+    HandleMap result;
+
+    int                wildcardIndex = pattern.indexOf(QRegularExpression(QString("[*?\\[]")));
+    QString            prefix        = wildcardIndex < 0 ? pattern : pattern.left(wildcardIndex);
+    QRegularExpression expression(wildcardExpression(pattern), QRegularExpression::DotMatchesEverythingOption);
+
+    QMutexLocker locker(&ioMutex);
+
+    HandleMap candidates = ensureOpen() ? handlesWithPrefix(prefix) : HandleMap();
+
+    for (HandleMap::const_iterator it=candidates.constBegin() ; it!=candidates.constEnd() ; ++it) {
+        if (expression.match(it.key()).hasMatch()) {
+            result.insert(it.key(), it.value());
+        }
+    }
+
+    return result;
+}
+
+
+QString QContainer::wildcardExpression(const QString& pattern) {
+    QString expression;
+    int     length = pattern.length();
+    int     index  = 0;
+
+    while (index < length) {
+        QChar character = pattern.at(index);
+
+        if (character == QChar('*')) {
+            expression += QString(".*");
+            ++index;
+        } else if (character == QChar('?')) {
+            expression += QChar('.');
+            ++index;
+        } else if (character == QChar('[')) {
+            // Locate the end of the character class.  A leading '!' negates the class and a ']' immediately
+            // following the opening bracket, or the negation, is taken literally.
+
+            int classStart = index + 1;
+            int classEnd   = classStart;
+
+            if (classEnd < length && pattern.at(classEnd) == QChar('!')) {
+                ++classEnd;
+            }
+
+            if (classEnd < length && pattern.at(classEnd) == QChar(']')) {
+                ++classEnd;
+            }
+
+            while (classEnd < length && pattern.at(classEnd) != QChar(']')) {
+                ++classEnd;
+            }
+
+            if (classEnd >= length) {
+                // An unterminated class is matched as a literal '['.
+
+                expression += QString("\\[");
+                ++index;
+            } else {
+                expression += QChar('[');
+
+                int classIndex = classStart;
+                if (pattern.at(classIndex) == QChar('!')) {
+                    expression += QChar('^');
+                    ++classIndex;
+                }
+
+                while (classIndex < classEnd) {
+                    QChar classCharacter = pattern.at(classIndex);
+                    if (classCharacter == QChar('\\')
+                        || classCharacter == QChar('[')
+                        || classCharacter == QChar(']')
+                        || classCharacter == QChar('^')) {
+                        expression += QChar('\\');
+                    }
+
+                    expression += classCharacter;
+                    ++classIndex;
+                }
+
+                expression += QChar(']');
+                index = classEnd + 1;
+            }
+        } else {
+            expression += QRegularExpression::escape(QString(character));
+            ++index;
+        }
+    }
+
+    return QRegularExpression::anchoredPattern(expression);
+}
+
+
+QPointer<QVirtualFile> QContainer::virtualFile(const QString& virtualFileName) {
+    QMutexLocker locker(&ioMutex);
+    return ensureOpen() ? materialize(virtualFileName) : QPointer<QVirtualFile>();
+}
+
+
+bool QContainer::writeVirtualFile(const QString& virtualFileName, const QByteArray& data) {
+    // Staged and queued writes to the file being replaced must complete first so they can not land in the new file.
+
+    bool stagedCommitted = commitStagedWrites(virtualFileName);
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    bool         success;
+
+    std::shared_ptr<::Container::VirtualFile> vf;
+    if (ensureOpen()) {
+        vf = replaceVirtualFile(virtualFileName);
+    }
+
+    success = stagedCommitted && static_cast<bool>(vf);
+    if (success) {
+        ::Container::Status status = vf->write(
+            reinterpret_cast<const std::uint8_t*>(data.constData()),
+            static_cast<unsigned long long>(data.size())
+        );
+
+        success = (status.success() && !vf->flush());
+    }
+
+    return success;
+}
+
+
+bool QContainer::appendVirtualFile(const QString& virtualFileName, const QByteArray& data) {
+    // Staged and queued writes to the file must reach the engine first so the new data lands after them.
+
+    bool stagedCommitted = commitStagedWrites(virtualFileName);
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    bool         success;
+
+    DirectoryIndex::const_iterator it = directoryIndex.constEnd();
+    if (ensureOpen()) {
+        it = directoryIndex.constFind(virtualFileName);
+    }
+
+    if (!stagedCommitted
+        || it == directoryIndex.constEnd()
+        || (!it->device.isNull() && it->device->isOpen())) {
+        success = false;
+    } else {
+        // Restore the file position afterwards since a device for this file may be tracking it.
+
+        std::shared_ptr<::Container::VirtualFile> vf               = it->virtualFile;
+        unsigned long long                        originalPosition = vf->position();
+        ::Container::Status                       status           = vf->setPosition(vf->size());
+
+        if (status) {
+            success = false;
+        } else {
+            status = vf->write(
+                reinterpret_cast<const std::uint8_t*>(data.constData()),
+                static_cast<unsigned long long>(data.size())
+            );
+
+            success = (status.success() && !vf->flush());
+        }
+
+        vf->setPosition(originalPosition);
+
+        virtualFileWritten(virtualFileName);
+    }
+
+    return success;
+}
+
+
+bool QContainer::readVirtualFile(const QString& virtualFileName, QByteArray& data) {
+    // Staged and queued writes must reach the engine so the current contents are read.
+
+    bool stagedCommitted = commitStagedWrites(virtualFileName);
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    bool         success;
+
+    DirectoryIndex::const_iterator it = directoryIndex.constEnd();
+    if (ensureOpen()) {
+        it = directoryIndex.constFind(virtualFileName);
+    }
+
+    if (!stagedCommitted || it == directoryIndex.constEnd()) {
+        success = false;
+    } else {
+        std::shared_ptr<::Container::VirtualFile> vf       = it->virtualFile;
+        unsigned long long                        fileSize = vf->size();
+
+        if (fileSize > static_cast<unsigned long long>(std::numeric_limits<int>::max())) {
+            success = false;
+        } else {
+            // Restore the file position afterwards since a device for this file may be tracking it.
+
+            unsigned long long  originalPosition = vf->position();
+            ::Container::Status status           = vf->setPosition(0);
+
+            data.resize(static_cast<int>(fileSize));
+            if (!status) {
+                status = vf->read(reinterpret_cast<std::uint8_t*>(data.data()), fileSize);
+            }
+
+            success = (status.success() && ::Container::ReadSuccessful(status).bytesRead() == fileSize);
+            vf->setPosition(originalPosition);
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::readVirtualFile(
+        const QString&     virtualFileName,
+        unsigned long long offset,
+        unsigned long long maximumLength,
+        QByteArray&        data
+    ) {
+    bool stagedCommitted = commitStagedWrites(virtualFileName);
+    ioThreadPool->waitForDone();
+
+    QMutexLocker locker(&ioMutex);
+    bool         success;
+
+    DirectoryIndex::const_iterator it = directoryIndex.constEnd();
+    if (ensureOpen()) {
+        it = directoryIndex.constFind(virtualFileName);
+    }
+
+    if (!stagedCommitted
+        || it == directoryIndex.constEnd()
+        || maximumLength > static_cast<unsigned long long>(std::numeric_limits<int>::max())) {
+        success = false;
+    } else {
+        std::shared_ptr<::Container::VirtualFile> vf        = it->virtualFile;
+        unsigned long long                        fileSize  = vf->size();
+        unsigned long long                        readCount = 0;
+
+        if (offset < fileSize) {
+            readCount = qMin(fileSize - offset, maximumLength);
+        }
+
+        // Restore the file position afterwards since a device for this file may be tracking it.
+
+        unsigned long long  originalPosition = vf->position();
+        ::Container::Status status           = vf->setPosition(qMin(offset, fileSize));
+
+        data.resize(static_cast<int>(readCount));
+        if (status) {
+            success = false;
+        } else if (readCount > 0) {
+            status  = vf->read(reinterpret_cast<std::uint8_t*>(data.data()), readCount);
+            success = (status.success() && ::Container::ReadSuccessful(status).bytesRead() == readCount);
+        } else {
+            success = true;
+        }
+
+        vf->setPosition(originalPosition);
+    }
+
+    return success;
+}
+
+
+unsigned long long QContainer::storageOffset(const QString& virtualFileName) {
+    commitStagedWrites(virtualFileName);
+    ioThreadPool->waitForDone();
+
+    QMutexLocker       locker(&ioMutex);
+    unsigned long long result = ~0ULL;
+
+    DirectoryIndex::const_iterator it = directoryIndex.constEnd();
+    if (ensureOpen()) {
+        it = directoryIndex.constFind(virtualFileName);
+    }
+
+    if (it != directoryIndex.constEnd() && it->virtualFile->size() > 0) {
+        std::shared_ptr<::Container::VirtualFile> vf               = it->virtualFile;
+        unsigned long long                        originalPosition = vf->position();
+        std::uint8_t                              byte;
+
+        compactionTracing = true;
+        compactionTraced  = false;
+
+        bool success = !vf->setPosition(0) && vf->read(&byte, 1).success();
+
+        compactionTracing = false;
+        vf->setPosition(originalPosition);
+
+        if (success && compactionTraced) {
+            result = compactionTraceOffset;
+        }
+    }
+
+    return result;
+}
+
+
+bool QContainer::copyVirtualFile(
+        const QString& virtualFileName,
+        QContainer*    destination,
+        const QString& newVirtualFileName
+    ) {
+    bool success;
+
+    if (destination == Q_NULLPTR || (destination == this && newVirtualFileName == virtualFileName)) {
+        success = false;
+    } else {
+        // Staged and queued writes to the source must reach the engine before it is read.  Those to the
+        // destination must complete before it is replaced so they can not land in the copy.
+
+        bool stagedCommitted = (
+               commitStagedWrites(virtualFileName)
+            && destination->commitStagedWrites(newVirtualFileName)
+        );
+
+        ioThreadPool->waitForDone();
+        destination->ioThreadPool->waitForDone();
+
+        // Both locks are always taken in address order so concurrent copies in opposite directions can not
+        // deadlock.
+
+        bool    destinationFirst = std::less<QContainer*>()(destination, this);
+        QMutex* firstMutex       = destinationFirst ? &destination->ioMutex : &ioMutex;
+        QMutex* secondMutex      = destinationFirst ? &ioMutex : &destination->ioMutex;
+
+        QMutexLocker firstLocker(firstMutex);
+        QMutexLocker secondLocker(secondMutex != firstMutex ? secondMutex : Q_NULLPTR);
+
+        DirectoryIndex::const_iterator it = directoryIndex.constEnd();
+        if (ensureOpen() && destination->ensureOpen()) {
+            it = directoryIndex.constFind(virtualFileName);
+        }
+
+        if (!stagedCommitted || it == directoryIndex.constEnd()) {
+            success = false;
+        } else {
+            std::shared_ptr<::Container::VirtualFile> source = it->virtualFile;
+            std::shared_ptr<::Container::VirtualFile> copy   = destination->replaceVirtualFile(newVirtualFileName);
+
+            success = static_cast<bool>(copy);
+            if (success) {
+                // Restore the source position afterwards since a device for the file may be tracking it.
+
+                unsigned long long originalPosition = source->position();
+                unsigned long long fileSize         = source->size();
+                unsigned long long bytesCopied      = 0;
+                QByteArray         buffer(
+                    static_cast<int>(qMin(fileSize, static_cast<unsigned long long>(compactionChunkSize))),
+                    '\0'
+                );
+
+                success = !source->setPosition(0);
+                while (success && bytesCopied < fileSize) {
+                    unsigned long long chunkSize = qMin(
+                        fileSize - bytesCopied,
+                        static_cast<unsigned long long>(buffer.size())
+                    );
+
+                    std::uint8_t*       data   = reinterpret_cast<std::uint8_t*>(buffer.data());
+                    ::Container::Status status = source->read(data, chunkSize);
+
+                    success = (status.success() && ::Container::ReadSuccessful(status).bytesRead() == chunkSize);
+                    if (success) {
+                        success = copy->write(data, chunkSize).success();
+                    }
+
+                    bytesCopied += chunkSize;
+                }
+
+                if (success) {
+                    success = !copy->flush();
+                }
+
+                source->setPosition(originalPosition);
+            }
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::duplicateVirtualFile(const QString& virtualFileName, const QString& newVirtualFileName) {
+    return copyVirtualFile(virtualFileName, this, newVirtualFileName);
+}
+
+
+QPointer<QVirtualFile> QContainer::newVirtualFile(const QString& newVirtualFileName) {
+    QMutexLocker           locker(&ioMutex);
+    QPointer<QVirtualFile> virtualFile;
+
+    std::shared_ptr<::Container::VirtualFile> vf;
+    if (ensureOpen() && (newVirtualFileName != compactionName || settleCompaction())) {
+        vf = ::Container::Container::newVirtualFile(newVirtualFileName.toStdString());
+    }
+
+    if (vf) {
+        DirectoryEntry& entry = directoryIndex[newVirtualFileName];
+        if (entry.virtualFile != vf) {
+            entry.virtualFile = vf;
+            entry.device      = QPointer<QVirtualFile>();
+        }
+
+        if (!isMetadata(newVirtualFileName)) {
+            handleMap.insert(newVirtualFileName, QVirtualFileHandle(this, newVirtualFileName));
+        }
+
+        virtualFile = materialize(newVirtualFileName);
+    }
+
+    return virtualFile;
+}
+
+
+QString QContainer::errorString() const {
+    return QString::fromStdString(lastStatus().description());
+}
+
+
+void QContainer::attachDevice(QIODevice* device) {
+    int errorCode = 0;
+    flushPendingWrite(errorCode);
+
+    releaseIoMode();
+    blockCache->clear();
+
+    currentDevice   = device;
+    trackedSize     = 0;
+    trackedPosition = 0;
+}
+
+
+long long QContainer::size() {
+    long long result;
+
+    if (currentDevice == Q_NULLPTR) {
+        result = -1;
+    } else {
+        result = static_cast<long long>(trackedSize);
+    }
+
+    return result;
+}
+
+
+::Container::Status QContainer::setPosition(unsigned long long newOffset) {
+    ::Container::Status status;
+
+    if (currentDevice == Q_NULLPTR) {
+        status = ::Container::FileContainerNotOpen();
+    } else if (newOffset <= trackedSize) {
+        trackedPosition = newOffset;
+    } else {
+        status = ::Container::SeekError(newOffset, trackedSize);
+    }
+
+    return status;
+}
+
+
+::Container::Status QContainer::setPositionLast() {
+    ::Container::Status status;
+
+    if (currentDevice == Q_NULLPTR) {
+        status = ::Container::FileContainerNotOpen();
+    } else {
+        trackedPosition = trackedSize;
+    }
+
+    return status;
+}
+
+
+unsigned long long QContainer::position() const {
+    unsigned long long currentPosition;
+
+    if (currentDevice == Q_NULLPTR) {
+        currentPosition = 0;
+    } else {
+        currentPosition = trackedPosition;
+    }
+
+    return currentPosition;
+}
+
+
+::Container::Status QContainer::read(std::uint8_t* buffer, unsigned desiredCount) {
+    ::Container::Status status;
+
+    if (currentDevice == Q_NULLPTR) {
+        status = ::Container::FileContainerNotOpen();
+    } else {
+        int       errorCode = 0;
+        long long bytesRead = cachedRead(trackedPosition, buffer, desiredCount, activeReadState, errorCode);
+
+        if (compactionTracing) {
+            compactionTraced      = true;
+            compactionTraceOffset = trackedPosition;
+        }
+
+        if (viewTracing) {
+            ++viewTraceReads;
+            viewTraceBuffer = buffer;
+            viewTraceOffset = trackedPosition;
+            viewTraceCount  = desiredCount;
+        }
+
+        if (bytesRead < 0) {
+            status = ::Container::FileReadError("", trackedPosition, errorCode);
+        } else {
+            trackedPosition += bytesRead;
+            status = ::Container::ReadSuccessful(bytesRead);
+        }
+    }
+
+    return status;
+}
+
+
+::Container::Status QContainer::write(const std::uint8_t* buffer, unsigned count) {
+    ::Container::Status status;
+
+    if (currentDevice == Q_NULLPTR) {
+        status = ::Container::FileContainerNotOpen();
+    } else {
+        int       errorCode    = 0;
+        long long bytesWritten = combinedWrite(trackedPosition, buffer, count, errorCode);
+
+        if (bytesWritten < 0) {
+            status = ::Container::FileWriteError("", trackedPosition, errorCode);
+        } else {
+            blockCache->update(trackedPosition, buffer, static_cast<unsigned long long>(bytesWritten));
+
+            trackedPosition += bytesWritten;
+            if (trackedPosition > trackedSize) {
+                trackedSize = trackedPosition;
+            }
+
+            directoryDirty = true;
+            status         = ::Container::WriteSuccessful(bytesWritten);
+        }
+    }
+
+    return status;
+}
+
+
+bool QContainer::supportsTruncation() const {
+    return (
+           qobject_cast<QFileDevice*>(currentDevice) != Q_NULLPTR
+        || qobject_cast<QBuffer*>(currentDevice) != Q_NULLPTR
+        || qobject_cast<QArenaDevice*>(currentDevice) != Q_NULLPTR
+        || (currentDevice != Q_NULLPTR && currentDevice->isSequential())
+    );
+}
+
+
+::Container::Status QContainer::truncate() {
+    ::Container::Status status;
+
+    if (currentDevice == Q_NULLPTR) {
+        status = ::Container::FileContainerNotOpen();
+    } else if (currentIoMode == IoMode::MAPPED) {
+        status = ::Container::FileWriteError("", trackedPosition, 0);
+    } else {
+        int errorCode = 0;
+        if (!flushPendingWrite(errorCode)) {
+            status = ::Container::FileWriteError("", pendingWriteOffset, errorCode);
+        } else {
+            bool success;
+            if (transactionActive) {
+                overlayTruncate(trackedPosition);
+                success = true;
+            } else {
+                success = beginUnjournaledWrite() && resizeStorage(trackedPosition, errorCode);
+            }
+
+            if (success) {
+                blockCache->truncate(trackedPosition);
+                trackedSize    = trackedPosition;
+                directoryDirty = true;
+            } else {
+                status = ::Container::FileWriteError("", trackedPosition, errorCode);
+            }
+        }
+    }
+
+    return status;
+}
+
+
+::Container::Status QContainer::flush() {
+    ::Container::Status status;
+
+    int errorCode = 0;
+    if (!flushPendingWrite(errorCode)) {
+        status = ::Container::FileWriteError("", pendingWriteOffset, errorCode);
+    } else if (!transactionActive && !syncStorage(currentFlushMode == FlushMode::DURABLE, errorCode)) {
+        // Flushes inside a transaction are deferred to the single durable flush performed on commit.
+        status = ::Container::FileWriteError("", trackedPosition, errorCode);
+    }
+
+    return status;
+}
+
+
+long long QContainer::overlayRead(
+        unsigned long long offset,
+        std::uint8_t*      buffer,
+        unsigned           count,
+        int&               errorCode
+    ) {
+    long long          bytesRead = 0;
+    unsigned long long endOffset = qMin(offset + count, trackedSize);
+    unsigned long long position  = offset;
+
+    while (bytesRead >= 0 && position < endOffset) {
+        unsigned long long pageIndex  = position / transactionPageSize;
+        unsigned long long segmentEnd = qMin((pageIndex + 1) * transactionPageSize, endOffset);
+        std::uint8_t*      target     = buffer + (position - offset);
+
+        PageMap::const_iterator page = transactionPages.constFind(pageIndex);
+        if (page != transactionPages.constEnd()) {
+            std::memcpy(
+                target,
+                page->constData() + (position - pageIndex * transactionPageSize),
+                static_cast<std::size_t>(segmentEnd - position)
+            );
+        } else {
+            // Extend the segment across pages that are not in the overlay so they are read from the device in a
+            // single operation.
+
+            while (segmentEnd < endOffset && !transactionPages.contains(segmentEnd / transactionPageSize)) {
+                segmentEnd = qMin(segmentEnd + transactionPageSize, endOffset);
+            }
+
+            unsigned long long storageEnd = qMin(segmentEnd, transactionStorageSize);
+            long long          fromStorage;
+            if (storageEnd > position) {
+                fromStorage = storageRead(position, target, static_cast<unsigned>(storageEnd - position), errorCode);
+            } else {
+                fromStorage = 0;
+            }
+
+            if (fromStorage < 0) {
+                bytesRead = -1;
+            } else {
+                std::memset(
+                    target + fromStorage,
+                    0,
+                    static_cast<std::size_t>(segmentEnd - position - static_cast<unsigned long long>(fromStorage))
+                );
+            }
+        }
+
+        if (bytesRead >= 0) {
+            bytesRead += segmentEnd - position;
+            position   = segmentEnd;
+        }
+    }
+
+    return bytesRead;
+}
+
+
+long long QContainer::overlayWrite(
+        unsigned long long  offset,
+        const std::uint8_t* buffer,
+        unsigned            count,
+        int&                errorCode
+    ) {
+    long long          bytesWritten = 0;
+    unsigned long long endOffset    = offset + count;
+    unsigned long long position     = offset;
+
+    while (bytesWritten >= 0 && position < endOffset) {
+        unsigned long long pageIndex  = position / transactionPageSize;
+        unsigned long long pageOffset = pageIndex * transactionPageSize;
+        unsigned long long segmentEnd = qMin(pageOffset + transactionPageSize, endOffset);
+
+        PageMap::iterator page = transactionPages.find(pageIndex);
+        if (page == transactionPages.end()) {
+            // Load the page so that bytes outside of the written range are preserved.
+
+            QByteArray data(static_cast<int>(transactionPageSize), '\0');
+            if (pageOffset < transactionStorageSize) {
+                unsigned storageBytes = static_cast<unsigned>(
+                    qMin(static_cast<unsigned long long>(transactionPageSize), transactionStorageSize - pageOffset)
+                );
+
+                std::uint8_t* pageData = reinterpret_cast<std::uint8_t*>(data.data());
+                if (storageRead(pageOffset, pageData, storageBytes, errorCode) < 0) {
+                    bytesWritten = -1;
+                }
+            }
+
+            page = transactionPages.insert(pageIndex, data);
+        }
+
+        if (bytesWritten >= 0) {
+            std::memcpy(
+                page->data() + (position - pageOffset),
+                buffer + (position - offset),
+                static_cast<std::size_t>(segmentEnd - position)
+            );
+
+            bytesWritten += segmentEnd - position;
+            position      = segmentEnd;
+        }
+    }
+
+    return bytesWritten;
+}
+
+
+void QContainer::overlayTruncate(unsigned long long newSize) {
+    if (newSize < transactionStorageSize) {
+        transactionStorageSize = newSize;
+    }
+
+    QList<unsigned long long> pageIndexes = transactionPages.keys();
+    for (QList<unsigned long long>::const_iterator it=pageIndexes.constBegin() ; it!=pageIndexes.constEnd() ; ++it) {
+        unsigned long long pageOffset = *it * transactionPageSize;
+        if (pageOffset >= newSize) {
+            transactionPages.remove(*it);
+        } else if (pageOffset + transactionPageSize > newSize) {
+            QByteArray& page = transactionPages[*it];
+            std::memset(
+                page.data() + (newSize - pageOffset),
+                0,
+                static_cast<std::size_t>(pageOffset + transactionPageSize - newSize)
+            );
+        }
+    }
+}
+
+
+bool QContainer::commitOverlay(int& errorCode) {
+    // Build the images of the pages to be written, trimmed to the container size, in device order.
+
+    PageImages pageImages;
+    for (PageMap::const_iterator it=transactionPages.constBegin() ; it!=transactionPages.constEnd() ; ++it) {
+        unsigned long long pageOffset = it.key() * transactionPageSize;
+        if (pageOffset < trackedSize) {
+            unsigned long long pageBytes = trackedSize - pageOffset;
+            if (pageBytes < transactionPageSize) {
+                pageImages.insert(pageOffset, it.value().left(static_cast<int>(pageBytes)));
+            } else {
+                pageImages.insert(pageOffset, it.value());
+            }
+        }
+    }
+
+    bool durable = false;
+    bool success = writeJournal(pageImages, transactionStorageSize, trackedSize, durable);
+
+    if (success && transactionStorageSize < transactionStartSize) {
+        success = resizeStorage(transactionStorageSize, errorCode);
+    }
+
+    PageImages::const_iterator it  = pageImages.constBegin();
+    PageImages::const_iterator end = pageImages.constEnd();
+    while (success && it != end) {
+        const QByteArray& page = it.value();
+        success = (
+               storageWrite(
+                   it.key(),
+                   reinterpret_cast<const std::uint8_t*>(page.constData()),
+                   static_cast<unsigned>(page.size()),
+                   errorCode
+               )
+            == static_cast<long long>(page.size())
+        );
+
+        ++it;
+    }
+
+    if (success && trackedSize < transactionStorageSize) {
+        success = resizeStorage(trackedSize, errorCode);
+    }
+
+    if (success) {
+        // A journaled transaction is already durable so the scattered page writes do not need to be flushed.
+        success = durable ? journalApplied() : syncStorage(true, errorCode);
+    }
+
+    if (success) {
+        // The overlay is only released once the device holds the transaction so a failed commit can be retried or
+        // rolled back.
+
+        transactionPages.clear();
+
+        transactionActive        = false;
+        transactionCommitOnClose = false;
+        directoryDirty           = false;
+    }
+
+    return success;
+}
+
+
+void QContainer::rollbackOverlay() {
+    pendingWrite.clear();
+    transactionPages.clear();
+    blockCache->clear();
+
+    transactionActive        = false;
+    transactionCommitOnClose = false;
+    trackedSize              = transactionStartSize;
+    trackedPosition          = 0;
+}
+
+
+bool QContainer::preserveSnapshotPages(
+        unsigned long long offset,
+        unsigned long long endOffset,
+        int&               errorCode
+    ) {
+    bool success = true;
+
+    // Drop snapshots that have been released, then find the extent of the data still visible to a snapshot.
+
+    unsigned long long snapshotEnd = 0;
+    QList<std::weak_ptr<QContainerSnapshotPages>>::iterator it = snapshotPages.begin();
+    while (it != snapshotPages.end()) {
+        std::shared_ptr<QContainerSnapshotPages> pages = it->lock();
+        if (pages) {
+            snapshotEnd = qMax(snapshotEnd, pages->size());
+            ++it;
+        } else {
+            it = snapshotPages.erase(it);
+        }
+    }
+
+    unsigned long long pageSize  = QContainerSnapshotPages::pageSize;
+    unsigned long long endPage   = (qMin(endOffset, snapshotEnd) + pageSize - 1) / pageSize;
+    unsigned long long pageIndex = offset / pageSize;
+
+    while (success && pageIndex < endPage) {
+        QByteArray page;
+        bool       pageRead = false;
+
+        for (it=snapshotPages.begin() ; success && it!=snapshotPages.end() ; ++it) {
+            std::shared_ptr<QContainerSnapshotPages> pages = it->lock();
+            if (pages && pageIndex * pageSize < pages->size() && !pages->contains(pageIndex)) {
+                if (!pageRead) {
+                    page.resize(static_cast<int>(pageSize));
+
+                    long long bytesRead = storageRead(
+                        pageIndex * pageSize,
+                        reinterpret_cast<std::uint8_t*>(page.data()),
+                        static_cast<unsigned>(pageSize),
+                        errorCode
+                    );
+
+                    if (bytesRead >= 0) {
+                        page.resize(static_cast<int>(bytesRead));
+                        pageRead = true;
+                    } else {
+                        success = false;
+                    }
+                }
+
+                if (success) {
+                    pages->preserve(pageIndex, page);
+                }
+            }
+        }
+
+        ++pageIndex;
+    }
+
+    return success;
+}
+
+
+bool QContainer::resizeStorage(unsigned long long newSize, int& errorCode) {
+    bool success;
+
+    QFileDevice* fileDevice = qobject_cast<QFileDevice*>(currentDevice);
+    if (!snapshotPages.isEmpty() && !preserveSnapshotPages(newSize, ~0ULL, errorCode)) {
+        success = false;
+    } else if (arenaDevice != Q_NULLPTR) {
+        success = arenaDevice->resize(static_cast<qint64>(newSize));
+    } else if (fileDevice != Q_NULLPTR) {
+        success = fileDevice->resize(static_cast<qint64>(newSize));
+        if (!success) {
+            errorCode = static_cast<int>(fileDevice->error());
+        }
+    } else {
+        QBuffer* buffer = qobject_cast<QBuffer*>(currentDevice);
+        if (buffer != Q_NULLPTR) {
+            if (newSize <= static_cast<unsigned long long>(buffer->buffer().size())) {
+                if (buffer->pos() > static_cast<qint64>(newSize)) {
+                    buffer->seek(static_cast<qint64>(newSize));
+                }
+
+                buffer->buffer().resize(static_cast<int>(newSize));
+                success = true;
+            } else {
+                success = false;
+            }
+        } else {
+            success = true;
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::syncStorage(bool durable, int& errorCode) {
+    bool success;
+
+    QFileDevice* fileDevice = qobject_cast<QFileDevice*>(currentDevice);
+    if (fileDevice != Q_NULLPTR && currentIoMode != IoMode::MAPPED) {
+        success = syncDevice(fileDevice, durable, errorCode);
+    } else {
+        success = true;
+    }
+
+    return success;
+}
+
+
+::Container::VirtualFile* QContainer::createFile(const std::string& virtualFileName) {
+    directoryDirty = true;
+    return ::Container::Container::createFile(virtualFileName);
+}
+
+
+void QContainer::configureIoMode() {
+    releaseIoMode();
+    blockCache->clear();
+
+    if (currentDevice != Q_NULLPTR && currentDevice->isSequential()) {
+        // Sequential devices are accessed through the staging arena prepared by QContainer::loadStream.
+
+        arenaDevice     = streamArena;
+        trackedSize     = static_cast<unsigned long long>(streamArena->size());
+        trackedPosition = 0;
+    } else if (currentDevice != Q_NULLPTR) {
+        QFileDevice* fileDevice = qobject_cast<QFileDevice*>(currentDevice);
+        if (fileDevice != Q_NULLPTR && fileDevice->isOpen()) {
+            if (currentRequestedIoMode == IoMode::MAPPED && !fileDevice->isWritable()) {
+                qint64 fileSize = fileDevice->size();
+                if (fileSize > 0) {
+                    uchar* mapping = fileDevice->map(0, fileSize);
+                    if (mapping != Q_NULLPTR) {
+                        mappedData    = reinterpret_cast<const std::uint8_t*>(mapping);
+                        currentIoMode = IoMode::MAPPED;
+                    }
+                }
+            }
+
+            #if (defined(Q_OS_UNIX))
+
+                if (currentIoMode == IoMode::DEVICE && currentRequestedIoMode != IoMode::DEVICE) {
+                    int handle = fileDevice->handle();
+                    if (handle >= 0 && fileDevice->flush()) {
+                        fileDescriptor = handle;
+                        currentIoMode  = IoMode::POSITIONAL;
+                    }
+                }
+
+            #endif
+        }
+
+        arenaDevice     = qobject_cast<QArenaDevice*>(currentDevice);
+        trackedSize     = static_cast<unsigned long long>(qMax(currentDevice->size(), Q_INT64_C(0)));
+        trackedPosition = static_cast<unsigned long long>(qMax(currentDevice->pos(), Q_INT64_C(0)));
+    }
+}
+
+
+bool QContainer::scanCompaction() {
+    bool                success = true;
+    HandleMap::iterator it;
+
+    if (compactionCursor.isNull()) {
+        // Hidden files are normally cleaned up when the container is opened.  Anything left by a failed clean up is
+        // dealt with before the pass starts.
+
+        success = recoverCompaction();
+        it      = handleMap.begin();
+    } else {
+        it = handleMap.upperBound(compactionCursor);
+    }
+
+    if (success && it == handleMap.end()) {
+        // Files are moved front to back.  A file is moved if it is fragmented or if free space precedes it.
+
+        unsigned long long previousEnd = 0;
+
+        QMultiMap<unsigned long long, CompactionExtent>::const_iterator extent = compactionLayout.constBegin();
+        QMultiMap<unsigned long long, CompactionExtent>::const_iterator end    = compactionLayout.constEnd();
+        while (extent != end) {
+            if (!extent->contiguous || extent.key() > previousEnd + compactionTolerance) {
+                compactionQueue.append(extent->name);
+            }
+
+            previousEnd = qMax(previousEnd, extent->end);
+            ++extent;
+        }
+
+        compactionLayout.clear();
+        compactionPhase = CompactionPhase::SELECT;
+    } else if (success) {
+        compactionCursor = it.key();
+
+        // The engine does not report where data is stored, so we read single bytes at chunk intervals and trace the
+        // device offsets the engine reads them from.
+
+        std::shared_ptr<::Container::VirtualFile> vf       = directoryIndex.value(compactionCursor).virtualFile;
+        unsigned long long                        fileSize = vf->size();
+
+        if (fileSize > 0) {
+            unsigned long long originalPosition = vf->position();
+            unsigned long long firstTrace       = 0;
+            unsigned long long firstSample      = 0;
+            unsigned long long lastTrace        = 0;
+            unsigned long long sample           = 0;
+            bool               located          = false;
+            bool               contiguous       = true;
+            bool               sampled          = false;
+
+            compactionTracing = true;
+
+            while (success && !sampled) {
+                std::uint8_t byte;
+
+                compactionTraced = false;
+                success          = !vf->setPosition(sample) && vf->read(&byte, 1).success();
+
+                if (success && compactionTraced) {
+                    if (!located) {
+                        firstTrace  = compactionTraceOffset;
+                        firstSample = sample;
+                        located     = true;
+                    } else {
+                        // Allow for engine block headers and reads that start at the beginning of a block.
+
+                        unsigned long long distance = sample - firstSample;
+                        unsigned long long expected = firstTrace + distance;
+
+                        contiguous = (
+                               contiguous
+                            && compactionTraceOffset + compactionTolerance >= expected
+                            && compactionTraceOffset <= expected + distance / 16 + compactionTolerance
+                        );
+                    }
+
+                    lastTrace = qMax(lastTrace, compactionTraceOffset);
+                }
+
+                if (sample == fileSize - 1) {
+                    sampled = true;
+                } else {
+                    sample = qMin(sample + compactionChunkSize, fileSize - 1);
+                }
+            }
+
+            compactionTracing = false;
+            vf->setPosition(originalPosition);
+
+            if (success && located) {
+                unsigned long long start = firstTrace > firstSample ? firstTrace - firstSample : 0;
+
+                CompactionExtent extent;
+                extent.name       = compactionCursor;
+                extent.end        = qMax(lastTrace + 1, start + fileSize);
+                extent.contiguous = contiguous;
+
+                compactionLayout.insert(start, extent);
+            }
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::selectCompaction() {
+    bool success = true;
+
+    if (compactionQueue.isEmpty()) {
+        compactionPassComplete = true;
+    } else {
+        QString                  name = compactionQueue.takeFirst();
+        DirectoryIndex::iterator it   = directoryIndex.find(name);
+
+        // Files erased since the scan are dropped and open files are left for a later pass.
+
+        if (it != directoryIndex.end() && (it->device.isNull() || !it->device->isOpen())) {
+            compactionTarget = ::Container::Container::newVirtualFile(
+                (QString(compactionFilePrefix) + name).toStdString()
+            );
+
+            success = static_cast<bool>(compactionTarget);
+
+            if (success) {
+                compactionName   = name;
+                compactionSource = it->virtualFile;
+                compactionOffset = 0;
+                compactionDirty  = false;
+                compactionPhase  = CompactionPhase::COPY;
+            }
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::copyCompactionChunk(unsigned long long& bytesCopied) {
+    bool success = true;
+
+    if (compactionDirty || !compactionTarget) {
+        // The file was written since the copy started, or the target could not be created, so the copy starts
+        // again.
+
+        if (compactionTarget) {
+            success = !compactionTarget->erase();
+        }
+
+        if (success) {
+            std::string targetName;
+            if (compactionPhase == CompactionPhase::COPY) {
+                targetName = (QString(compactionFilePrefix) + compactionName).toStdString();
+            } else {
+                targetName = compactionName.toStdString();
+            }
+
+            compactionTarget = ::Container::Container::newVirtualFile(targetName);
+            compactionOffset = 0;
+            compactionDirty  = false;
+            success          = static_cast<bool>(compactionTarget);
+        }
+    }
+
+    unsigned long long fileSize = compactionSource->size();
+    if (success && compactionOffset < fileSize) {
+        // Restore the source position afterwards since a device for the file may be tracking it.
+
+        unsigned long long chunkSize = qMin(
+            fileSize - compactionOffset,
+            static_cast<unsigned long long>(compactionChunkSize)
+        );
+
+        unsigned long long originalPosition = compactionSource->position();
+        QByteArray         buffer(static_cast<int>(chunkSize), Qt::Uninitialized);
+        std::uint8_t*      data             = reinterpret_cast<std::uint8_t*>(buffer.data());
+
+        success = !compactionSource->setPosition(compactionOffset);
+        if (success) {
+            ::Container::Status status = compactionSource->read(data, chunkSize);
+            success = (status.success() && ::Container::ReadSuccessful(status).bytesRead() == chunkSize);
+        }
+
+        compactionSource->setPosition(originalPosition);
+
+        if (success) {
+            success = (
+                   !compactionTarget->setPosition(compactionOffset)
+                && compactionTarget->write(data, chunkSize).success()
+            );
+        }
+
+        if (success) {
+            compactionOffset += chunkSize;
+            bytesCopied      += chunkSize;
+        }
+    }
+
+    if (success && compactionOffset >= fileSize) {
+        success = !compactionTarget->flush();
+    }
+
+    if (success && compactionOffset >= fileSize) {
+        // The directory entry, and any device, follow the data so the file remains readable and writable
+        // throughout the move.  The marker is created before the original file is erased and removed after the
+        // hidden copy is erased, so a directory written at any point identifies the complete version of the file.
+
+        DirectoryEntry&    entry    = directoryIndex[compactionName];
+        unsigned long long position = compactionSource->position();
+
+        if (compactionPhase == CompactionPhase::COPY) {
+            compactionMarker = ::Container::Container::newVirtualFile(
+                (QString(compactionRestorePrefix) + compactionName).toStdString()
+            );
+
+            success = static_cast<bool>(compactionMarker) && !compactionSource->erase();
+        } else {
+            success = !compactionSource->erase() && (!compactionMarker || !compactionMarker->erase());
+        }
+
+        if (success) {
+            compactionTarget->setPosition(position);
+
+            entry.virtualFile = compactionTarget;
+            if (!entry.device.isNull()) {
+                entry.device->currentVirtualFile = compactionTarget;
+            }
+
+            if (compactionPhase == CompactionPhase::COPY) {
+                compactionSource = compactionTarget;
+                compactionTarget.reset();
+                compactionPhase  = CompactionPhase::RESTORE;
+            } else {
+                compactionSource.reset();
+                compactionTarget.reset();
+                compactionMarker.reset();
+                compactionName.clear();
+                compactionPhase  = CompactionPhase::SELECT;
+            }
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::settleCompaction() {
+    bool success = true;
+
+    if (compactionPhase == CompactionPhase::COPY) {
+        // The original file is untouched until the copy completes, so the copy is discarded and retried later.
+
+        success = (
+               (!compactionTarget || !compactionTarget->erase())
+            && (!compactionMarker || !compactionMarker->erase())
+        );
+
+        compactionQueue.prepend(compactionName);
+        compactionSource.reset();
+        compactionTarget.reset();
+        compactionMarker.reset();
+        compactionName.clear();
+        compactionPhase = CompactionPhase::SELECT;
+    } else {
+        // The original file was already erased, so the copy back is completed.
+
+        unsigned long long bytesCopied = 0;
+        while (success && compactionPhase == CompactionPhase::RESTORE) {
+            success = copyCompactionChunk(bytesCopied);
+        }
+    }
+
+    return success;
+}
+
+
+void QContainer::resetCompaction() {
+    compactionPhase        = CompactionPhase::SCAN;
+    compactionPassComplete = false;
+
+    compactionCursor.clear();
+    compactionLayout.clear();
+    compactionQueue.clear();
+}
+
+
+bool QContainer::recoverCompaction() {
+    bool success = true;
+
+    QString copyPrefix(compactionFilePrefix);
+    QString restorePrefix(compactionRestorePrefix);
+
+    ::Container::Container::DirectoryMap directory = ::Container::Container::directory();
+
+    ::Container::Container::DirectoryMap::iterator pos = directory.begin();
+    ::Container::Container::DirectoryMap::iterator end = directory.end();
+    while (success && pos != end) {
+        QString filename = QString::fromStdString(pos->first);
+        if (filename.startsWith(copyPrefix)) {
+            QString                                        original = filename.mid(copyPrefix.length());
+            ::Container::Container::DirectoryMap::iterator marker   = directory.find(
+                (restorePrefix + original).toStdString()
+            );
+
+            if (marker == end) {
+                // The move had not reached the copy back so the original file is intact.
+
+                success = !pos->second->erase();
+            } else {
+                // The hidden copy already stands in for the file.  A partial copy back is discarded and the copy
+                // back is repeated from the start.
+
+                ::Container::Container::DirectoryMap::iterator partial = directory.find(original.toStdString());
+                if (partial != end) {
+                    success = !partial->second->erase();
+                }
+
+                if (success) {
+                    CompactionPhase phase = compactionPhase;
+
+                    compactionName   = original;
+                    compactionSource = pos->second;
+                    compactionMarker = marker->second;
+                    compactionOffset = 0;
+                    compactionDirty  = false;
+                    compactionPhase  = CompactionPhase::RESTORE;
+
+                    compactionTarget.reset();
+
+                    success = settleCompaction();
+                    if (!success) {
+                        compactionSource.reset();
+                        compactionTarget.reset();
+                        compactionMarker.reset();
+                        compactionName.clear();
+                    }
+
+                    compactionPhase = phase;
+                }
+            }
+
+            directoryDirty = true;
+        } else if (filename.startsWith(restorePrefix)) {
+            // A marker is only left without its hidden copy if the copy back completed.
+
+            if (directory.find((copyPrefix + filename.mid(restorePrefix.length())).toStdString()) == end) {
+                success        = !pos->second->erase();
+                directoryDirty = true;
+            }
+        }
+
+        ++pos;
+    }
+
+    return success;
+}
+
+
+void QContainer::virtualFileWritten(const QString& virtualFileName) {
+    bool moving = (compactionPhase == CompactionPhase::COPY || compactionPhase == CompactionPhase::RESTORE);
+    if (moving && virtualFileName == compactionName) {
+        compactionDirty = true;
+    }
+}
+
+
+std::shared_ptr<::Container::VirtualFile> QContainer::replaceVirtualFile(const QString& virtualFileName) {
+    std::shared_ptr<::Container::VirtualFile> vf;
+    bool                                      success;
+
+    DirectoryIndex::iterator existing = directoryIndex.find(virtualFileName);
+    if (virtualFileName == compactionName && !settleCompaction()) {
+        success = false;
+    } else if (existing == directoryIndex.end()) {
+        success = engineOpen;
+    } else if (!existing->device.isNull() && existing->device->isOpen()) {
+        success = false;
+    } else {
+        success = !existing->virtualFile->erase();
+        if (success) {
+            if (!existing->device.isNull()) {
+                existing->device->deleteLater();
+            }
+
+            removeFromDirectory(virtualFileName);
+        }
+    }
+
+    if (success) {
+        vf = ::Container::Container::newVirtualFile(virtualFileName.toStdString());
+        if (vf) {
+            DirectoryEntry entry;
+            entry.virtualFile = vf;
+
+            directoryIndex.insert(virtualFileName, entry);
+            if (!isMetadata(virtualFileName)) {
+                handleMap.insert(virtualFileName, QVirtualFileHandle(this, virtualFileName));
+            }
+        }
+    }
+
+    return vf;
+}
 
 
-void QContainer::setDevice(QIODevice* device) {
-    currentDevice = device;
-    setParent(currentDevice);
+bool QContainer::commitStagedWrites() {
+    // The devices are collected under the lock and committed without it since commits are performed on the I/O
+    // thread.
+
+    QList<QPointer<QVirtualFile>> devices;
+
+    {
+        QMutexLocker locker(&ioMutex);
+        devices = directoryMap.values();
+    }
+
+    bool success = true;
+    for (QList<QPointer<QVirtualFile>>::const_iterator it=devices.constBegin() ; it!=devices.constEnd() ; ++it) {
+        if (!it->isNull() && !(*it)->waitForCommit()) {
+            success = false;
+        }
+    }
+
+    return success;
 }
 
 
-QIODevice* QContainer::device() {
-    return currentDevice;
+bool QContainer::commitStagedWrites(const QString& virtualFileName) {
+    QPointer<QVirtualFile> device;
+
+    {
+        QMutexLocker locker(&ioMutex);
+        device = directoryMap.value(virtualFileName);
+    }
+
+    return device.isNull() || device->waitForCommit();
 }
 
 
-bool QContainer::open() {
+bool QContainer::persistDirectory(int& errorCode) {
     bool success;
 
-    ::Container::Status status = ::Container::Container::open();
+    bool skip = (
+           transactionActive
+        || currentIoMode == IoMode::MAPPED
+        || !currentDevice->isWritable()
+        || !directoryChanged()
+    );
+
+    if (skip) {
+        success = flushPendingWrite(errorCode);
+    } else if (journalActive()) {
+        success = writeJournaledDirectory(errorCode);
+    } else {
+        success = writeDirectory(errorCode);
+    }
 
-    if (status) {
+    return success;
+}
+
+
+bool QContainer::writeDirectory(int& errorCode) {
+    bool success;
+
+    // No virtual file may be held by the hidden compaction file when the directory is written.
+
+    bool compactionSettled = settleCompaction();
+
+    QHash<QString, unsigned long long> positions;
+    for (DirectoryIndex::const_iterator it=directoryIndex.constBegin() ; it!=directoryIndex.constEnd() ; ++it) {
+        positions.insert(it.key(), it->virtualFile->position());
+    }
+
+    // The engine is reopened even if the close fails so the container remains usable.
+
+    ::Container::Status closeStatus = ::Container::Container::close();
+    ::Container::Status openStatus  = ::Container::Container::open();
+
+    if (openStatus) {
+        engineOpen = false;
+        success    = false;
+    } else {
+        synchronizeDirectory();
+
+        for (DirectoryIndex::const_iterator it=directoryIndex.constBegin() ; it!=directoryIndex.constEnd() ; ++it) {
+            it->virtualFile->setPosition(positions.value(it.key(), 0));
+        }
+
+        success = compactionSettled && !closeStatus && flushPendingWrite(errorCode);
+        if (success && !transactionActive) {
+            directoryDirty = false;
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::writeJournaledDirectory(int& errorCode) {
+    bool success;
+
+    // Data already combined outside of the transaction is written in place before the transaction starts.
+
+    if (!flushPendingWrite(errorCode)) {
         success = false;
     } else {
-        success = true;
+        transactionActive        = true;
+        transactionCommitOnClose = false;
+        transactionStartSize     = trackedSize;
+        transactionStorageSize   = trackedSize;
+
+        if (writeDirectory(errorCode) && commitOverlay(errorCode)) {
+            success = true;
+        } else {
+            // The device still holds the directory last written, so we discard the update and reload it.
+
+            ::Container::Container::close();
+            rollbackOverlay();
+
+            ::Container::Status status = ::Container::Container::open();
+            if (status) {
+                engineOpen = false;
+            } else {
+                synchronizeDirectory();
+                directoryDirty = false;
+            }
+
+            success = false;
+        }
     }
 
     return success;
 }
 
 
-bool QContainer::close() {
+bool QContainer::directoryChanged() const {
+    bool changed = directoryDirty;
+
+    DirectoryIndex::const_iterator it  = directoryIndex.constBegin();
+    DirectoryIndex::const_iterator end = directoryIndex.constEnd();
+    while (!changed && it != end) {
+        changed = (it->virtualFile->bytesInWriteCache() > 0);
+        ++it;
+    }
+
+    return changed;
+}
+
+
+bool QContainer::openEngine() {
     bool success;
 
-    ::Container::Status status = ::Container::Container::close();
+    openPending = false;
+    ::Container::Status status = ::Container::Container::open();
 
     if (status) {
+        releaseIoMode();
         success = false;
     } else {
+        synchronizeDirectory();
+
+        engineOpen     = true;
+        directoryDirty = false;
+        success        = true;
+
+        // A failed clean up leaves the container usable and is retried by the next compaction pass.
+
+        if (currentIoMode != IoMode::MAPPED && currentDevice->isWritable()) {
+            recoverCompaction();
+        }
+    }
+
+    return success;
+}
+
+
+bool QContainer::ensureOpen() {
+    return openPending ? openEngine() : engineOpen;
+}
+
+
+bool QContainer::checkFileIdentifier() {
+    bool success;
+
+    if (currentFileIdentifier.isEmpty()) {
         success = true;
+    } else {
+        // The engine does not expose its header layout so we locate the identifier field in the header of an empty
+        // container, created in memory with the same identifier, and compare the device contents at that offset.
+
+        QArenaDevice referenceDevice;
+        referenceDevice.open(QIODevice::ReadWrite);
+
+        QContainer referenceContainer(currentFileIdentifier);
+        referenceContainer.attachDevice(&referenceDevice);
+
+        QByteArray identifier = currentFileIdentifier.toUtf8();
+        int        offset     = -1;
+
+        if (referenceContainer.open() && referenceContainer.close()) {
+            offset = referenceDevice.toByteArray().indexOf(identifier);
+        }
+
+        unsigned long long fieldEnd = static_cast<unsigned long long>(offset) + identifier.size();
+        if (offset < 0 || fieldEnd > trackedSize) {
+            success = false;
+        } else {
+            QByteArray field(identifier.size(), Qt::Uninitialized);
+
+            int       errorCode = 0;
+            long long bytesRead = deviceRead(
+                static_cast<unsigned long long>(offset),
+                reinterpret_cast<std::uint8_t*>(field.data()),
+                static_cast<unsigned>(field.size()),
+                errorCode
+            );
+
+            success = (bytesRead == field.size() && field == identifier);
+        }
     }
 
     return success;
 }
 
 
-QContainer::DirectoryMap QContainer::directory() {
+void QContainer::synchronizeDirectory() {
     ::Container::Container::DirectoryMap directory = ::Container::Container::directory();
 
+    QString copyPrefix(compactionFilePrefix);
+    QString restorePrefix(compactionRestorePrefix);
+
+    // Hidden compaction files are never exposed.  If a move was interrupted while a file was being copied back,
+    // the hidden copy is the only complete version of the file and stands in for it until the move is completed.
+
+    QMap<QString, std::shared_ptr<::Container::VirtualFile>> visible;
+    QMap<QString, std::shared_ptr<::Container::VirtualFile>> recovered;
+
     ::Container::Container::DirectoryMap::iterator pos = directory.begin();
     ::Container::Container::DirectoryMap::iterator end = directory.end();
     while (pos != end) {
         QString filename = QString::fromStdString(pos->first);
-        if (!directoryMap.contains(filename)) {
-            QVirtualFile* virtualFile = new QVirtualFile(pos->second, this);
-            directoryMap.insert(filename, QPointer<QVirtualFile>(virtualFile));
+        if (filename.startsWith(copyPrefix)) {
+            QString original = filename.mid(copyPrefix.length());
+            if (directory.find((restorePrefix + original).toStdString()) != end) {
+                recovered.insert(original, pos->second);
+            }
+        } else if (!filename.startsWith(restorePrefix)) {
+            visible.insert(filename, pos->second);
         }
 
         ++pos;
     }
 
-    QList<QString> keys = directoryMap.keys();
+    QMap<QString, std::shared_ptr<::Container::VirtualFile>>::const_iterator copy = recovered.constBegin();
+    while (copy != recovered.constEnd()) {
+        visible.insert(copy.key(), copy.value());
+        ++copy;
+    }
+
+    QMap<QString, std::shared_ptr<::Container::VirtualFile>>::const_iterator file = visible.constBegin();
+    while (file != visible.constEnd()) {
+        const QString&           filename = file.key();
+        DirectoryIndex::iterator it       = directoryIndex.find(filename);
+        if (it == directoryIndex.end()) {
+            DirectoryEntry entry;
+            entry.virtualFile = file.value();
+
+            directoryIndex.insert(filename, entry);
+            if (!isMetadata(filename)) {
+                handleMap.insert(filename, QVirtualFileHandle(this, filename));
+            }
+        } else if (it->virtualFile != file.value()) {
+            // The container was reopened.  Rebind any existing device to the newly loaded virtual file.
+
+            it->virtualFile = file.value();
+            if (!it->device.isNull()) {
+                it->device->currentVirtualFile = file.value();
+            }
+        }
+
+        ++file;
+    }
+
+    QList<QString> keys = directoryIndex.keys();
     for (QList<QString>::const_iterator it=keys.begin() ; it!=keys.end() ; ++it) {
-        if (directory.find(it->toStdString()) == directory.end()) {
-            QVirtualFile* qvf = directoryMap.value(*it).data();
-            directoryMap.remove(*it);
+        if (!visible.contains(*it)) {
+            QVirtualFile* qvf = directoryIndex.value(*it).device.data();
+            removeFromDirectory(*it);
             delete qvf;
         }
     }
+}
 
-    return directoryMap;
+
+bool QContainer::isMetadata(const QString& virtualFileName) {
+    return virtualFileName.startsWith(QString(metadataPrefix));
 }
 
 
-QPointer<QVirtualFile> QContainer::newVirtualFile(const QString& newVirtualFileName) {
-    QPointer<QVirtualFile> virtualFile;
+void QContainer::removeFromDirectory(const QString& virtualFileName) {
+    directoryDirty = true;
 
-    std::shared_ptr<::Container::VirtualFile> vf;
-    vf = ::Container::Container::newVirtualFile(newVirtualFileName.toStdString());
+    directoryMap.remove(virtualFileName);
+    directoryIndex.remove(virtualFileName);
+    handleMap.remove(virtualFileName);
+}
 
-    if (vf) {
-        virtualFile = QPointer<QVirtualFile>(new QVirtualFile(vf, this));
-        directoryMap.insert(newVirtualFileName, virtualFile);
+
+QContainer::HandleMap QContainer::handlesWithPrefix(const QString& prefix) const {
+    HandleMap result;
+
+    HandleMap::const_iterator it  = handleMap.lowerBound(prefix);
+    HandleMap::const_iterator end = handleMap.constEnd();
+    while (it != end && it.key().startsWith(prefix)) {
+        result.insert(it.key(), it.value());
+        ++it;
     }
 
-    return virtualFile;
+    return result;
 }
 
 
-QString QContainer::errorString() const {
-    return QString::fromStdString(lastStatus().description());
+QPointer<QVirtualFile> QContainer::materialize(const QString& virtualFileName) {
+    QPointer<QVirtualFile> result;
+
+    DirectoryIndex::iterator it = directoryIndex.find(virtualFileName);
+    if (it != directoryIndex.end()) {
+        if (it->device.isNull()) {
+            it->device = QPointer<QVirtualFile>(new QVirtualFile(it->virtualFile, virtualFileName, this));
+            directoryMap.insert(virtualFileName, it->device);
+        }
+
+        result = it->device;
+    }
+
+    return result;
 }
 
 
-long long QContainer::size() {
-    long long result;
+QContainer::StreamMode QContainer::activeStreamMode() const {
+    StreamMode result;
 
-    if (currentDevice == Q_NULLPTR) {
-        result = -1;
+    if (currentStreamMode == StreamMode::AUTOMATIC) {
+        result = currentDevice->isReadable() ? StreamMode::READ : StreamMode::WRITE;
     } else {
-        result = currentDevice->size();
+        result = currentStreamMode;
     }
 
     return result;
 }
 
 
-::Container::Status QContainer::setPosition(unsigned long long newOffset) {
-    ::Container::Status status;
+bool QContainer::loadStream() {
+    bool success;
 
-    if (currentDevice == Q_NULLPTR) {
-        status = ::Container::FileContainerNotOpen();
+    if (streamArena == Q_NULLPTR) {
+        streamArena = new QArenaDevice(this);
+        streamArena->open(QIODevice::ReadWrite);
     } else {
-        unsigned long long currentSize = currentDevice->size();
-        if (newOffset <= currentSize) {
-            bool result = currentDevice->seek(newOffset);
+        streamArena->clear();
+    }
 
-            if (!result) {
-                status = ::Container::SeekError(newOffset, currentSize);
+    if (activeStreamMode() == StreamMode::READ) {
+        success = currentDevice->isReadable();
+
+        QByteArray buffer(static_cast<int>(streamReadSize), Qt::Uninitialized);
+        bool       endOfStream = !success;
+        while (!endOfStream) {
+            qint64 bytesRead = currentDevice->read(buffer.data(), buffer.size());
+            if (bytesRead > 0) {
+                streamArena->writeAt(streamArena->size(), buffer.constData(), bytesRead);
+            } else if (bytesRead < 0 || !currentDevice->waitForReadyRead(-1)) {
+                // The device was closed or no more data will arrive.
+                endOfStream = true;
             }
-        } else {
-            status = ::Container::SeekError(newOffset, currentSize);
         }
+    } else {
+        success = currentDevice->isWritable();
     }
 
-    return status;
+    return success;
 }
 
 
-::Container::Status QContainer::setPositionLast() {
-    ::Container::Status status;
+bool QContainer::storeStream() {
+    bool success;
 
-    if (currentDevice == Q_NULLPTR) {
-        status = ::Container::FileContainerNotOpen();
+    if (currentDevice != Q_NULLPTR && currentDevice->isSequential() && activeStreamMode() == StreamMode::WRITE) {
+        success = (streamArena->writeTo(currentDevice) == streamArena->size());
     } else {
-        unsigned long long currentSize = currentDevice->size();
-        bool result = currentDevice->seek(currentSize);
+        success = true;
+    }
+
+    return success;
+}
 
-        if (!result) {
-            status = ::Container::SeekError(currentSize, currentSize);
+
+void QContainer::releaseIoMode() {
+    if (currentIoMode == IoMode::MAPPED) {
+        QFileDevice* fileDevice = qobject_cast<QFileDevice*>(currentDevice);
+        if (fileDevice != Q_NULLPTR) {
+            fileDevice->unmap(const_cast<uchar*>(reinterpret_cast<const uchar*>(mappedData)));
         }
+
+        mappedData = Q_NULLPTR;
+        mappedExtents.clear();
+    } else if (currentIoMode == IoMode::POSITIONAL) {
+        // Re-synchronize the device with the tracked position.  The seek also discards any stale data held in the
+        // QIODevice read buffer.
+
+        currentDevice->seek(static_cast<qint64>(trackedPosition));
+        fileDescriptor = -1;
+    } else if (arenaDevice != Q_NULLPTR) {
+        arenaDevice->seek(static_cast<qint64>(trackedPosition));
     }
 
-    return status;
+    currentIoMode = IoMode::DEVICE;
+    arenaDevice   = Q_NULLPTR;
 }
 
 
-unsigned long long QContainer::position() const {
-    unsigned long long currentPosition;
+long long QContainer::deviceRead(
+        unsigned long long offset,
+        std::uint8_t*      buffer,
+        unsigned           count,
+        int&               errorCode
+    ) {
+    long long bytesRead;
+
+    bool overlapsPendingWrite = (
+           !pendingWrite.isEmpty()
+        && offset < pendingWriteOffset + static_cast<unsigned long long>(pendingWrite.size())
+        && offset + count > pendingWriteOffset
+    );
+
+    if (overlapsPendingWrite && !flushPendingWrite(errorCode)) {
+        // The read overlaps data held in the write combining buffer and that data could not be pushed to the
+        // device.
+        bytesRead = -1;
+    } else if (transactionActive) {
+        bytesRead = overlayRead(offset, buffer, count, errorCode);
+    } else {
+        bytesRead = storageRead(offset, buffer, count, errorCode);
+    }
 
-    if (currentDevice == Q_NULLPTR) {
-        currentPosition = 0;
+    return bytesRead;
+}
+
+
+long long QContainer::storageRead(
+        unsigned long long offset,
+        std::uint8_t*      buffer,
+        unsigned           count,
+        int&               errorCode
+    ) {
+    long long bytesRead;
+
+    if (currentIoMode == IoMode::MAPPED) {
+        unsigned long long bytesRemaining = offset < trackedSize ? trackedSize - offset : 0;
+        bytesRead = static_cast<long long>(count <= bytesRemaining ? count : bytesRemaining);
+
+        std::memcpy(buffer, mappedData + offset, static_cast<std::size_t>(bytesRead));
+    } else if (currentIoMode == IoMode::POSITIONAL) {
+        #if (defined(Q_OS_UNIX))
+
+            bytesRead = 0;
+            while (bytesRead >= 0 && static_cast<unsigned long long>(bytesRead) < count) {
+                ssize_t result = ::pread(
+                    fileDescriptor,
+                    buffer + bytesRead,
+                    count - static_cast<std::size_t>(bytesRead),
+                    static_cast<off_t>(offset + bytesRead)
+                );
+
+                if (result > 0) {
+                    bytesRead += result;
+                } else if (result == 0) {
+                    break;
+                } else if (errno != EINTR) {
+                    errorCode = errno;
+                    bytesRead = -1;
+                }
+            }
+
+        #else
+
+            bytesRead = -1;
+
+        #endif
+    } else if (arenaDevice != Q_NULLPTR) {
+        bytesRead = arenaDevice->readAt(
+            static_cast<qint64>(offset),
+            reinterpret_cast<char*>(buffer),
+            static_cast<qint64>(count)
+        );
     } else {
-        currentPosition = currentDevice->pos();
+        if (currentDevice->pos() == static_cast<qint64>(offset) || currentDevice->seek(offset)) {
+            bytesRead = currentDevice->read(reinterpret_cast<char*>(buffer), count);
+        } else {
+            bytesRead = -1;
+        }
     }
 
-    return currentPosition;
+    return bytesRead;
 }
 
 
-::Container::Status QContainer::read(std::uint8_t* buffer, unsigned desiredCount) {
-    ::Container::Status status;
+long long QContainer::deviceWrite(
+        unsigned long long  offset,
+        const std::uint8_t* buffer,
+        unsigned            count,
+        int&                errorCode
+    ) {
+    long long bytesWritten;
 
-    if (currentDevice == Q_NULLPTR) {
-        status = ::Container::FileContainerNotOpen();
+    if (transactionActive) {
+        bytesWritten = overlayWrite(offset, buffer, count, errorCode);
+    } else if (!beginUnjournaledWrite()) {
+        errorCode    = EIO;
+        bytesWritten = -1;
     } else {
-        unsigned long long currentPosition = currentDevice->pos();
-        long long bytesRead = currentDevice->read(reinterpret_cast<char*>(buffer), desiredCount);
+        bytesWritten = storageWrite(offset, buffer, count, errorCode);
+    }
 
-        if (bytesRead < 0) {
-            status = ::Container::FileReadError("", currentPosition, 0);
+    return bytesWritten;
+}
+
+
+long long QContainer::storageWrite(
+        unsigned long long  offset,
+        const std::uint8_t* buffer,
+        unsigned            count,
+        int&                errorCode
+    ) {
+    long long bytesWritten;
+
+    if (currentIoMode == IoMode::MAPPED) {
+        bytesWritten = -1;
+    } else if (!snapshotPages.isEmpty() && !preserveSnapshotPages(offset, offset + count, errorCode)) {
+        bytesWritten = -1;
+    } else if (currentIoMode == IoMode::POSITIONAL) {
+        #if (defined(Q_OS_UNIX))
+
+            bytesWritten = 0;
+            while (bytesWritten >= 0 && static_cast<unsigned long long>(bytesWritten) < count) {
+                ssize_t result = ::pwrite(
+                    fileDescriptor,
+                    buffer + bytesWritten,
+                    count - static_cast<std::size_t>(bytesWritten),
+                    static_cast<off_t>(offset + bytesWritten)
+                );
+
+                if (result > 0) {
+                    bytesWritten += result;
+                } else if (result == 0) {
+                    // No progress was made.  Report the write as failed rather than retrying indefinitely.
+
+                    errorCode    = EIO;
+                    bytesWritten = -1;
+                } else if (errno != EINTR) {
+                    errorCode    = errno;
+                    bytesWritten = -1;
+                }
+            }
+
+        #else
+
+            bytesWritten = -1;
+
+        #endif
+    } else if (arenaDevice != Q_NULLPTR) {
+        bytesWritten = arenaDevice->writeAt(
+            static_cast<qint64>(offset),
+            reinterpret_cast<const char*>(buffer),
+            static_cast<qint64>(count)
+        );
+    } else {
+        if (currentDevice->pos() == static_cast<qint64>(offset) || currentDevice->seek(offset)) {
+            bytesWritten = currentDevice->write(reinterpret_cast<const char*>(buffer), count);
         } else {
-            status = ::Container::ReadSuccessful(bytesRead);
+            bytesWritten = -1;
         }
     }
 
-    return status;
+    return bytesWritten;
 }
 
 
-::Container::Status QContainer::write(const std::uint8_t* buffer, unsigned count) {
-    ::Container::Status status;
+long long QContainer::cachedRead(
+        unsigned long long       offset,
+        std::uint8_t*            buffer,
+        unsigned                 count,
+        QVirtualFile::ReadState* readState,
+        int&                     errorCode
+    ) {
+    long long bytesRead;
 
-    if (currentDevice == Q_NULLPTR) {
-        status = ::Container::FileContainerNotOpen();
+    if (readState != Q_NULLPTR && readState->accessHint == QVirtualFile::AccessHint::SEQUENTIAL) {
+        // Ask the operating system to fetch the data ahead of a sequential reader.  The advised range is tracked so
+        // the advice is only issued once for each stretch of the device.  A read outside the advised range starts a
+        // new stretch.
+
+        unsigned long long adviseEnd = qMin(offset + count + currentMaximumReadAhead, trackedSize);
+        if (readState->advisedEnd < offset || readState->advisedEnd > adviseEnd) {
+            readState->advisedEnd = offset;
+        }
+
+        unsigned long long adviseStart = readState->advisedEnd;
+        bool               behind      = adviseStart < offset + count + currentMaximumReadAhead / 2;
+
+        if (adviseEnd > adviseStart && behind) {
+            adviseDevice(QVirtualFile::AccessHint::WILL_NEED, adviseStart, adviseEnd - adviseStart);
+            readState->advisedEnd = adviseEnd;
+        }
+    }
+
+    bool bypassCache = (
+           currentIoMode == IoMode::MAPPED
+        || arenaDevice != Q_NULLPTR
+        || !blockCache->isEnabled()
+        || count > blockCache->maximumSize() / 4
+    );
+
+    if (bypassCache) {
+        // Mapped and arena data is already memory resident and large reads would only thrash the cache so we
+        // bypass the cache in these cases.  Writes update the cache so the device and the cache remain coherent.
+
+        bytesRead = deviceRead(offset, buffer, count, errorCode);
     } else {
-        unsigned long long currentPosition = currentDevice->pos();
-        long long bytesWritten = currentDevice->write(reinterpret_cast<const char*>(buffer), count);
+        unsigned           blockSize    = blockCache->blockSize();
+        unsigned long long endOffset    = qMin(offset + count, trackedSize);
+        unsigned long long readAheadEnd = qMin(
+            endOffset + (readState != Q_NULLPTR ? updateReadAhead(offset, count, *readState) : 0),
+            trackedSize
+        );
+        unsigned long long position     = offset;
+
+        bytesRead = 0;
+        while (bytesRead >= 0 && position < endOffset) {
+            unsigned long long blockIndex = position / blockSize;
+            unsigned long long blockStart = blockIndex * blockSize;
+            const QByteArray*  blockData  = blockCache->block(blockIndex);
+
+            if (blockData != Q_NULLPTR && position - blockStart < static_cast<unsigned long long>(blockData->size())) {
+                unsigned long long blockEnd  = blockStart + static_cast<unsigned long long>(blockData->size());
+                unsigned long long available = qMin(endOffset, blockEnd) - position;
+
+                std::memcpy(
+                    buffer + (position - offset),
+                    blockData->constData() + (position - blockStart),
+                    static_cast<std::size_t>(available)
+                );
+
+                position += available;
+            } else {
+                // Read this block along with any following uncached blocks, including any read-ahead, in a single
+                // device access.
+
+                unsigned long long runEnd = blockStart + blockSize;
+                while (runEnd < readAheadEnd && !blockCache->contains(runEnd / blockSize)) {
+                    runEnd += blockSize;
+                }
+
+                runEnd = qMin(runEnd, trackedSize);
+
+                QByteArray runData(static_cast<int>(runEnd - blockStart), Qt::Uninitialized);
+                long long  runBytes = deviceRead(
+                    blockStart,
+                    reinterpret_cast<std::uint8_t*>(runData.data()),
+                    static_cast<unsigned>(runEnd - blockStart),
+                    errorCode
+                );
+
+                if (runBytes < 0) {
+                    bytesRead = -1;
+                } else if (static_cast<unsigned long long>(runBytes) <= position - blockStart) {
+                    endOffset = position;
+                } else {
+                    unsigned long long runBytesRead = static_cast<unsigned long long>(runBytes);
+                    unsigned long long available    = qMin(endOffset, blockStart + runBytesRead) - position;
+
+                    std::memcpy(
+                        buffer + (position - offset),
+                        runData.constData() + (position - blockStart),
+                        static_cast<std::size_t>(available)
+                    );
+
+                    position += available;
+
+                    for (unsigned long long start=0 ; start<runBytesRead ; start+=blockSize) {
+                        blockCache->insert(
+                            (blockStart + start) / blockSize,
+                            runData.mid(static_cast<int>(start), static_cast<int>(blockSize))
+                        );
+                    }
+                }
+            }
+        }
 
-        if (bytesWritten < 0) {
-            status = ::Container::FileWriteError("", currentPosition, 0);
+        if (bytesRead >= 0) {
+            bytesRead = static_cast<long long>(position - offset);
+        }
+    }
+
+    return bytesRead;
+}
+
+
+unsigned long long QContainer::updateReadAhead(
+        unsigned long long       offset,
+        unsigned                 count,
+        QVirtualFile::ReadState& readState
+    ) {
+    unsigned long long result;
+
+    if (readState.accessHint == QVirtualFile::AccessHint::SEQUENTIAL && currentMaximumReadAhead > 0) {
+        if (offset == readState.lastReadEnd && readState.readAheadWindow > 0) {
+            readState.readAheadWindow = qMin(2 * readState.readAheadWindow, currentMaximumReadAhead);
         } else {
-            status = ::Container::WriteSuccessful(bytesWritten);
+            readState.readAheadWindow = qMin(
+                static_cast<unsigned long long>(minimumReadAheadBlocks * blockCache->blockSize()),
+                currentMaximumReadAhead
+            );
         }
+
+        result = qMin(readState.readAheadWindow, blockCache->maximumSize() / 4);
+    } else {
+        readState.readAheadWindow = 0;
+        result                    = 0;
     }
 
-    return status;
+    readState.lastReadEnd = offset + count;
+    return result;
 }
 
 
-bool QContainer::supportsTruncation() const {
-    return false;
+::Container::Status QContainer::readWithState(
+        ::Container::VirtualFile& virtualFile,
+        std::uint8_t*             buffer,
+        unsigned long long        count,
+        QVirtualFile::ReadState&  readState
+    ) {
+    activeReadState = &readState;
+    ::Container::Status status = virtualFile.read(buffer, count);
+    activeReadState = Q_NULLPTR;
+
+    return status;
 }
 
 
-::Container::Status QContainer::truncate() {
-    return ::Container::NoStatus();
+void QContainer::adviseDevice(QVirtualFile::AccessHint hint, unsigned long long offset, unsigned long long length) {
+    #if (defined(Q_OS_UNIX))
+
+        if (currentIoMode == IoMode::MAPPED) {
+            int advice;
+            switch (hint) {
+                case QVirtualFile::AccessHint::NORMAL:     { advice = MADV_NORMAL;     break; }
+                case QVirtualFile::AccessHint::SEQUENTIAL: { advice = MADV_SEQUENTIAL; break; }
+                case QVirtualFile::AccessHint::RANDOM:     { advice = MADV_RANDOM;     break; }
+                case QVirtualFile::AccessHint::WILL_NEED:  { advice = MADV_WILLNEED;   break; }
+                case QVirtualFile::AccessHint::DONT_NEED:  { advice = MADV_DONTNEED;   break; }
+                default:                                   { advice = MADV_NORMAL;     break; }
+            }
+
+            // The range passed to madvise must start on a page boundary.
+
+            unsigned long long pageSize = static_cast<unsigned long long>(::sysconf(_SC_PAGESIZE));
+            unsigned long long start    = offset - offset % pageSize;
+            unsigned long long end      = qMin(offset + length, trackedSize);
+
+            if (end > start) {
+                ::madvise(
+                    const_cast<void*>(reinterpret_cast<const void*>(mappedData + start)),
+                    static_cast<std::size_t>(end - start),
+                    advice
+                );
+            }
+        } else {
+            #if (defined(Q_OS_LINUX))
+
+                int          handle     = fileDescriptor;
+                QFileDevice* fileDevice = qobject_cast<QFileDevice*>(currentDevice);
+                if (handle < 0 && fileDevice != Q_NULLPTR) {
+                    handle = fileDevice->handle();
+                }
+
+                if (handle >= 0) {
+                    int advice;
+                    switch (hint) {
+                        case QVirtualFile::AccessHint::NORMAL:     { advice = POSIX_FADV_NORMAL;     break; }
+                        case QVirtualFile::AccessHint::SEQUENTIAL: { advice = POSIX_FADV_SEQUENTIAL; break; }
+                        case QVirtualFile::AccessHint::RANDOM:     { advice = POSIX_FADV_RANDOM;     break; }
+                        case QVirtualFile::AccessHint::WILL_NEED:  { advice = POSIX_FADV_WILLNEED;   break; }
+                        case QVirtualFile::AccessHint::DONT_NEED:  { advice = POSIX_FADV_DONTNEED;   break; }
+                        default:                                   { advice = POSIX_FADV_NORMAL;     break; }
+                    }
+
+                    ::posix_fadvise(handle, static_cast<off_t>(offset), static_cast<off_t>(length), advice);
+                }
+
+            #else
+
+                (void) hint;
+                (void) offset;
+                (void) length;
+
+            #endif
+        }
+
+    #else
+
+        (void) hint;
+        (void) offset;
+        (void) length;
+
+    #endif
 }
 
 
-::Container::Status QContainer::flush() {
-    return ::Container::NoStatus();
+long long QContainer::combinedWrite(
+        unsigned long long  offset,
+        const std::uint8_t* buffer,
+        unsigned            count,
+        int&                errorCode
+    ) {
+    long long bytesWritten;
+
+    if (currentWriteCombiningSize == 0 || currentIoMode == IoMode::MAPPED || arenaDevice != Q_NULLPTR) {
+        bytesWritten = deviceWrite(offset, buffer, count, errorCode);
+    } else {
+        unsigned long long pendingEnd = pendingWriteOffset + static_cast<unsigned long long>(pendingWrite.size());
+        bool               combine    = (
+               !pendingWrite.isEmpty()
+            && offset >= pendingWriteOffset
+            && offset <= pendingEnd
+            && offset + count - pendingWriteOffset <= currentWriteCombiningSize
+        );
+
+        if (combine) {
+            // The write overlaps or directly follows the pending data so we can merge it into the buffer.
+
+            unsigned long long bufferOffset = offset - pendingWriteOffset;
+            unsigned long long newLength    = qMax(
+                bufferOffset + count,
+                static_cast<unsigned long long>(pendingWrite.size())
+            );
+
+            pendingWrite.resize(static_cast<int>(newLength));
+            std::memcpy(pendingWrite.data() + bufferOffset, buffer, count);
+
+            bytesWritten = count;
+        } else if (!flushPendingWrite(errorCode)) {
+            bytesWritten = -1;
+        } else if (count >= currentWriteCombiningSize) {
+            bytesWritten = deviceWrite(offset, buffer, count, errorCode);
+        } else {
+            pendingWriteOffset = offset;
+            pendingWrite.reserve(static_cast<int>(currentWriteCombiningSize));
+            pendingWrite.append(reinterpret_cast<const char*>(buffer), static_cast<int>(count));
+
+            bytesWritten = count;
+        }
+    }
+
+    return bytesWritten;
 }
 
 
-::Container::VirtualFile* QContainer::createFile(const std::string& virtualFileName) {
-    return ::Container::Container::createFile(virtualFileName);
+bool QContainer::flushPendingWrite(int& errorCode) {
+    bool success;
+
+    if (pendingWrite.isEmpty()) {
+        success = true;
+    } else {
+        long long bytesWritten = deviceWrite(
+            pendingWriteOffset,
+            reinterpret_cast<const std::uint8_t*>(pendingWrite.constData()),
+            static_cast<unsigned>(pendingWrite.size()),
+            errorCode
+        );
+
+        if (bytesWritten == pendingWrite.size()) {
+            pendingWrite.resize(0);
+            success = true;
+        } else {
+            success = false;
+        }
+    }
+
+    return success;
 }
@@ -0,0 +1,209 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref QContainerBlockCache class.
+***********************************************************************************************************************/
+
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+
+#include "qcontainer_block_cache.h"
+
+QContainerBlockCache::QContainerBlockCache(unsigned long long maximumSize, unsigned blockSize) {
+    currentMaximumSize = maximumSize;
+    currentBlockSize   = blockSize;
+    currentCachedBytes = 0;
+    currentHits        = 0;
+    currentMisses      = 0;
+}
+
+
+QContainerBlockCache::~QContainerBlockCache() {}
+
+
+void QContainerBlockCache::setMaximumSize(unsigned long long newMaximumSize) {
+    currentMaximumSize = newMaximumSize;
+    evict();
+}
+
+
+unsigned long long QContainerBlockCache::maximumSize() const {
+    return currentMaximumSize;
+}
+
+
+bool QContainerBlockCache::isEnabled() const {
+    return currentMaximumSize >= currentBlockSize;
+}
+
+
+unsigned QContainerBlockCache::blockSize() const {
+    return currentBlockSize;
+}
+
+
+unsigned long long QContainerBlockCache::currentSize() const {
+    return currentCachedBytes;
+}
+
+
+const QByteArray* QContainerBlockCache::block(unsigned long long blockIndex) {
+    const QByteArray* result;
+
+    QHash<unsigned long long, Entry>::iterator it = entries.find(blockIndex);
+    if (it != entries.end()) {
+        usageOrder.splice(usageOrder.begin(), usageOrder, it->usage);
+        result = &(it->data);
+        ++currentHits;
+    } else {
+        result = Q_NULLPTR;
+        ++currentMisses;
+    }
+
+    return result;
+}
+
+
+bool QContainerBlockCache::contains(unsigned long long blockIndex) const {
+    return entries.contains(blockIndex);
+}
+
+
+void QContainerBlockCache::insert(unsigned long long blockIndex, const QByteArray& data) {
+    if (isEnabled()) {
+        remove(blockIndex);
+        evict(static_cast<unsigned long long>(data.size()));
+
+        usageOrder.push_front(blockIndex);
+
+        Entry entry;
+        entry.data  = data;
+        entry.usage = usageOrder.begin();
+
+        entries.insert(blockIndex, entry);
+        currentCachedBytes += static_cast<unsigned long long>(data.size());
+    }
+}
+
+
+void QContainerBlockCache::update(unsigned long long offset, const std::uint8_t* data, unsigned long long count) {
+    if (!entries.isEmpty() && count > 0) {
+        unsigned long long endOffset  = offset + count;
+        unsigned long long firstBlock = offset / currentBlockSize;
+        unsigned long long lastBlock  = (endOffset - 1) / currentBlockSize;
+
+        for (unsigned long long blockIndex=firstBlock ; blockIndex<=lastBlock ; ++blockIndex) {
+            QHash<unsigned long long, Entry>::iterator it = entries.find(blockIndex);
+            if (it != entries.end()) {
+                QByteArray&        blockData  = it->data;
+                unsigned long long blockStart = blockIndex * currentBlockSize;
+                unsigned long long copyStart  = offset > blockStart ? offset : blockStart;
+                unsigned long long copyEnd    = qMin(endOffset, blockStart + currentBlockSize);
+
+                if (copyStart - blockStart <= static_cast<unsigned long long>(blockData.size())) {
+                    // The write either overlaps or directly extends the cached data.
+
+                    unsigned long long blockLength = qMax(
+                        copyEnd - blockStart,
+                        static_cast<unsigned long long>(blockData.size())
+                    );
+
+                    currentCachedBytes -= static_cast<unsigned long long>(blockData.size());
+                    blockData.resize(static_cast<int>(blockLength));
+                    currentCachedBytes += blockLength;
+
+                    std::memcpy(
+                        blockData.data() + (copyStart - blockStart),
+                        data + (copyStart - offset),
+                        static_cast<std::size_t>(copyEnd - copyStart)
+                    );
+                } else {
+                    // The write leaves a gap after the cached data so the block is no longer valid.
+                    remove(blockIndex);
+                }
+            }
+        }
+    }
+}
+
+
+void QContainerBlockCache::truncate(unsigned long long newSize) {
+    QList<unsigned long long> blocksToRemove;
+
+    for (QHash<unsigned long long, Entry>::iterator it=entries.begin(),end=entries.end() ; it!=end ; ++it) {
+        unsigned long long blockStart = it.key() * currentBlockSize;
+        if (blockStart >= newSize) {
+            blocksToRemove.append(it.key());
+        } else if (blockStart + static_cast<unsigned long long>(it->data.size()) > newSize) {
+            currentCachedBytes -= blockStart + it->data.size() - newSize;
+            it->data.resize(static_cast<int>(newSize - blockStart));
+        }
+    }
+
+    for (QList<unsigned long long>::const_iterator it=blocksToRemove.constBegin(),end=blocksToRemove.constEnd() ;
+         it!=end                                                                                          ;
+         ++it) {
+        remove(*it);
+    }
+}
+
+
+void QContainerBlockCache::clear() {
+    entries.clear();
+    usageOrder.clear();
+    currentCachedBytes = 0;
+}
+
+
+unsigned long long QContainerBlockCache::hits() const {
+    return currentHits;
+}
+
+
+unsigned long long QContainerBlockCache::misses() const {
+    return currentMisses;
+}
+
+
+void QContainerBlockCache::resetStatistics() {
+    currentHits   = 0;
+    currentMisses = 0;
+}
+
+
+void QContainerBlockCache::remove(unsigned long long blockIndex) {
+    QHash<unsigned long long, Entry>::iterator it = entries.find(blockIndex);
+    if (it != entries.end()) {
+        currentCachedBytes -= static_cast<unsigned long long>(it->data.size());
+        usageOrder.erase(it->usage);
+        entries.erase(it);
+    }
+}
+
+
+void QContainerBlockCache::evict(unsigned long long requiredSpace) {
+    while (!usageOrder.empty() && currentCachedBytes + requiredSpace > currentMaximumSize) {
+        remove(usageOrder.back());
+    }
+}
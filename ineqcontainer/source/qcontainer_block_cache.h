@@ -0,0 +1,237 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref QContainerBlockCache class.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineqcontainer */
+
+#ifndef QCONTAINER_BLOCK_CACHE_H
+#define QCONTAINER_BLOCK_CACHE_H
+
+#include <QHash>
+#include <QByteArray>
+
+#include <cstdint>
+#include <list>
+
+/**
+ * Private class that maintains a least-recently-used cache of fixed size blocks read from the device underlying a
+ * \ref QContainer.  Cached blocks are kept coherent with the device by applying all writes and truncations to the
+ * cache.  The last block of the device may be shorter than the block size.
+ */
+class QContainerBlockCache {
+    public:
+        /**
+         * The default block size, in bytes.
+         */
+        static constexpr unsigned defaultBlockSize = 4096;
+
+        /**
+         * Constructor
+         *
+         * \param[in] maximumSize The maximum number of bytes of data to hold in the cache.  A value of zero disables
+         *                        the cache.
+         *
+         * \param[in] blockSize   The size of each cached block, in bytes.
+         */
+        QContainerBlockCache(unsigned long long maximumSize = 0, unsigned blockSize = defaultBlockSize);
+
+        ~QContainerBlockCache();
+
+        /**
+         * Method you can use to change the maximum number of bytes of data to hold in the cache.  Blocks will be
+         * evicted as needed.
+         *
+         * \param[in] newMaximumSize The new maximum size, in bytes.  A value of zero disables the cache.
+         */
+        void setMaximumSize(unsigned long long newMaximumSize);
+
+        /**
+         * Method you can use to determine the maximum number of bytes of data to hold in the cache.
+         *
+         * \return Returns the maximum cache size, in bytes.
+         */
+        unsigned long long maximumSize() const;
+
+        /**
+         * Method you can use to determine if the cache is enabled.
+         *
+         * \return Returns true if the cache is enabled.  Returns false if the cache is disabled.
+         */
+        bool isEnabled() const;
+
+        /**
+         * Method you can use to determine the size of each cached block.
+         *
+         * \return Returns the block size, in bytes.
+         */
+        unsigned blockSize() const;
+
+        /**
+         * Method you can use to determine the number of bytes of data currently held in the cache.
+         *
+         * \return Returns the number of bytes currently cached.
+         */
+        unsigned long long currentSize() const;
+
+        /**
+         * Method that looks up a block in the cache, marking the block as most recently used.  The hit and miss
+         * counters are updated by this method.
+         *
+         * \param[in] blockIndex The zero based index of the block.
+         *
+         * \return Returns a pointer to the cached block data.  A null pointer is returned if the block is not cached.
+         *         The pointer remains valid until the cache is next modified.
+         */
+        const QByteArray* block(unsigned long long blockIndex);
+
+        /**
+         * Method you can use to determine if a block is cached without updating the usage order or counters.
+         *
+         * \param[in] blockIndex The zero based index of the block.
+         *
+         * \return Returns true if the block is cached.  Returns false if the block is not cached.
+         */
+        bool contains(unsigned long long blockIndex) const;
+
+        /**
+         * Method that inserts a block into the cache, evicting the least recently used blocks as needed.
+         *
+         * \param[in] blockIndex The zero based index of the block.
+         *
+         * \param[in] data       The block data.  The data can be shorter than the block size only for the last block
+         *                       of the device.
+         */
+        void insert(unsigned long long blockIndex, const QByteArray& data);
+
+        /**
+         * Method that applies a write to any cached blocks covering the written range.
+         *
+         * \param[in] offset The zero based byte offset of the write.
+         *
+         * \param[in] data   The written data.
+         *
+         * \param[in] count  The number of bytes written.
+         */
+        void update(unsigned long long offset, const std::uint8_t* data, unsigned long long count);
+
+        /**
+         * Method that discards cached data past a new device size.
+         *
+         * \param[in] newSize The new size of the device, in bytes.
+         */
+        void truncate(unsigned long long newSize);
+
+        /**
+         * Method that discards all cached blocks.  The hit and miss counters are not modified.
+         */
+        void clear();
+
+        /**
+         * Method you can use to determine the number of block lookups that were serviced from the cache.
+         *
+         * \return Returns the number of cache hits.
+         */
+        unsigned long long hits() const;
+
+        /**
+         * Method you can use to determine the number of block lookups that could not be serviced from the cache.
+         *
+         * \return Returns the number of cache misses.
+         */
+        unsigned long long misses() const;
+
+        /**
+         * Method you can use to reset the hit and miss counters.
+         */
+        void resetStatistics();
+
+    private:
+        /**
+         * Type used to track block usage order.  The most recently used block is at the front of the list.
+         */
+        typedef std::list<unsigned long long> UsageList;
+
+        /**
+         * Structure holding a single cached block.
+         */
+        struct Entry {
+            /**
+             * The block data.
+             */
+            QByteArray data;
+
+            /**
+             * The location of this block in the usage list.
+             */
+            UsageList::iterator usage;
+        };
+
+        /**
+         * Method that removes a block from the cache.
+         *
+         * \param[in] blockIndex The zero based index of the block to be removed.
+         */
+        void remove(unsigned long long blockIndex);
+
+        /**
+         * Method that evicts least recently used blocks until the cache fits within its maximum size.
+         *
+         * \param[in] requiredSpace Additional space, in bytes, that must be made available.
+         */
+        void evict(unsigned long long requiredSpace = 0);
+
+        /**
+         * The maximum number of bytes to hold in the cache.
+         */
+        unsigned long long currentMaximumSize;
+
+        /**
+         * The block size, in bytes.
+         */
+        unsigned currentBlockSize;
+
+        /**
+         * The number of bytes currently held in the cache.
+         */
+        unsigned long long currentCachedBytes;
+
+        /**
+         * The number of cache hits.
+         */
+        unsigned long long currentHits;
+
+        /**
+         * The number of cache misses.
+         */
+        unsigned long long currentMisses;
+
+        /**
+         * The cached blocks, keyed by block index.
+         */
+        QHash<unsigned long long, Entry> entries;
+
+        /**
+         * The block usage order.
+         */
+        UsageList usageOrder;
+};
+
+#endif
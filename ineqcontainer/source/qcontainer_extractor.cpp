@@ -0,0 +1,305 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref QContainerExtractor class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+#include <QSet>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include "qcontainer.h"
+#include "qcontainer_importer.h"
+#include "qcontainer_extractor.h"
+
+QContainerExtractor::QContainerExtractor(QContainer* container) {
+    currentContainer           = container;
+    currentThreadCount         = 0;
+    currentMaximumPendingFiles = defaultMaximumPendingFiles;
+    currentFilesExtracted      = 0;
+    currentBytesExtracted      = 0;
+}
+
+
+QContainerExtractor::~QContainerExtractor() {}
+
+
+void QContainerExtractor::setThreadCount(unsigned newThreadCount) {
+    currentThreadCount = newThreadCount;
+}
+
+
+unsigned QContainerExtractor::threadCount() const {
+    return currentThreadCount;
+}
+
+
+void QContainerExtractor::setMaximumPendingFiles(unsigned newMaximumPendingFiles) {
+    currentMaximumPendingFiles = newMaximumPendingFiles > 0 ? newMaximumPendingFiles : 1;
+}
+
+
+unsigned QContainerExtractor::maximumPendingFiles() const {
+    return currentMaximumPendingFiles;
+}
+
+
+bool QContainerExtractor::extractDirectory(const QString& directoryPath, const QString& prefix) {
+    bool        success = true;
+    QDir        directory(directoryPath);
+    QStringList virtualFileNames;
+    QStringList filenames;
+
+    QContainer::HandleMap handles = currentContainer->listPrefix(prefix);
+    for (QContainer::HandleMap::const_iterator it=handles.constBegin() ; success && it!=handles.constEnd() ; ++it) {
+        QString relativePath     = QDir::cleanPath(it.key().mid(prefix.size()));
+        bool    outsideDirectory = (
+               relativePath.isEmpty()
+            || relativePath == QString("..")
+            || relativePath.startsWith(QString("../"))
+            || QDir::isAbsolutePath(relativePath)
+        );
+
+        if (outsideDirectory) {
+            currentErrorString = QString("Invalid file name %1").arg(it.key());
+            success            = false;
+        } else {
+            virtualFileNames.append(it.key());
+            filenames.append(directory.filePath(relativePath));
+        }
+    }
+
+    if (success) {
+        success = extractFiles(virtualFileNames, filenames);
+    }
+
+    return success;
+}
+
+
+bool QContainerExtractor::extractFiles(const QStringList& virtualFileNames, const QStringList& filenames) {
+    bool success = (virtualFileNames.size() == filenames.size());
+
+    currentFilesExtracted = 0;
+    currentBytesExtracted = 0;
+    currentErrorString.clear();
+
+    QThreadPool threadPool;
+    if (currentThreadCount > 0) {
+        threadPool.setMaxThreadCount(static_cast<int>(currentThreadCount));
+    }
+
+    QSet<QString> compressedNames = QContainerImporter::compressedVirtualFiles(currentContainer);
+    int           fileCount       = success ? virtualFileNames.size() : 0;
+
+    // Files are extracted in the order they are estimated to be stored so the container is read mostly
+    // sequentially.  Files with the same estimate keep their requested order.
+
+    QVector<unsigned long long> storageOffsets(fileCount);
+    QList<int>                  order;
+    for (int fileIndex=0 ; fileIndex<fileCount ; ++fileIndex) {
+        storageOffsets[fileIndex] = currentContainer->storageOffset(virtualFileNames.at(fileIndex));
+        order.append(fileIndex);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&storageOffsets](int first, int second) {
+        return storageOffsets.at(first) < storageOffsets.at(second);
+    });
+
+    // Files are read from the container by this thread, one chunk at a time, and each chunk is handed to a worker
+    // that writes it at its offset in the output file.  Once the pending limit is reached, the oldest write is
+    // waited on before the next chunk is read.  The final chunk of a file may be empty.
+
+    int                    nextPosition = 0;
+    unsigned long long     readOffset   = 0;
+    unsigned long long     writeOffset  = 0;
+    QList<QFuture<qint64>> pending;
+    QList<int>             pendingIndexes;
+    QList<bool>            pendingLast;
+
+    while (nextPosition < fileCount || !pending.isEmpty()) {
+        if (success && nextPosition < fileCount && static_cast<unsigned>(pending.size()) < currentMaximumPendingFiles) {
+            int        fileIndex       = order.at(nextPosition);
+            QString    virtualFileName = virtualFileNames.at(fileIndex);
+            QString    filename        = filenames.at(fileIndex);
+            bool       decompress      = compressedNames.contains(virtualFileName);
+            bool       last            = false;
+            QByteArray data;
+
+            unsigned long long chunkLength  = 0;
+            unsigned long long outputLength = 0;
+
+            if (readOffset == 0 && !createOutputFile(filename)) {
+                currentErrorString = QString("Could not write %1").arg(filename);
+                success            = false;
+            } else if (!decompress) {
+                success = currentContainer->readVirtualFile(virtualFileName, readOffset, outputChunkSize, data);
+                if (success) {
+                    chunkLength  = static_cast<unsigned long long>(data.size());
+                    outputLength = chunkLength;
+                    last         = (chunkLength < outputChunkSize);
+                }
+            } else {
+                // Each compressed chunk is a 32-bit little endian length followed by the output of qCompress, which
+                // starts with the big endian size of the uncompressed chunk.
+
+                QByteArray header;
+                success = currentContainer->readVirtualFile(virtualFileName, readOffset, 4, header);
+                if (success && header.isEmpty()) {
+                    last = true;
+                } else if (success) {
+                    quint32 length = header.size() == 4 ? qFromLittleEndian<quint32>(header.constData()) : 0;
+
+                    success = (
+                           length >= 4
+                        && currentContainer->readVirtualFile(virtualFileName, readOffset + 4, length, data)
+                        && static_cast<quint32>(data.size()) == length
+                    );
+
+                    if (success) {
+                        chunkLength  = 4 + length;
+                        outputLength = qFromBigEndian<quint32>(data.constData());
+                    }
+                }
+            }
+
+            if (success) {
+                unsigned long long offset = writeOffset;
+
+                pending.append(QtConcurrent::run(&threadPool, [filename, offset, data, decompress]() {
+                    return storeOutputChunk(filename, offset, data, decompress);
+                }));
+
+                pendingIndexes.append(fileIndex);
+                pendingLast.append(last);
+
+                if (last) {
+                    ++nextPosition;
+                    readOffset  = 0;
+                    writeOffset = 0;
+                } else {
+                    readOffset  += chunkLength;
+                    writeOffset += outputLength;
+                }
+            } else if (currentErrorString.isEmpty()) {
+                currentErrorString = QString("Could not read %1").arg(virtualFileName);
+            }
+        } else if (!pending.isEmpty()) {
+            int    fileIndex    = pendingIndexes.takeFirst();
+            bool   last         = pendingLast.takeFirst();
+            qint64 bytesWritten = pending.takeFirst().result();
+
+            if (bytesWritten >= 0) {
+                currentBytesExtracted += static_cast<unsigned long long>(bytesWritten);
+                if (last) {
+                    ++currentFilesExtracted;
+                }
+            } else if (success) {
+                currentErrorString = QString("Could not write %1").arg(filenames.at(fileIndex));
+                success            = false;
+            }
+        } else {
+            // An error stopped the extraction and all pending writes have completed.
+            nextPosition = fileCount;
+        }
+    }
+
+    threadPool.waitForDone();
+
+    return success;
+}
+
+
+unsigned long long QContainerExtractor::filesExtracted() const {
+    return currentFilesExtracted;
+}
+
+
+unsigned long long QContainerExtractor::bytesExtracted() const {
+    return currentBytesExtracted;
+}
+
+
+QString QContainerExtractor::errorString() const {
+    return currentErrorString;
+}
+
+
+bool QContainerExtractor::createOutputFile(const QString& filename) {
+    bool success;
+
+    if (!QDir().mkpath(QFileInfo(filename).absolutePath())) {
+        success = false;
+    } else {
+        QFile file(filename);
+        success = file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        file.close();
+    }
+
+    return success;
+}
+
+
+qint64 QContainerExtractor::storeOutputChunk(
+        const QString&     filename,
+        unsigned long long offset,
+        const QByteArray&  data,
+        bool               decompress
+    ) {
+    bool       success;
+    QByteArray contents;
+
+    if (!decompress || data.isEmpty()) {
+        contents = data;
+        success  = true;
+    } else {
+        quint32 expectedSize = qFromBigEndian<quint32>(data.constData());
+
+        contents = qUncompress(data);
+        success  = (static_cast<quint32>(contents.size()) == expectedSize);
+    }
+
+    if (success && !contents.isEmpty()) {
+        // The file is opened for reading and writing since opening it write only would truncate it.
+
+        QFile file(filename);
+        success = (
+               file.open(QIODevice::ReadWrite)
+            && file.seek(static_cast<qint64>(offset))
+            && file.write(contents) == static_cast<qint64>(contents.size())
+        );
+
+        file.close();
+        success = success && file.error() == QFileDevice::NoError;
+    }
+
+    return success ? static_cast<qint64>(contents.size()) : -1;
+}
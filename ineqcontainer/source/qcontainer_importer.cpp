@@ -0,0 +1,283 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref QContainerImporter class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QSet>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include "qcontainer.h"
+#include "qcontainer_importer.h"
+
+QContainerImporter::QContainerImporter(QContainer* container) {
+    currentContainer           = container;
+    currentCompressionEnabled  = false;
+    currentThreadCount         = 0;
+    currentMaximumPendingFiles = defaultMaximumPendingFiles;
+    currentFilesImported       = 0;
+    currentBytesImported       = 0;
+}
+
+
+QContainerImporter::~QContainerImporter() {}
+
+
+void QContainerImporter::setCompressionEnabled(bool nowEnabled) {
+    currentCompressionEnabled = nowEnabled;
+}
+
+
+bool QContainerImporter::compressionEnabled() const {
+    return currentCompressionEnabled;
+}
+
+
+void QContainerImporter::setThreadCount(unsigned newThreadCount) {
+    currentThreadCount = newThreadCount;
+}
+
+
+unsigned QContainerImporter::threadCount() const {
+    return currentThreadCount;
+}
+
+
+void QContainerImporter::setMaximumPendingFiles(unsigned newMaximumPendingFiles) {
+    currentMaximumPendingFiles = newMaximumPendingFiles > 0 ? newMaximumPendingFiles : 1;
+}
+
+
+unsigned QContainerImporter::maximumPendingFiles() const {
+    return currentMaximumPendingFiles;
+}
+
+
+bool QContainerImporter::importDirectory(const QString& directoryPath, const QString& prefix) {
+    QDir        directory(directoryPath);
+    QStringList filenames;
+
+    QDirIterator iterator(directoryPath, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (iterator.hasNext()) {
+        filenames.append(iterator.next());
+    }
+
+    filenames.sort();
+
+    QStringList virtualFileNames;
+    for (QStringList::const_iterator it=filenames.constBegin() ; it!=filenames.constEnd() ; ++it) {
+        virtualFileNames.append(prefix + QDir::fromNativeSeparators(directory.relativeFilePath(*it)));
+    }
+
+    return importFiles(filenames, virtualFileNames);
+}
+
+
+bool QContainerImporter::importFiles(const QStringList& filenames, const QStringList& virtualFileNames) {
+    bool success = (filenames.size() == virtualFileNames.size());
+
+    currentFilesImported = 0;
+    currentBytesImported = 0;
+    currentErrorString.clear();
+
+    QThreadPool threadPool;
+    if (currentThreadCount > 0) {
+        threadPool.setMaxThreadCount(static_cast<int>(currentThreadCount));
+    }
+
+    QSet<QString> compressedNames = compressedVirtualFiles(currentContainer);
+    bool          manifestChanged = false;
+
+    // Workers read ahead of the writer by up to the pending limit, one chunk per entry.  Results are consumed in
+    // submission order so the container layout does not depend on thread scheduling.
+
+    bool                        compress     = currentCompressionEnabled;
+    int                         nextIndex    = 0;
+    unsigned long long          nextOffset   = 0;
+    unsigned long long          nextFileSize = 0;
+    int                         fileCount    = success ? filenames.size() : 0;
+    QList<QFuture<SourceChunk>> pending;
+
+    while (success && (nextIndex < fileCount || !pending.isEmpty())) {
+        while (nextIndex < fileCount && static_cast<unsigned>(pending.size()) < currentMaximumPendingFiles) {
+            QString filename = filenames.at(nextIndex);
+            if (nextOffset == 0) {
+                nextFileSize = static_cast<unsigned long long>(qMax(QFileInfo(filename).size(), Q_INT64_C(0)));
+            }
+
+            int                fileIndex = nextIndex;
+            unsigned long long offset    = nextOffset;
+            bool               last      = (offset + sourceChunkSize >= nextFileSize);
+
+            pending.append(QtConcurrent::run(&threadPool, [filename, fileIndex, offset, last, compress]() {
+                return loadSourceChunk(filename, fileIndex, offset, last, compress);
+            }));
+
+            if (last) {
+                ++nextIndex;
+                nextOffset = 0;
+            } else {
+                nextOffset += sourceChunkSize;
+            }
+        }
+
+        SourceChunk sourceChunk     = pending.takeFirst().result();
+        QString     virtualFileName = virtualFileNames.at(sourceChunk.fileIndex);
+
+        if (!sourceChunk.success) {
+            currentErrorString = QString("Could not read %1").arg(filenames.at(sourceChunk.fileIndex));
+            success            = false;
+        } else {
+            bool written;
+            if (sourceChunk.offset == 0) {
+                written = currentContainer->writeVirtualFile(virtualFileName, sourceChunk.data);
+            } else {
+                written = currentContainer->appendVirtualFile(virtualFileName, sourceChunk.data);
+            }
+
+            if (!written) {
+                currentErrorString = QString("Could not write %1").arg(virtualFileName);
+                success            = false;
+            } else {
+                if (sourceChunk.offset == 0 && compressedNames.contains(virtualFileName) != compress) {
+                    if (compress) {
+                        compressedNames.insert(virtualFileName);
+                    } else {
+                        compressedNames.remove(virtualFileName);
+                    }
+
+                    manifestChanged = true;
+                }
+
+                if (sourceChunk.last) {
+                    ++currentFilesImported;
+                }
+
+                currentBytesImported += sourceChunk.sourceSize;
+            }
+        }
+    }
+
+    threadPool.waitForDone();
+
+    // The manifest also covers files written before an error so the extractor can restore them.
+
+    if (manifestChanged) {
+        QStringList names;
+        for (QSet<QString>::const_iterator it=compressedNames.constBegin() ; it!=compressedNames.constEnd() ; ++it) {
+            names.append(*it);
+        }
+
+        names.sort();
+
+        QByteArray manifest;
+        for (QStringList::const_iterator it=names.constBegin() ; it!=names.constEnd() ; ++it) {
+            manifest.append(it->toUtf8());
+            manifest.append("\0", 1);
+        }
+
+        if (!currentContainer->writeVirtualFile(QString(compressionManifestName), manifest) && success) {
+            currentErrorString = QString("Could not write %1").arg(QString(compressionManifestName));
+            success            = false;
+        }
+    }
+
+    return success;
+}
+
+
+unsigned long long QContainerImporter::filesImported() const {
+    return currentFilesImported;
+}
+
+
+unsigned long long QContainerImporter::bytesImported() const {
+    return currentBytesImported;
+}
+
+
+QString QContainerImporter::errorString() const {
+    return currentErrorString;
+}
+
+
+QSet<QString> QContainerImporter::compressedVirtualFiles(QContainer* container) {
+    QSet<QString> result;
+    QByteArray    manifest;
+
+    if (container->readVirtualFile(QString(compressionManifestName), manifest)) {
+        QList<QByteArray> names = manifest.split('\0');
+        for (QList<QByteArray>::const_iterator it=names.constBegin() ; it!=names.constEnd() ; ++it) {
+            if (!it->isEmpty()) {
+                result.insert(QString::fromUtf8(*it));
+            }
+        }
+    }
+
+    return result;
+}
+
+
+QContainerImporter::SourceChunk QContainerImporter::loadSourceChunk(
+        const QString&     filename,
+        int                fileIndex,
+        unsigned long long offset,
+        bool               last,
+        bool               compress
+    ) {
+    SourceChunk result;
+
+    result.fileIndex  = fileIndex;
+    result.offset     = offset;
+    result.last       = last;
+    result.sourceSize = 0;
+
+    QFile file(filename);
+    if (file.open(QIODevice::ReadOnly) && file.seek(static_cast<qint64>(offset))) {
+        QByteArray contents = file.read(sourceChunkSize);
+
+        result.success    = (file.error() == QFileDevice::NoError);
+        result.sourceSize = static_cast<unsigned long long>(contents.size());
+
+        if (compress) {
+            QByteArray compressed = qCompress(contents);
+
+            result.data = QByteArray(4, Qt::Uninitialized);
+            qToLittleEndian<quint32>(static_cast<quint32>(compressed.size()), result.data.data());
+            result.data.append(compressed);
+        } else {
+            result.data = contents;
+        }
+    } else {
+        result.success = false;
+    }
+
+    return result;
+}
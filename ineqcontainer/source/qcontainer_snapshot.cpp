@@ -0,0 +1,333 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref QContainerSnapshotPages and \ref QContainerSnapshot classes.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QIODevice>
+#include <QObject>
+
+#include <cstring>
+#include <memory>
+
+#include "qcontainer_snapshot.h"
+
+QContainerSnapshotPages::QContainerSnapshotPages(unsigned long long snapshotSize) {
+    this->snapshotSize = snapshotSize;
+    memoryBytes        = 0;
+    preserveCount      = 0;
+    spillFile          = Q_NULLPTR;
+}
+
+
+QContainerSnapshotPages::~QContainerSnapshotPages() {
+    delete spillFile;
+}
+
+
+unsigned long long QContainerSnapshotPages::size() const {
+    return snapshotSize;
+}
+
+
+bool QContainerSnapshotPages::contains(unsigned long long pageIndex) {
+    QMutexLocker locker(&pageMutex);
+    return pages.contains(pageIndex) || spilledPages.contains(pageIndex);
+}
+
+
+void QContainerSnapshotPages::preserve(unsigned long long pageIndex, const QByteArray& page) {
+    QMutexLocker locker(&pageMutex);
+
+    if (!pages.contains(pageIndex) && !spilledPages.contains(pageIndex)) {
+        unsigned long long pageBytes = static_cast<unsigned long long>(page.size());
+        bool               spilled   = false;
+
+        if (memoryBytes + pageBytes > memoryLimit) {
+            // The page is held in memory if the temporary file can not be written, so a page is never lost.
+
+            if (spillFile == Q_NULLPTR) {
+                spillFile = new QTemporaryFile;
+                if (!spillFile->open()) {
+                    delete spillFile;
+                    spillFile = Q_NULLPTR;
+                }
+            }
+
+            if (spillFile != Q_NULLPTR) {
+                SpilledPage spilledPage;
+                spilledPage.offset = static_cast<unsigned long long>(spillFile->size());
+                spilledPage.length = pageBytes;
+
+                spilled = (
+                       spillFile->seek(static_cast<qint64>(spilledPage.offset))
+                    && spillFile->write(page) == page.size()
+                    && spillFile->flush()
+                );
+
+                if (spilled) {
+                    spilledPages.insert(pageIndex, spilledPage);
+                }
+            }
+        }
+
+        if (!spilled) {
+            pages.insert(pageIndex, page);
+            memoryBytes += pageBytes;
+        }
+
+        ++preserveCount;
+    }
+}
+
+
+long long QContainerSnapshotPages::read(
+        unsigned long long offset,
+        char*              data,
+        unsigned long long count,
+        QFile*             file,
+        QFile*             spill
+    ) {
+    unsigned long long endOffset = qMin(offset + count, snapshotSize);
+    unsigned long long position  = offset;
+
+    QList<Segment>     fileReads;
+    QList<Segment>     spillReads;
+    unsigned long long startCount;
+    QString            spillFilename;
+
+    // Preserved pages are placed and the container file reads are planned under the lock.
+
+    QMutexLocker locker(&pageMutex);
+
+    startCount = preserveCount;
+    if (spillFile != Q_NULLPTR) {
+        spillFilename = spillFile->fileName();
+    }
+
+    while (position < endOffset) {
+        unsigned long long pageIndex  = position / pageSize;
+        unsigned long long segmentEnd = qMin((pageIndex + 1) * pageSize, endOffset);
+        char*              target     = data + (position - offset);
+
+        if (!placePreserved(pageIndex, position, segmentEnd, target, spillReads)) {
+            // Pages that have not been preserved are unchanged in the file so runs of them are read in one
+            // operation.
+
+            while (
+                   segmentEnd < endOffset
+                && !pages.contains(segmentEnd / pageSize)
+                && !spilledPages.contains(segmentEnd / pageSize)
+            ) {
+                segmentEnd = qMin(segmentEnd + pageSize, endOffset);
+            }
+
+            Segment segment;
+            segment.offset = position;
+            segment.length = segmentEnd - position;
+            segment.target = target;
+
+            fileReads.append(segment);
+        }
+
+        position = segmentEnd;
+    }
+
+    locker.unlock();
+
+    bool success = readSegments(fileReads, file);
+
+    // A page overwritten while the container file was read was preserved before it was overwritten, so its
+    // original contents replace the data read.
+
+    if (success && !fileReads.isEmpty()) {
+        locker.relock();
+
+        if (spillFile != Q_NULLPTR) {
+            spillFilename = spillFile->fileName();
+        }
+
+        if (preserveCount != startCount) {
+            for (int index=0 ; index<fileReads.size() ; ++index) {
+                const Segment&     segment    = fileReads.at(index);
+                unsigned long long segmentEnd = segment.offset + segment.length;
+
+                position = segment.offset;
+                while (position < segmentEnd) {
+                    unsigned long long pageIndex = position / pageSize;
+                    unsigned long long pageEnd   = qMin((pageIndex + 1) * pageSize, segmentEnd);
+                    char*              target    = segment.target + (position - segment.offset);
+
+                    placePreserved(pageIndex, position, pageEnd, target, spillReads);
+                    position = pageEnd;
+                }
+            }
+        }
+
+        locker.unlock();
+    }
+
+    if (success && !spillReads.isEmpty() && !spill->isOpen()) {
+        spill->setFileName(spillFilename);
+        success = spill->open(QIODevice::ReadOnly);
+    }
+
+    if (success) {
+        success = readSegments(spillReads, spill);
+    }
+
+    return success ? static_cast<long long>(endOffset > offset ? endOffset - offset : 0) : -1;
+}
+
+
+bool QContainerSnapshotPages::placePreserved(
+        unsigned long long pageIndex,
+        unsigned long long position,
+        unsigned long long segmentEnd,
+        char*              target,
+        QList<Segment>&    spillReads
+    ) {
+    bool               preserved  = true;
+    unsigned long long pageOffset = position - pageIndex * pageSize;
+    unsigned long long available  = 0;
+
+    QHash<unsigned long long, QByteArray>::const_iterator page = pages.constFind(pageIndex);
+    if (page != pages.constEnd()) {
+        available = static_cast<unsigned long long>(page->size());
+        if (pageOffset < available) {
+            std::memcpy(
+                target,
+                page->constData() + pageOffset,
+                static_cast<std::size_t>(qMin(available - pageOffset, segmentEnd - position))
+            );
+        }
+    } else {
+        QHash<unsigned long long, SpilledPage>::const_iterator spilled = spilledPages.constFind(pageIndex);
+        if (spilled != spilledPages.constEnd()) {
+            available = spilled->length;
+            if (pageOffset < available) {
+                Segment segment;
+                segment.offset = spilled->offset + pageOffset;
+                segment.length = qMin(available - pageOffset, segmentEnd - position);
+                segment.target = target;
+
+                spillReads.append(segment);
+            }
+        } else {
+            preserved = false;
+        }
+    }
+
+    if (preserved) {
+        // The last page may be shorter than the page size.  Bytes past its end read as zero.
+
+        unsigned long long copyBytes = pageOffset < available ? qMin(available - pageOffset, segmentEnd - position) : 0;
+        std::memset(target + copyBytes, 0, static_cast<std::size_t>(segmentEnd - position - copyBytes));
+    }
+
+    return preserved;
+}
+
+
+bool QContainerSnapshotPages::readSegments(const QList<Segment>& segments, QFile* file) {
+    bool success = true;
+    int  index   = 0;
+
+    while (success && index < segments.size()) {
+        const Segment& segment = segments.at(index);
+        qint64         length  = static_cast<qint64>(segment.length);
+
+        success = (
+               file->seek(static_cast<qint64>(segment.offset))
+            && file->read(segment.target, length) == length
+        );
+
+        ++index;
+    }
+
+    return success;
+}
+
+
+QContainerSnapshot::QContainerSnapshot(
+        const QString&                           filename,
+        std::shared_ptr<QContainerSnapshotPages> pages,
+        QObject*                                 parent
+    ):QIODevice(
+        parent
+    ) {
+    file.setFileName(filename);
+    snapshotPages = pages;
+}
+
+
+QContainerSnapshot::~QContainerSnapshot() {}
+
+
+bool QContainerSnapshot::open(QIODevice::OpenMode openMode) {
+    bool success;
+
+    if ((openMode & QIODevice::WriteOnly) != 0) {
+        setErrorString(QString("Snapshots are read-only"));
+        success = false;
+    } else if (!file.open(QIODevice::ReadOnly)) {
+        setErrorString(file.errorString());
+        success = false;
+    } else {
+        success = QIODevice::open(openMode);
+    }
+
+    return success;
+}
+
+
+void QContainerSnapshot::close() {
+    QIODevice::close();
+    file.close();
+    spillFile.close();
+}
+
+
+qint64 QContainerSnapshot::size() const {
+    return static_cast<qint64>(snapshotPages->size());
+}
+
+
+qint64 QContainerSnapshot::readData(char* data, qint64 maxSize) {
+    return snapshotPages->read(
+        static_cast<unsigned long long>(pos()),
+        data,
+        static_cast<unsigned long long>(maxSize),
+        &file,
+        &spillFile
+    );
+}
+
+
+qint64 QContainerSnapshot::writeData(const char*, qint64) {
+    return -1;
+}
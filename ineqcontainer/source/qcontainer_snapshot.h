@@ -0,0 +1,318 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This header defines the \ref QContainerSnapshotPages and \ref QContainerSnapshot classes.
+***********************************************************************************************************************/
+
+/* .. sphinx-project ineqcontainer */
+
+#ifndef QCONTAINER_SNAPSHOT_H
+#define QCONTAINER_SNAPSHOT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QIODevice>
+#include <QObject>
+
+#include <memory>
+
+/**
+ * Private class that holds the pages preserved for a container snapshot.  Before the container overwrites or
+ * truncates data within the snapshot, it preserves the original pages here.  The snapshot reads preserved pages from
+ * this class and all other pages directly from the container file.
+ *
+ * A single lock protects the preserved pages.  Readers hold the lock only while copying preserved pages and read the
+ * container file without it, so a slow read never delays the container.  Since a page is always preserved before it
+ * is overwritten, a reader checks again after reading the file and replaces any page preserved in the meantime with
+ * its original contents.
+ *
+ * Up to \ref memoryLimit bytes of preserved pages are held in memory.  Further pages are appended to a temporary
+ * file that is removed when the pages are released.
+ */
+class QContainerSnapshotPages {
+    public:
+        /**
+         * The size of each preserved page, in bytes.
+         */
+        static constexpr unsigned pageSize = 4096;
+
+        /**
+         * The number of bytes of preserved pages held in memory.  Pages preserved beyond this limit are written to a
+         * temporary file.
+         */
+        static constexpr unsigned long long memoryLimit = 64 * 1024 * 1024;
+
+        /**
+         * Constructor
+         *
+         * \param[in] snapshotSize The size of the container when the snapshot was taken, in bytes.
+         */
+        QContainerSnapshotPages(unsigned long long snapshotSize);
+
+        ~QContainerSnapshotPages();
+
+        /**
+         * Method you can use to obtain the size of the container when the snapshot was taken.
+         *
+         * \return Returns the snapshot size, in bytes.
+         */
+        unsigned long long size() const;
+
+        /**
+         * Method you can use to determine if a page has already been preserved.
+         *
+         * \param[in] pageIndex The zero based index of the page.
+         *
+         * \return Returns true if the page has been preserved.  Returns false if the page is still read from the
+         *         container file.
+         */
+        bool contains(unsigned long long pageIndex);
+
+        /**
+         * Method you can use to preserve the original contents of a page.  Pages that are already preserved are
+         * left unchanged.
+         *
+         * \param[in] pageIndex The zero based index of the page.
+         *
+         * \param[in] page      The original contents of the page.  The last page may be shorter than the page size.
+         */
+        void preserve(unsigned long long pageIndex, const QByteArray& page);
+
+        /**
+         * Method you can use to read snapshot data.
+         *
+         * \param[in] offset The zero based byte offset of the first byte to read.
+         *
+         * \param[in] data   The buffer to receive the data.
+         *
+         * \param[in] count  The number of bytes to read.
+         *
+         * \param[in] file   The file used to read pages that have not been preserved.
+         *
+         * \param[in] spill  The file used to read preserved pages held in the temporary file.  The file is opened
+         *                   by this method when first needed.
+         *
+         * \return Returns the number of bytes read.  A negative value is returned on error.
+         */
+        long long read(unsigned long long offset, char* data, unsigned long long count, QFile* file, QFile* spill);
+
+    private:
+        /**
+         * Structure describing a read to be performed without the lock held.
+         */
+        struct Segment {
+            /**
+             * The offset of the data in the file to be read.
+             */
+            unsigned long long offset;
+
+            /**
+             * The number of bytes to read.
+             */
+            unsigned long long length;
+
+            /**
+             * The location in the read buffer that receives the data.
+             */
+            char* target;
+        };
+
+        /**
+         * Structure describing a preserved page held in the temporary file.
+         */
+        struct SpilledPage {
+            /**
+             * The offset of the page in the temporary file.
+             */
+            unsigned long long offset;
+
+            /**
+             * The length of the page, in bytes.
+             */
+            unsigned long long length;
+        };
+
+        /**
+         * Method that places the preserved contents of part of a page in a read buffer.  Contents held in memory are
+         * copied immediately.  Contents held in the temporary file are added to a list of reads.  The caller must
+         * hold the lock.
+         *
+         * \param[in]  pageIndex   The zero based index of the page.
+         *
+         * \param[in]  position    The offset of the first byte to place.
+         *
+         * \param[in]  segmentEnd  The offset just past the last byte to place.  The range must lie within the page.
+         *
+         * \param[in]  target      The location in the read buffer that receives the first byte.
+         *
+         * \param[out] spillReads  List of reads from the temporary file, updated by this method.
+         *
+         * \return Returns true if the page is preserved.  Returns false if the page must be read from the container
+         *         file.
+         */
+        bool placePreserved(
+            unsigned long long pageIndex,
+            unsigned long long position,
+            unsigned long long segmentEnd,
+            char*              target,
+            QList<Segment>&    spillReads
+        );
+
+        /**
+         * Method that performs a list of reads.
+         *
+         * \param[in] segments The reads to perform.
+         *
+         * \param[in] file     The file to read from.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        static bool readSegments(const QList<Segment>& segments, QFile* file);
+
+        /**
+         * The size of the snapshot, in bytes.
+         */
+        unsigned long long snapshotSize;
+
+        /**
+         * Lock ordering page preservation against reads.
+         */
+        QMutex pageMutex;
+
+        /**
+         * The preserved pages held in memory, by page index.
+         */
+        QHash<unsigned long long, QByteArray> pages;
+
+        /**
+         * The preserved pages held in the temporary file, by page index.
+         */
+        QHash<unsigned long long, SpilledPage> spilledPages;
+
+        /**
+         * The number of bytes of preserved pages held in memory.
+         */
+        unsigned long long memoryBytes;
+
+        /**
+         * The number of pages preserved so far.  Readers compare the value before and after reading the container
+         * file to determine if pages may have been overwritten during the read.
+         */
+        unsigned long long preserveCount;
+
+        /**
+         * The temporary file holding pages preserved beyond \ref memoryLimit.  A null pointer indicates that no
+         * page has been written to a temporary file.
+         */
+        QTemporaryFile* spillFile;
+};
+
+/**
+ * Private read-only device used as the underlying device of a container snapshot.  The device presents the container
+ * file as it was when the snapshot was taken.
+ */
+class QContainerSnapshot:public QIODevice {
+    Q_OBJECT
+
+    public:
+        /**
+         * Constructor
+         *
+         * \param[in] filename The name of the container file.
+         *
+         * \param[in] pages    The pages preserved for this snapshot.  The container writing the file holds a weak
+         *                     reference to the pages so that preservation stops once the snapshot is released.
+         *
+         * \param[in] parent   Pointer to the parent object.
+         */
+        QContainerSnapshot(
+            const QString&                           filename,
+            std::shared_ptr<QContainerSnapshotPages> pages,
+            QObject*                                 parent = Q_NULLPTR
+        );
+
+        ~QContainerSnapshot() override;
+
+        /**
+         * Method you can use to open the device.  Only read-only access is supported.
+         *
+         * \param[in] openMode The requested open mode.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool open(OpenMode openMode) override;
+
+        /**
+         * Method you can use to close the device.
+         */
+        void close() override;
+
+        /**
+         * Method you can use to obtain the size of the snapshot.
+         *
+         * \return Returns the size of the snapshot, in bytes.
+         */
+        qint64 size() const override;
+
+    protected:
+        /**
+         * Method that reads data from the current position.
+         *
+         * \param[in] data    The buffer to receive the data.
+         *
+         * \param[in] maxSize The maximum number of bytes to read.
+         *
+         * \return Returns the number of bytes read.  A negative value is returned on error.
+         */
+        qint64 readData(char* data, qint64 maxSize) override;
+
+        /**
+         * Method that rejects writes to the snapshot.
+         *
+         * \param[in] data The data to be written.
+         *
+         * \param[in] size The number of bytes to write.
+         *
+         * \return Always returns -1.
+         */
+        qint64 writeData(const char* data, qint64 size) override;
+
+    private:
+        /**
+         * The container file.
+         */
+        QFile file;
+
+        /**
+         * The temporary file holding preserved pages, opened when a spilled page is first read.
+         */
+        QFile spillFile;
+
+        /**
+         * The pages preserved for this snapshot.
+         */
+        std::shared_ptr<QContainerSnapshotPages> snapshotPages;
+};
+
+#endif
@@ -20,41 +20,138 @@
 * This file implements the \ref QContainer class.
 ***********************************************************************************************************************/
 
-#include <QMap>
-#include <QList>
-#include <QFile>
+#include <QString>
 #include <QByteArray>
+#include <QFile>
+#include <QIODevice>
 #include <QObject>
+#include <QtEndian>
 
-#include <container_status.h>
-#include <container_virtual_file.h>
-#include <container_container.h>
+#include <cstring>
+#include <array>
 
-#include "qvirtual_file.h"
+#include "qcontainer.h"
 #include "qfile_container.h"
 
 QFileContainer::QFileContainer(
         const QString& fileIdentifier,
         QObject*       parent
-    ):QObject(
+    ):QContainer(
+        fileIdentifier,
         parent
-    ),FileContainer(
-        fileIdentifier.toStdString()
-    ) {}
+    ) {
+    currentFile                  = Q_NULLPTR;
+    lastOpenMode                 = OpenMode::READ_WRITE;
+    currentJournalEnabled        = false;
+    currentJournalCheckpointSize = defaultJournalCheckpointSize;
+    journalFile                  = Q_NULLPTR;
+    journalPending               = false;
 
+    setIoMode(IoMode::POSITIONAL);
+}
 
-QFileContainer::~QFileContainer() {}
+
+QFileContainer::~QFileContainer() {
+    if (currentFile != Q_NULLPTR) {
+        close();
+    }
+}
 
 
 bool QFileContainer::open(const QString& filename, OpenMode openMode) {
     bool success;
-    QByteArray          localFilename = QFile::encodeName(filename);
-    ::Container::Status status        = ::Container::FileContainer::open(localFilename.toStdString(), openMode);
 
-    if (status) {
+    if (currentFile != Q_NULLPTR) {
+        close();
+    }
+
+    QIODevice::OpenMode fileOpenMode;
+    switch (openMode) {
+        case OpenMode::READ_ONLY:  { fileOpenMode = QIODevice::ReadOnly;                       break; }
+        case OpenMode::READ_WRITE: { fileOpenMode = QIODevice::ReadWrite;                      break; }
+        case OpenMode::OVERWRITE:  { fileOpenMode = QIODevice::ReadWrite | QIODevice::Truncate; break; }
+        default:                   { fileOpenMode = QIODevice::ReadOnly;                       break; }
+    }
+
+    fileErrorString.clear();
+
+    lastFilename = filename;
+    lastOpenMode = openMode;
+
+    // Complete any transactions left in the journal by an interrupted process before the file is opened.  The
+    // journal is meaningless once the file is overwritten.  A read-only open must not modify the file, so it is
+    // refused while the journal holds records.
+
+    bool journalReplayed;
+    bool journalBlocksOpen;
+    if (openMode == OpenMode::OVERWRITE) {
+        QFile::remove(journalFilename(filename));
+        journalReplayed   = true;
+        journalBlocksOpen = false;
+    } else if (openMode == OpenMode::READ_ONLY) {
+        QFile journal(journalFilename(filename));
+        journalReplayed   = true;
+        journalBlocksOpen = journal.exists() && journal.size() > 0;
+    } else {
+        journalReplayed   = replayJournal(filename);
+        journalBlocksOpen = false;
+    }
+
+    currentFile = new QFile(filename);
+
+    if (journalBlocksOpen) {
+        fileErrorString = QString("Journal must be replayed by opening the container for writing");
+        delete currentFile;
+        currentFile = Q_NULLPTR;
+
+        success = false;
+    } else if (!journalReplayed) {
+        fileErrorString = QString("Journal could not be replayed");
+        delete currentFile;
+        currentFile = Q_NULLPTR;
+
         success = false;
+    } else if (currentFile->open(fileOpenMode)) {
+        attachDevice(currentFile);
+        success = QContainer::open();
+
+        if (success && currentJournalEnabled && openMode != OpenMode::READ_ONLY) {
+            journalFile = new QFile(journalFilename(filename));
+            if (!journalFile->open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+                fileErrorString = journalFile->errorString();
+                delete journalFile;
+                journalFile = Q_NULLPTR;
+
+                QContainer::close();
+                success = false;
+            }
+        }
+
+        if (!success) {
+            attachDevice(Q_NULLPTR);
+            delete currentFile;
+            currentFile = Q_NULLPTR;
+        }
     } else {
-        success = true;
+        fileErrorString = currentFile->errorString();
+        delete currentFile;
+        currentFile = Q_NULLPTR;
+
+        success = false;
+    }
+
+    return success;
+}
+
+
+bool QFileContainer::open() {
+    bool success;
+
+    if (lastFilename.isEmpty()) {
+        fileErrorString = QString("No file to reopen");
+        success         = false;
+    } else {
+        success = open(lastFilename, lastOpenMode == OpenMode::OVERWRITE ? OpenMode::READ_WRITE : lastOpenMode);
     }
 
     return success;
@@ -63,12 +160,36 @@ bool QFileContainer::open(const QString& filename, OpenMode openMode) {
 
 bool QFileContainer::close() {
     bool success;
-    ::Container::Status status = ::Container::FileContainer::close();
 
-    if (status) {
-        success = false;
+    if (currentFile != Q_NULLPTR) {
+        if (journalFile != Q_NULLPTR) {
+            // Journal the directory update written by the container engine so that it is applied atomically, then
+            // checkpoint so that the journal can be removed.
+
+            bool closeJournaled = beginCloseTransaction();
+            bool closed         = QContainer::close();
+
+            success = closeJournaled && closed && checkpointJournal();
+
+            journalFile->close();
+            if (success) {
+                journalFile->remove();
+            }
+
+            delete journalFile;
+            journalFile    = Q_NULLPTR;
+            journalPending = false;
+        } else {
+            success = QContainer::close();
+        }
+
+        attachDevice(Q_NULLPTR);
+        currentFile->close();
+
+        delete currentFile;
+        currentFile = Q_NULLPTR;
     } else {
-        success = true;
+        success = QContainer::close();
     }
 
     return success;
@@ -76,59 +197,340 @@ bool QFileContainer::close() {
 
 
 QString QFileContainer::filename() const {
-    QByteArray localFilename = QByteArray::fromStdString(::Container::FileContainer::filename());
-    return QFile::decodeName(localFilename);
+    return currentFile != Q_NULLPTR ? currentFile->fileName() : QString();
+}
+
+
+QString QFileContainer::errorString() const {
+    return fileErrorString.isEmpty() ? QContainer::errorString() : fileErrorString;
+}
+
+
+void QFileContainer::setJournalEnabled(bool nowEnabled) {
+    currentJournalEnabled = nowEnabled;
+}
+
+
+bool QFileContainer::journalEnabled() const {
+    return currentJournalEnabled;
+}
+
+
+void QFileContainer::setJournalCheckpointSize(unsigned long long newCheckpointSize) {
+    currentJournalCheckpointSize = newCheckpointSize;
+}
+
+
+unsigned long long QFileContainer::journalCheckpointSize() const {
+    return currentJournalCheckpointSize;
 }
 
 
-QFileContainer::DirectoryMap QFileContainer::directory() {
-    ::Container::Container::DirectoryMap directory = ::Container::Container::directory();
+QString QFileContainer::journalFilename(const QString& filename) {
+    return filename + QString("-journal");
+}
+
+
+bool QFileContainer::replayJournal(const QString& filename) {
+    bool success;
+
+    QFile journal(journalFilename(filename));
+    if (!journal.exists()) {
+        success = true;
+    } else if (!journal.open(QIODevice::ReadOnly)) {
+        success = false;
+    } else {
+        unsigned long long journalSize = static_cast<unsigned long long>(journal.size());
+
+        QFile file(filename);
+        success = journalSize == 0 || file.open(QIODevice::ReadWrite);
+
+        // Records are applied in order.  Replay stops at the first incomplete or damaged record, which can only be
+        // the record being appended when the process was interrupted.  Records are checked and copied in pieces so
+        // that a record never has to fit in memory.
+
+        unsigned long long recordOffset = 0;
+        bool               recordValid  = true;
+        while (success && recordValid && recordOffset + journalHeaderSize + 4 <= journalSize) {
+            char header[journalHeaderSize] = {};
+            recordValid = (
+                   journal.seek(static_cast<qint64>(recordOffset))
+                && journal.read(header, journalHeaderSize) == static_cast<qint64>(journalHeaderSize)
+            );
+
+            quint32            magic         = qFromLittleEndian<quint32>(header);
+            quint32            pageCount     = qFromLittleEndian<quint32>(header + 4);
+            unsigned long long truncatedSize = qFromLittleEndian<quint64>(header + 8);
+            unsigned long long containerSize = qFromLittleEndian<quint64>(header + 16);
+            unsigned long long recordSize    = qFromLittleEndian<quint64>(header + 24);
+
+            recordValid = (
+                   recordValid
+                && magic == journalRecordMagic
+                && recordSize >= journalHeaderSize + 4
+                && recordSize <= journalSize - recordOffset
+                && checkJournalRecord(journal, recordOffset, recordSize)
+            );
+
+            if (recordValid) {
+                if (static_cast<unsigned long long>(file.size()) > truncatedSize) {
+                    success = file.resize(static_cast<qint64>(truncatedSize));
+                }
 
-    ::Container::Container::DirectoryMap::iterator pos = directory.begin();
-    ::Container::Container::DirectoryMap::iterator end = directory.end();
-    while (pos != end) {
-        QString filename = QString::fromStdString(pos->first);
-        if (!directoryMap.contains(filename)) {
-            QVirtualFile* virtualFile = new QVirtualFile(pos->second, this);
-            directoryMap.insert(filename, QPointer<QVirtualFile>(virtualFile));
+                unsigned long long recordEnd  = recordOffset + recordSize - 4;
+                unsigned long long pageOffset = recordOffset + journalHeaderSize;
+                quint32            pageIndex  = 0;
+                while (success && recordValid && pageIndex < pageCount) {
+                    char pageHeader[journalPageHeaderSize] = {};
+                    recordValid = (
+                           pageOffset + journalPageHeaderSize <= recordEnd
+                        && journal.seek(static_cast<qint64>(pageOffset))
+                        && journal.read(pageHeader, journalPageHeaderSize) == static_cast<qint64>(journalPageHeaderSize)
+                    );
+
+                    if (recordValid) {
+                        unsigned long long offset = qFromLittleEndian<quint64>(pageHeader);
+                        quint32            length = qFromLittleEndian<quint32>(pageHeader + 8);
+
+                        pageOffset  += journalPageHeaderSize;
+                        recordValid  = (pageOffset + length <= recordEnd);
+
+                        if (recordValid) {
+                            success     = copyJournalData(journal, pageOffset, file, offset, length);
+                            pageOffset += length;
+                        }
+                    }
+
+                    ++pageIndex;
+                }
+
+                if (success && static_cast<unsigned long long>(file.size()) != containerSize) {
+                    success = file.resize(static_cast<qint64>(containerSize));
+                }
+
+                recordOffset += recordSize;
+            }
         }
 
-        ++pos;
+        journal.close();
+
+        if (success && file.isOpen()) {
+            int errorCode = 0;
+            success = syncDevice(&file, true, errorCode);
+            file.close();
+        }
+
+        if (success) {
+            success = QFile::remove(journalFilename(filename));
+        }
     }
 
-    QList<QString> keys = directoryMap.keys();
-    for (QList<QString>::const_iterator it=keys.begin() ; it!=keys.end() ; ++it) {
-        if (directory.find(it->toStdString()) == directory.end()) {
-            QVirtualFile* qvf = directoryMap.value(*it).data();
-            directoryMap.remove(*it);
-            delete qvf;
+    return success;
+}
+
+
+bool QFileContainer::writeJournal(
+        const PageImages&  pageImages,
+        unsigned long long truncatedSize,
+        unsigned long long containerSize,
+        bool&              durable
+    ) {
+    bool success;
+
+    if (journalFile == Q_NULLPTR) {
+        durable = false;
+        success = true;
+    } else {
+        unsigned long long recordSize = journalHeaderSize + 4;
+        for (PageImages::const_iterator it=pageImages.constBegin() ; it!=pageImages.constEnd() ; ++it) {
+            recordSize += journalPageHeaderSize + static_cast<unsigned long long>(it.value().size());
+        }
+
+        char header[journalHeaderSize] = {};
+        qToLittleEndian<quint32>(journalRecordMagic, header);
+        qToLittleEndian<quint32>(static_cast<quint32>(pageImages.size()), header + 4);
+        qToLittleEndian<quint64>(truncatedSize, header + 8);
+        qToLittleEndian<quint64>(containerSize, header + 16);
+        qToLittleEndian<quint64>(recordSize, header + 24);
+
+        // The record is written piece by piece, straight from the page images, so it is never assembled in memory.
+        // A partly written record is removed so that it can not hide records appended later.
+
+        qint64  journalEnd = journalFile->size();
+        quint32 checksum   = journalChecksum(header, journalHeaderSize);
+
+        success = (
+               journalFile->seek(journalEnd)
+            && journalFile->write(header, journalHeaderSize) == static_cast<qint64>(journalHeaderSize)
+        );
+
+        PageImages::const_iterator it = pageImages.constBegin();
+        while (success && it != pageImages.constEnd()) {
+            const QByteArray& page = it.value();
+
+            char pageHeader[journalPageHeaderSize] = {};
+            qToLittleEndian<quint64>(it.key(), pageHeader);
+            qToLittleEndian<quint32>(static_cast<quint32>(page.size()), pageHeader + 8);
+
+            checksum = journalChecksum(pageHeader, journalPageHeaderSize, checksum);
+            checksum = journalChecksum(page.constData(), static_cast<unsigned long long>(page.size()), checksum);
+
+            success = (
+                   journalFile->write(pageHeader, journalPageHeaderSize) == static_cast<qint64>(journalPageHeaderSize)
+                && journalFile->write(page) == static_cast<qint64>(page.size())
+            );
+
+            ++it;
+        }
+
+        char trailer[4];
+        qToLittleEndian<quint32>(checksum, trailer);
+
+        int errorCode = 0;
+        success = (
+               success
+            && journalFile->write(trailer, 4) == 4
+            && syncDevice(journalFile, true, errorCode)
+        );
+
+        if (!success) {
+            journalFile->resize(journalEnd);
+        }
+
+        durable = success;
+        if (success) {
+            journalPending = true;
         }
     }
 
-    return directoryMap;
+    return success;
 }
 
 
-QPointer<QVirtualFile> QFileContainer::newVirtualFile(const QString& newVirtualFileName) {
-    QPointer<QVirtualFile> virtualFile;
+bool QFileContainer::journalApplied() {
+    bool success;
 
-    std::shared_ptr<::Container::VirtualFile> vf;
-    vf = ::Container::Container::newVirtualFile(newVirtualFileName.toStdString());
+    bool checkpointNeeded = (
+           journalFile != Q_NULLPTR
+        && static_cast<unsigned long long>(journalFile->size()) >= currentJournalCheckpointSize
+    );
 
-    if (vf) {
-        virtualFile = QPointer<QVirtualFile>(new QVirtualFile(vf, this));
-        directoryMap.insert(newVirtualFileName, virtualFile);
+    if (checkpointNeeded) {
+        success = checkpointJournal();
+    } else {
+        success = true;
     }
 
-    return virtualFile;
+    return success;
 }
 
 
-QString QFileContainer::errorString() const {
-    return QString::fromStdString(lastStatus().description());
+bool QFileContainer::beginUnjournaledWrite() {
+    return !journalPending || checkpointJournal();
+}
+
+
+bool QFileContainer::journalActive() const {
+    return journalFile != Q_NULLPTR;
 }
 
 
-::Container::VirtualFile* QFileContainer::createFile(const std::string& virtualFileName) {
-    return ::Container::Container::createFile(virtualFileName);
+bool QFileContainer::checkpointJournal() {
+    int  errorCode = 0;
+    bool success   = syncDevice(currentFile, true, errorCode);
+
+    // The journal is only emptied once every page it holds is known to be on stable storage.
+
+    if (success && journalFile != Q_NULLPTR) {
+        success = journalFile->resize(0) && syncDevice(journalFile, true, errorCode);
+    }
+
+    if (success) {
+        journalPending = false;
+    }
+
+    return success;
+}
+
+
+quint32 QFileContainer::journalChecksum(const char* data, unsigned long long count, quint32 checksum) {
+    static const std::array<quint32, 256> table = []() {
+        std::array<quint32, 256> result;
+        for (quint32 i=0 ; i<256 ; ++i) {
+            quint32 value = i;
+            for (unsigned bit=0 ; bit<8 ; ++bit) {
+                value = (value & 1) ? (0xEDB88320U ^ (value >> 1)) : (value >> 1);
+            }
+
+            result[i] = value;
+        }
+
+        return result;
+    }();
+
+    quint32 crc = checksum ^ 0xFFFFFFFFU;
+    for (unsigned long long i=0 ; i<count ; ++i) {
+        crc = table[(crc ^ static_cast<quint8>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFFU;
+}
+
+
+bool QFileContainer::checkJournalRecord(
+        QFile&             journal,
+        unsigned long long recordOffset,
+        unsigned long long recordSize
+    ) {
+    unsigned long long chunkLimit = journalReplayChunkSize;
+    QByteArray         buffer(static_cast<int>(chunkLimit), Qt::Uninitialized);
+
+    unsigned long long remaining = recordSize - 4;
+    quint32            checksum  = 0;
+    bool               success   = journal.seek(static_cast<qint64>(recordOffset));
+    while (success && remaining > 0) {
+        qint64 chunkSize = static_cast<qint64>(qMin(remaining, chunkLimit));
+        success = (journal.read(buffer.data(), chunkSize) == chunkSize);
+        if (success) {
+            checksum   = journalChecksum(buffer.constData(), static_cast<unsigned long long>(chunkSize), checksum);
+            remaining -= static_cast<unsigned long long>(chunkSize);
+        }
+    }
+
+    char trailer[4];
+    return (
+           success
+        && journal.read(trailer, 4) == 4
+        && qFromLittleEndian<quint32>(trailer) == checksum
+    );
+}
+
+
+bool QFileContainer::copyJournalData(
+        QFile&             journal,
+        unsigned long long journalOffset,
+        QFile&             file,
+        unsigned long long fileOffset,
+        unsigned long long length
+    ) {
+    unsigned long long chunkLimit = journalReplayChunkSize;
+    QByteArray         buffer(static_cast<int>(qMin(length, chunkLimit)), Qt::Uninitialized);
+
+    bool success = (
+           journal.seek(static_cast<qint64>(journalOffset))
+        && file.seek(static_cast<qint64>(fileOffset))
+    );
+
+    unsigned long long remaining = length;
+    while (success && remaining > 0) {
+        qint64 chunkSize = static_cast<qint64>(qMin(remaining, chunkLimit));
+        success = (
+               journal.read(buffer.data(), chunkSize) == chunkSize
+            && file.write(buffer.constData(), chunkSize) == chunkSize
+        );
+
+        remaining -= static_cast<unsigned long long>(chunkSize);
+    }
+
+    return success;
 }
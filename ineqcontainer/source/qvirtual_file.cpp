@@ -21,9 +21,21 @@
 ***********************************************************************************************************************/
 
 #include <QMap>
+#include <QList>
 #include <QIODevice>
 #include <QObject>
 #include <QString>
+#include <QByteArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QMetaObject>
+#include <QFuture>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 #include <container_status.h>
 #include <container_virtual_file.h>
@@ -34,26 +46,66 @@
 
 QVirtualFile::QVirtualFile(
         std::shared_ptr<Container::VirtualFile> containerVirtualFile,
-        QObject*                                parent
+        const QString&                          name,
+        QContainer*                             container
     ):QIODevice(
-        parent
+        container
     ) {
-    currentVirtualFile = containerVirtualFile;
+    currentVirtualFile     = containerVirtualFile;
+    currentName            = name;
+    currentContainer       = container;
+    currentStagedWriteSize = 0;
+    stagedOffset           = 0;
+    stagedEnd              = 0;
+    commitFailed           = false;
+    stagedPosition         = 0;
+
+    readState.accessHint      = AccessHint::NORMAL;
+    readState.readAheadWindow = 0;
+    readState.lastReadEnd     = 0;
+    readState.advisedEnd      = 0;
 }
 
 
 QVirtualFile::~QVirtualFile() {}
 
 
+QString QVirtualFile::name() const {
+    return currentName;
+}
+
+
 bool QVirtualFile::erase() {
-    bool                success;
-    ::Container::Status status = currentVirtualFile->erase();
+    // Staged data and queued asynchronous operations must reach the engine, and the device must be closed, before
+    // the file is removed so nothing is written to the erased file afterwards.
 
-    if (status) {
-        setErrorString(QString::fromStdString(status.description()));
+    waitForCommit();
+    currentContainer->ioThreadPool->waitForDone();
+
+    if (isOpen()) {
+        close();
+    }
+
+    QMutexLocker locker(&currentContainer->ioMutex);
+
+    // A file being moved by compaction is first bound back to a single virtual file.
+
+    bool success;
+    if (currentName == currentContainer->compactionName && !currentContainer->settleCompaction()) {
+        setErrorString(QString("The file could not be released by compaction."));
         success = false;
     } else {
-        success = true;
+        ::Container::Status status = currentVirtualFile->erase();
+
+        if (status) {
+            setErrorString(QString::fromStdString(status.description()));
+            success = false;
+        } else {
+            currentContainer->removeFromDirectory(currentName);
+            deleteLater();
+
+            success = true;
+        }
     }
 
     return success;
@@ -61,23 +113,33 @@ bool QVirtualFile::erase() {
 
 
 bool QVirtualFile::atEnd() const {
+    QMutexLocker locker(&currentContainer->ioMutex);
     return currentVirtualFile->size() == currentVirtualFile->position();
 }
 
 
 qint64 QVirtualFile::bytesAvailable() const {
+    QMutexLocker locker(&currentContainer->ioMutex);
     return currentVirtualFile->size() - currentVirtualFile->position();
 }
 
 
 qint64 QVirtualFile::bytesToWrite() const {
-    return QIODevice::bytesToWrite() + currentVirtualFile->bytesInWriteCache();
+    QMutexLocker stagingLocker(&stagingMutex);
+    QMutexLocker locker(&currentContainer->ioMutex);
+
+    return QIODevice::bytesToWrite() + stagedData.size() + currentVirtualFile->bytesInWriteCache();
 }
 
 
 void QVirtualFile::close() {
+    if (!waitForCommit()) {
+        setErrorString(QString("Staged data could not be written."));
+    }
+
     QIODevice::close();
 
+    QMutexLocker        locker(&currentContainer->ioMutex);
     ::Container::Status status = currentVirtualFile->flush();
     if (status) {
         setErrorString(QString::fromStdString(status.description()));
@@ -91,9 +153,17 @@ bool QVirtualFile::isSequential() const {
 
 
 bool QVirtualFile::seek(qint64 pos) {
-    bool success = QIODevice::seek(pos);
+    // Staged data must be committed first as the commit restores the virtual file position.
+
+    bool success = waitForCommit();
+    if (!success) {
+        setErrorString(QString("Staged data could not be written."));
+    } else {
+        success = QIODevice::seek(pos);
+    }
 
     if (success) {
+        QMutexLocker        locker(&currentContainer->ioMutex);
         ::Container::Status status = currentVirtualFile->setPosition(pos);
 
         if (status) {
@@ -107,12 +177,21 @@ bool QVirtualFile::seek(qint64 pos) {
 
 
 qint64 QVirtualFile::size() const {
-    return currentVirtualFile->size();
+    QMutexLocker stagingLocker(&stagingMutex);
+    QMutexLocker locker(&currentContainer->ioMutex);
+
+    qint64 virtualFileSize = static_cast<qint64>(currentVirtualFile->size());
+    qint64 stagedSize      = stagedData.isEmpty() ? stagedEnd : qMax(stagedEnd, stagedOffset + stagedData.size());
+
+    return qMax(virtualFileSize, stagedSize);
 }
 
 
 QVirtualFile& QVirtualFile::operator=(const QVirtualFile& other) {
     currentVirtualFile = other.currentVirtualFile;
+    currentContainer   = other.currentContainer;
+    readState          = other.readState;
+
     return *this;
 }
 
@@ -122,11 +201,490 @@ std::shared_ptr<Container::VirtualFile> QVirtualFile::virtualFile() {
 }
 
 
+QByteArray QVirtualFile::view(qint64 offset, qint64 length) {
+    QByteArray result;
+
+    waitForCommit();
+
+    QMutexLocker locker(&currentContainer->ioMutex);
+
+    qint64 virtualFileSize = static_cast<qint64>(currentVirtualFile->size());
+    if (offset < 0 || length < 0 || offset > virtualFileSize) {
+        setErrorString(QString("Invalid view range."));
+    } else {
+        qint64 bytesToRead = qMin(length, virtualFileSize - offset);
+        if (bytesToRead > std::numeric_limits<int>::max()) {
+            setErrorString(QString("View range too large."));
+        } else if (bytesToRead == 0) {
+            result = QByteArray("");
+        } else {
+            bool                     mapped = (currentContainer->currentIoMode == QContainer::IoMode::MAPPED);
+            QContainer::MappedExtent extent = currentContainer->mappedExtents.value(currentName);
+            unsigned long long       start  = static_cast<unsigned long long>(offset);
+            unsigned long long       end    = start + static_cast<unsigned long long>(bytesToRead);
+
+            if (mapped && extent.length > 0 && start >= extent.fileOffset && end <= extent.fileOffset + extent.length) {
+                result = QByteArray::fromRawData(
+                    reinterpret_cast<const char*>(
+                        currentContainer->mappedData + extent.deviceOffset + (start - extent.fileOffset)
+                    ),
+                    static_cast<int>(bytesToRead)
+                );
+            } else {
+                unsigned long long  originalPosition = currentVirtualFile->position();
+                ::Container::Status status           = currentVirtualFile->setPosition(offset);
+
+                if (!status) {
+                    result.resize(static_cast<int>(bytesToRead));
+
+                    currentContainer->viewTracing    = mapped;
+                    currentContainer->viewTraceReads = 0;
+
+                    status = currentVirtualFile->read(reinterpret_cast<std::uint8_t*>(result.data()), bytesToRead);
+
+                    currentContainer->viewTracing = false;
+
+                    if (status.success()) {
+                        unsigned long long bytesRead = ::Container::ReadSuccessful(status).bytesRead();
+                        if (bytesRead < static_cast<unsigned long long>(bytesToRead)) {
+                            result.resize(static_cast<int>(bytesRead));
+                        }
+
+                        if (mapped) {
+                            result = mappedView(result, start);
+                        }
+
+                        status = currentVirtualFile->setPosition(originalPosition);
+                    } else {
+                        currentVirtualFile->setPosition(originalPosition);
+                    }
+                }
+
+                if (status) {
+                    setErrorString(QString::fromStdString(status.description()));
+                    result = QByteArray();
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+
+QByteArray QVirtualFile::mappedView(const QByteArray& data, unsigned long long offset) {
+    QByteArray result;
+
+    // The data is stored verbatim in the mapping if the engine filled the caller's buffer with a single device read
+    // and the bytes match the mapping at the traced offset.
+
+    const std::uint8_t* buffer       = reinterpret_cast<const std::uint8_t*>(data.constData());
+    unsigned long long  length       = static_cast<unsigned long long>(data.size());
+    unsigned long long  deviceOffset = currentContainer->viewTraceOffset;
+    const std::uint8_t* mapping      = currentContainer->mappedData + deviceOffset;
+
+    bool verbatim = (
+           currentContainer->viewTraceReads == 1
+        && currentContainer->viewTraceBuffer == buffer
+        && currentContainer->viewTraceCount == length
+        && deviceOffset + length <= currentContainer->trackedSize
+        && std::memcmp(mapping, buffer, static_cast<std::size_t>(length)) == 0
+    );
+
+    if (verbatim) {
+        QContainer::MappedExtent extent = currentContainer->mappedExtents.value(currentName);
+
+        // Extend the known range if the new range is adjacent to it in both the virtual file and the device.
+
+        bool adjacent = (
+               extent.length > 0
+            && deviceOffset + extent.fileOffset == extent.deviceOffset + offset
+            && offset <= extent.fileOffset + extent.length
+            && extent.fileOffset <= offset + length
+        );
+
+        if (adjacent) {
+            unsigned long long extentEnd = qMax(extent.fileOffset + extent.length, offset + length);
+
+            extent.deviceOffset = qMin(extent.deviceOffset, deviceOffset);
+            extent.fileOffset   = qMin(extent.fileOffset, offset);
+            extent.length       = extentEnd - extent.fileOffset;
+        } else {
+            extent.fileOffset   = offset;
+            extent.length       = length;
+            extent.deviceOffset = deviceOffset;
+        }
+
+        currentContainer->mappedExtents.insert(currentName, extent);
+
+        result = QByteArray::fromRawData(reinterpret_cast<const char*>(mapping), data.size());
+    } else {
+        result = data;
+    }
+
+    return result;
+}
+
+
+void QVirtualFile::setAccessHint(QVirtualFile::AccessHint hint) {
+    QMutexLocker locker(&currentContainer->ioMutex);
+
+    if (hint == AccessHint::WILL_NEED || hint == AccessHint::DONT_NEED) {
+        // One-shot hints are applied immediately.  The container engine does not expose where this file is stored
+        // so the hint covers the whole container.
+
+        currentContainer->adviseDevice(hint, 0, currentContainer->trackedSize);
+    } else {
+        readState.accessHint      = hint;
+        readState.readAheadWindow = 0;
+        readState.advisedEnd      = 0;
+    }
+}
+
+
+QVirtualFile::AccessHint QVirtualFile::accessHint() const {
+    return readState.accessHint;
+}
+
+
+QFuture<QByteArray> QVirtualFile::readAsync(qint64 offset, qint64 size) {
+    waitForCommit();
+
+    // The virtual file is looked up when the operation runs since the container may rebind the name in between.
+
+    QString                name       = currentName;
+    QContainer*            container  = currentContainer;
+    QPointer<QVirtualFile> self(this);
+    AccessHint             accessHint = readState.accessHint;
+
+    return QtConcurrent::run(container->ioThreadPool, [name, container, self, accessHint, offset, size]() {
+        QByteArray   result;
+        QMutexLocker locker(&container->ioMutex);
+
+        std::shared_ptr<Container::VirtualFile> virtualFile = container->directoryIndex.value(name).virtualFile;
+
+        if (virtualFile && offset >= 0 && size >= 0 && size <= std::numeric_limits<int>::max()) {
+            unsigned long long  originalPosition = virtualFile->position();
+            ::Container::Status status           = virtualFile->setPosition(offset);
+
+            if (!status) {
+                QByteArray data(static_cast<int>(size), Qt::Uninitialized);
+                ReadState  asyncReadState = { accessHint, 0, 0, 0 };
+
+                status = container->readWithState(
+                    *virtualFile,
+                    reinterpret_cast<std::uint8_t*>(data.data()),
+                    static_cast<unsigned long long>(size),
+                    asyncReadState
+                );
+
+                if (status.success()) {
+                    data.resize(static_cast<int>(::Container::ReadSuccessful(status).bytesRead()));
+                    result = data;
+                }
+
+                virtualFile->setPosition(originalPosition);
+            }
+        }
+
+        locker.unlock();
+
+        if (!result.isNull()) {
+            QMetaObject::invokeMethod(
+                container,
+                [self]() {
+                    if (!self.isNull()) {
+                        emit self->readyRead();
+                    }
+                },
+                Qt::QueuedConnection
+            );
+        }
+
+        return result;
+    });
+}
+
+
+QFuture<qint64> QVirtualFile::writeAsync(qint64 offset, const QByteArray& data) {
+    waitForCommit();
+
+    QString                name      = currentName;
+    QContainer*            container = currentContainer;
+    QPointer<QVirtualFile> self(this);
+
+    return QtConcurrent::run(container->ioThreadPool, [name, container, self, offset, data]() {
+        qint64       bytesWritten = -1;
+        QMutexLocker locker(&container->ioMutex);
+
+        std::shared_ptr<Container::VirtualFile> virtualFile = container->directoryIndex.value(name).virtualFile;
+
+        if (virtualFile && offset >= 0) {
+            unsigned long long  originalPosition = virtualFile->position();
+            ::Container::Status status           = virtualFile->setPosition(offset);
+
+            if (!status) {
+                status = virtualFile->write(reinterpret_cast<const std::uint8_t*>(data.constData()), data.size());
+
+                if (status.success()) {
+                    bytesWritten = static_cast<qint64>(::Container::WriteSuccessful(status).bytesWritten());
+                    container->virtualFileWritten(name);
+                }
+
+                virtualFile->setPosition(originalPosition);
+            }
+        }
+
+        locker.unlock();
+
+        if (bytesWritten >= 0) {
+            QMetaObject::invokeMethod(
+                container,
+                [self, bytesWritten]() {
+                    if (!self.isNull()) {
+                        emit self->bytesWritten(bytesWritten);
+                    }
+                },
+                Qt::QueuedConnection
+            );
+        }
+
+        return bytesWritten;
+    });
+}
+
+
+QFuture<bool> QVirtualFile::flushAsync() {
+    waitForCommit();
+
+    QString     name      = currentName;
+    QContainer* container = currentContainer;
+
+    return QtConcurrent::run(container->ioThreadPool, [name, container]() {
+        QMutexLocker locker(&container->ioMutex);
+
+        std::shared_ptr<Container::VirtualFile> virtualFile = container->directoryIndex.value(name).virtualFile;
+        return virtualFile && !virtualFile->flush();
+    });
+}
+
+
+void QVirtualFile::setStagedWriteSize(qint64 newStagedWriteSize) {
+    if (newStagedWriteSize <= 0) {
+        waitForCommit();
+    }
+
+    QMutexLocker stagingLocker(&stagingMutex);
+    currentStagedWriteSize = qMax(newStagedWriteSize, static_cast<qint64>(0));
+}
+
+
+qint64 QVirtualFile::stagedWriteSize() const {
+    QMutexLocker stagingLocker(&stagingMutex);
+    return currentStagedWriteSize;
+}
+
+
+bool QVirtualFile::waitForCommit() {
+    // The staging lock is held while waiting.  Commits only take the container lock so they can complete.
+
+    QMutexLocker stagingLocker(&stagingMutex);
+    bool         success;
+
+    if (!stagedData.isEmpty()) {
+        submitStagedData();
+    }
+
+    if (pendingCommits.isEmpty()) {
+        success = !commitFailed;
+    } else {
+        for (QList<QFuture<qint64>>::iterator it=pendingCommits.begin() ; it!=pendingCommits.end() ; ++it) {
+            if (it->result() < 0) {
+                commitFailed = true;
+            }
+        }
+
+        pendingCommits.clear();
+
+        // Staged commits do not move the virtual file position so we re-synchronize it with this device.
+
+        QMutexLocker locker(&currentContainer->ioMutex);
+        currentVirtualFile->setPosition(static_cast<unsigned long long>(stagedPosition));
+
+        success = !commitFailed;
+    }
+
+    commitFailed = false;
+    return success;
+}
+
+
+qint64 QVirtualFile::readv(const QList<ReadVector>& vectors) {
+    waitForCommit();
+
+    QList<ReadVector> sorted = vectors;
+    std::stable_sort(
+        sorted.begin(),
+        sorted.end(),
+        [](const ReadVector& a, const ReadVector& b) {
+            return a.offset < b.offset;
+        }
+    );
+
+    QMutexLocker        locker(&currentContainer->ioMutex);
+    qint64              totalBytesRead   = 0;
+    unsigned long long  originalPosition = currentVirtualFile->position();
+    unsigned long long  virtualFileSize  = currentVirtualFile->size();
+    unsigned long long  currentPosition  = originalPosition;
+    ::Container::Status status;
+
+    QList<ReadVector>::const_iterator it  = sorted.constBegin();
+    QList<ReadVector>::const_iterator end = sorted.constEnd();
+    while (!status && it != end) {
+        if (it->offset < 0 || it->size < 0) {
+            status = ::Container::SeekError(static_cast<unsigned long long>(it->offset), virtualFileSize);
+        } else if (it->size > 0 && static_cast<unsigned long long>(it->offset) < virtualFileSize) {
+            if (static_cast<unsigned long long>(it->offset) != currentPosition) {
+                status = currentVirtualFile->setPosition(it->offset);
+            }
+
+            if (!status) {
+                status = currentContainer->readWithState(
+                    *currentVirtualFile,
+                    reinterpret_cast<std::uint8_t*>(it->data),
+                    static_cast<unsigned long long>(it->size),
+                    readState
+                );
+
+                if (status.success()) {
+                    unsigned long long bytesRead = ::Container::ReadSuccessful(status).bytesRead();
+                    totalBytesRead  += bytesRead;
+                    currentPosition  = it->offset + bytesRead;
+                    status           = ::Container::NoStatus();
+                }
+            }
+        }
+
+        ++it;
+    }
+
+    if (currentPosition != originalPosition) {
+        ::Container::Status restoreStatus = currentVirtualFile->setPosition(originalPosition);
+        if (!status) {
+            status = restoreStatus;
+        }
+    }
+
+    if (status) {
+        setErrorString(QString::fromStdString(status.description()));
+        totalBytesRead = -1;
+    }
+
+    return totalBytesRead;
+}
+
+
+qint64 QVirtualFile::writev(const QList<WriteVector>& vectors) {
+    // Staged data must reach the container first or it would later overwrite these ranges.  Commits take the
+    // container lock so we must wait before taking it.
+
+    waitForCommit();
+
+    QList<WriteVector> sorted = vectors;
+    std::stable_sort(
+        sorted.begin(),
+        sorted.end(),
+        [](const WriteVector& a, const WriteVector& b) {
+            return a.offset < b.offset;
+        }
+    );
+
+    QMutexLocker        locker(&currentContainer->ioMutex);
+    qint64              totalBytesWritten = 0;
+    unsigned long long  originalPosition  = currentVirtualFile->position();
+    unsigned long long  currentPosition   = originalPosition;
+    ::Container::Status status;
+
+    QList<WriteVector>::const_iterator it  = sorted.constBegin();
+    QList<WriteVector>::const_iterator end = sorted.constEnd();
+    while (!status && it != end) {
+        if (it->offset < 0 || it->size < 0) {
+            status = ::Container::SeekError(static_cast<unsigned long long>(it->offset), currentVirtualFile->size());
+        } else if (it->size > 0) {
+            if (static_cast<unsigned long long>(it->offset) != currentPosition) {
+                status = currentVirtualFile->setPosition(it->offset);
+            }
+
+            if (!status) {
+                status = currentVirtualFile->write(reinterpret_cast<const std::uint8_t*>(it->data), it->size);
+
+                if (status.success()) {
+                    unsigned long long bytesWritten = ::Container::WriteSuccessful(status).bytesWritten();
+                    totalBytesWritten += bytesWritten;
+                    currentPosition    = it->offset + bytesWritten;
+                    status             = ::Container::NoStatus();
+                }
+            }
+        }
+
+        ++it;
+    }
+
+    if (currentPosition != originalPosition) {
+        ::Container::Status restoreStatus = currentVirtualFile->setPosition(originalPosition);
+        if (!status) {
+            status = restoreStatus;
+        }
+    }
+
+    if (totalBytesWritten > 0) {
+        currentContainer->virtualFileWritten(currentName);
+    }
+
+    if (status) {
+        setErrorString(QString::fromStdString(status.description()));
+        totalBytesWritten = -1;
+    }
+
+    return totalBytesWritten;
+}
+
+
+void QVirtualFile::submitStagedData() {
+    QList<QFuture<qint64>>::iterator it = pendingCommits.begin();
+    while (it != pendingCommits.end()) {
+        if (it->isFinished()) {
+            if (it->result() < 0) {
+                commitFailed = true;
+            }
+
+            it = pendingCommits.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    pendingCommits.append(writeAsync(stagedOffset, stagedData));
+
+    stagedEnd = qMax(stagedEnd, stagedOffset + stagedData.size());
+    stagedData.clear();
+}
+
+
 qint64 QVirtualFile::readData(char* data, qint64 maxSize) {
+    waitForCommit();
+
     qint64 bytesRead;
 
     if (maxSize > 0) {
-        ::Container::Status status = currentVirtualFile->read(reinterpret_cast<std::uint8_t*>(data), maxSize);
+        QMutexLocker locker(&currentContainer->ioMutex);
+
+        ::Container::Status status = currentContainer->readWithState(
+            *currentVirtualFile,
+            reinterpret_cast<std::uint8_t*>(data),
+            static_cast<unsigned long long>(maxSize),
+            readState
+        );
 
         if (status.success()) {
             bytesRead = ::Container::ReadSuccessful(status).bytesRead();
@@ -143,13 +701,40 @@ qint64 QVirtualFile::readData(char* data, qint64 maxSize) {
 
 
 qint64 QVirtualFile::writeData(const char* data, qint64 maxSize) {
-    qint64 bytesWritten;
+    QMutexLocker stagingLocker(&stagingMutex);
+    qint64       bytesWritten;
 
-    if (maxSize > 0) {
+    if (currentStagedWriteSize > 0 && maxSize > 0) {
+        qint64 offset = pos();
+
+        if (!stagedData.isEmpty() && offset != stagedOffset + stagedData.size()) {
+            submitStagedData();
+        }
+
+        if (commitFailed) {
+            setErrorString(QString("Staged data could not be written."));
+            bytesWritten = -1;
+        } else {
+            if (stagedData.isEmpty()) {
+                stagedOffset = offset;
+            }
+
+            stagedData.append(data, static_cast<int>(maxSize));
+            stagedPosition = offset + maxSize;
+
+            if (stagedData.size() >= currentStagedWriteSize) {
+                submitStagedData();
+            }
+
+            bytesWritten = maxSize;
+        }
+    } else if (maxSize > 0) {
+        QMutexLocker        locker(&currentContainer->ioMutex);
         ::Container::Status status = currentVirtualFile->write(reinterpret_cast<const std::uint8_t*>(data), maxSize);
 
         if (status.success()) {
             bytesWritten = ::Container::WriteSuccessful(status).bytesWritten();
+            currentContainer->virtualFileWritten(currentName);
         } else {
             setErrorString(QString::fromStdString(status.description()));
             bytesWritten = -1;
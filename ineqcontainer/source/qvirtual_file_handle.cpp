@@ -0,0 +1,188 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements the \ref QVirtualFileHandle class.
+***********************************************************************************************************************/
+
+#include <QString>
+#include <QPointer>
+#include <QIODevice>
+#include <QMutexLocker>
+
+#include "qcontainer.h"
+#include "qvirtual_file.h"
+#include "qvirtual_file_handle.h"
+
+QVirtualFileHandle::QVirtualFileHandle() {
+    currentContainer = Q_NULLPTR;
+}
+
+
+QVirtualFileHandle::QVirtualFileHandle(QContainer* container, const QString& name) {
+    currentContainer = container;
+    currentName      = name;
+}
+
+
+QVirtualFileHandle::QVirtualFileHandle(const QVirtualFileHandle& other) {
+    currentContainer = other.currentContainer;
+    currentName      = other.currentName;
+}
+
+
+QVirtualFileHandle::~QVirtualFileHandle() {}
+
+
+bool QVirtualFileHandle::isValid() const {
+    bool result;
+
+    if (currentContainer == Q_NULLPTR) {
+        result = false;
+    } else {
+        QMutexLocker locker(&currentContainer->ioMutex);
+        result = currentContainer->directoryIndex.contains(currentName);
+    }
+
+    return result;
+}
+
+
+QString QVirtualFileHandle::name() const {
+    return currentName;
+}
+
+
+QContainer* QVirtualFileHandle::container() const {
+    return currentContainer;
+}
+
+
+qint64 QVirtualFileHandle::size() const {
+    qint64 result;
+
+    if (currentContainer == Q_NULLPTR) {
+        result = -1;
+    } else {
+        QMutexLocker locker(&currentContainer->ioMutex);
+
+        QContainer::DirectoryIndex::const_iterator it = currentContainer->directoryIndex.constFind(currentName);
+        if (it == currentContainer->directoryIndex.constEnd()) {
+            result = -1;
+        } else {
+            result = static_cast<qint64>(it->virtualFile->size());
+        }
+    }
+
+    return result;
+}
+
+
+QPointer<QVirtualFile> QVirtualFileHandle::virtualFile() const {
+    QPointer<QVirtualFile> result;
+
+    if (currentContainer != Q_NULLPTR) {
+        QMutexLocker locker(&currentContainer->ioMutex);
+        result = currentContainer->materialize(currentName);
+    }
+
+    return result;
+}
+
+
+QPointer<QVirtualFile> QVirtualFileHandle::open(QIODevice::OpenMode mode) const {
+    QPointer<QVirtualFile> result = virtualFile();
+
+    if (!result.isNull() && !result->isOpen() && !result->open(mode)) {
+        result = QPointer<QVirtualFile>();
+    }
+
+    return result;
+}
+
+
+bool QVirtualFileHandle::erase() const {
+    bool success;
+
+    if (currentContainer == Q_NULLPTR) {
+        success = false;
+    } else {
+        QPointer<QVirtualFile> device;
+        bool                   found;
+
+        {
+            QMutexLocker locker(&currentContainer->ioMutex);
+
+            QContainer::DirectoryIndex::const_iterator it = currentContainer->directoryIndex.constFind(currentName);
+            found = (it != currentContainer->directoryIndex.constEnd());
+            if (found) {
+                device = it->device;
+            }
+        }
+
+        if (!found) {
+            success = false;
+        } else if (!device.isNull()) {
+            // An existing device may hold staged data and queued operations so we let the device erase the file.
+
+            success = device->erase();
+        } else {
+            currentContainer->ioThreadPool->waitForDone();
+
+            QMutexLocker locker(&currentContainer->ioMutex);
+
+            // A file being moved by compaction is first bound back to a single virtual file.
+
+            bool settled = currentName != currentContainer->compactionName || currentContainer->settleCompaction();
+
+            QContainer::DirectoryIndex::const_iterator it = currentContainer->directoryIndex.constFind(currentName);
+            if (!settled || it == currentContainer->directoryIndex.constEnd()) {
+                success = false;
+            } else {
+                ::Container::Status status = it->virtualFile->erase();
+
+                if (status) {
+                    success = false;
+                } else {
+                    currentContainer->removeFromDirectory(currentName);
+                    success = true;
+                }
+            }
+        }
+    }
+
+    return success;
+}
+
+
+QVirtualFileHandle& QVirtualFileHandle::operator=(const QVirtualFileHandle& other) {
+    currentContainer = other.currentContainer;
+    currentName      = other.currentName;
+
+    return *this;
+}
+
+
+bool QVirtualFileHandle::operator==(const QVirtualFileHandle& other) const {
+    return currentContainer == other.currentContainer && currentName == other.currentName;
+}
+
+
+bool QVirtualFileHandle::operator!=(const QVirtualFileHandle& other) const {
+    return !operator==(other);
+}
@@ -0,0 +1,218 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This file is the main entry point for the ineqcontainer command line tool.
+***********************************************************************************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+#include <cstdio>
+
+#include <qfile_container.h>
+#include <qcontainer_importer.h>
+#include <qcontainer_extractor.h>
+
+/**
+ * The file identifier used when none is specified on the command line.
+ */
+static const char defaultFileIdentifier[] = "ineqcontainer";
+
+/**
+ * Function that packs a directory tree into a container.
+ *
+ * \param[in] arguments      The positional arguments following the command.
+ *
+ * \param[in] fileIdentifier The file identifier stored in the container.
+ *
+ * \param[in] compress       If true, files are compressed as they are packed.
+ *
+ * \param[in] threadCount    The number of worker threads.  A value of zero selects the ideal thread count.
+ *
+ * \param[in] prefix         A prefix added to the name of every packed file.
+ *
+ * \return Returns the process exit status.
+ */
+static int pack(
+        const QStringList& arguments,
+        const QString&     fileIdentifier,
+        bool               compress,
+        unsigned           threadCount,
+        const QString&     prefix
+    ) {
+    int         exitStatus;
+    QTextStream errorStream(stderr);
+
+    if (arguments.size() != 2) {
+        errorStream << "usage: ineqcontainer_tool pack <container> <directory>\n";
+        exitStatus = 1;
+    } else {
+        QFileContainer container(fileIdentifier);
+        if (!container.open(arguments.at(0), QFileContainer::OpenMode::READ_WRITE)) {
+            errorStream << "Could not open " << arguments.at(0) << ": " << container.errorString() << "\n";
+            exitStatus = 1;
+        } else {
+            QContainerImporter importer(&container);
+            importer.setCompressionEnabled(compress);
+            importer.setThreadCount(threadCount);
+
+            bool imported = importer.importDirectory(arguments.at(1), prefix);
+            if (!imported) {
+                errorStream << importer.errorString() << "\n";
+            }
+
+            bool closed = container.close();
+            if (!closed) {
+                errorStream << "Could not close " << arguments.at(0) << "\n";
+            }
+
+            QTextStream outputStream(stdout);
+            outputStream << "Packed " << static_cast<qint64>(importer.filesImported()) << " files, "
+                         << static_cast<qint64>(importer.bytesImported()) << " bytes\n";
+
+            exitStatus = (imported && closed) ? 0 : 1;
+        }
+    }
+
+    return exitStatus;
+}
+
+
+/**
+ * Function that unpacks a container into a directory tree.
+ *
+ * \param[in] arguments      The positional arguments following the command.
+ *
+ * \param[in] fileIdentifier The file identifier stored in the container.
+ *
+ * \param[in] threadCount    The number of worker threads.  A value of zero selects the ideal thread count.
+ *
+ * \param[in] prefix         Only files whose names start with this prefix are unpacked.  The prefix is removed from
+ *                           the output file names.
+ *
+ * \return Returns the process exit status.
+ */
+static int unpack(
+        const QStringList& arguments,
+        const QString&     fileIdentifier,
+        unsigned           threadCount,
+        const QString&     prefix
+    ) {
+    int         exitStatus;
+    QTextStream errorStream(stderr);
+
+    if (arguments.size() != 2) {
+        errorStream << "usage: ineqcontainer_tool unpack <container> <directory>\n";
+        exitStatus = 1;
+    } else {
+        QFileContainer container(fileIdentifier);
+        if (!container.open(arguments.at(0), QFileContainer::OpenMode::READ_ONLY)) {
+            errorStream << "Could not open " << arguments.at(0) << ": " << container.errorString() << "\n";
+            exitStatus = 1;
+        } else {
+            QContainerExtractor extractor(&container);
+            extractor.setThreadCount(threadCount);
+
+            bool extracted = extractor.extractDirectory(arguments.at(1), prefix);
+            if (!extracted) {
+                errorStream << extractor.errorString() << "\n";
+            }
+
+            container.close();
+
+            QTextStream outputStream(stdout);
+            outputStream << "Unpacked " << static_cast<qint64>(extractor.filesExtracted()) << " files, "
+                         << static_cast<qint64>(extractor.bytesExtracted()) << " bytes\n";
+
+            exitStatus = extracted ? 0 : 1;
+        }
+    }
+
+    return exitStatus;
+}
+
+
+int main(int argumentCount, char* argumentValues[]) {
+    QCoreApplication application(argumentCount, argumentValues);
+    QCoreApplication::setApplicationName("ineqcontainer_tool");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Packs directory trees into, and unpacks them from, ineqcontainer containers.");
+    parser.addHelpOption();
+
+    QCommandLineOption identifierOption(
+        QStringList() << "i" << "identifier",
+        "File identifier stored in the container.",
+        "identifier",
+        QString(defaultFileIdentifier)
+    );
+    QCommandLineOption compressOption(
+        QStringList() << "c" << "compress",
+        "Compress files as they are packed.  Compressed files are decompressed automatically when unpacked."
+    );
+    QCommandLineOption threadsOption(
+        QStringList() << "t" << "threads",
+        "Number of worker threads.  Defaults to the ideal thread count.",
+        "count",
+        QString("0")
+    );
+    QCommandLineOption prefixOption(
+        QStringList() << "p" << "prefix",
+        "Prefix added to the name of every packed file, or required of every unpacked file.",
+        "prefix"
+    );
+
+    parser.addOption(identifierOption);
+    parser.addOption(compressOption);
+    parser.addOption(threadsOption);
+    parser.addOption(prefixOption);
+    parser.addPositionalArgument("command", "The command to run: pack or unpack.");
+
+    parser.process(application);
+
+    QStringList arguments = parser.positionalArguments();
+    QString     command   = arguments.isEmpty() ? QString() : arguments.takeFirst();
+
+    int exitStatus;
+    if (command == QString("pack")) {
+        exitStatus = pack(
+            arguments,
+            parser.value(identifierOption),
+            parser.isSet(compressOption),
+            parser.value(threadsOption).toUInt(),
+            parser.value(prefixOption)
+        );
+    } else if (command == QString("unpack")) {
+        exitStatus = unpack(
+            arguments,
+            parser.value(identifierOption),
+            parser.value(threadsOption).toUInt(),
+            parser.value(prefixOption)
+        );
+    } else {
+        parser.showHelp(1);
+        exitStatus = 1;
+    }
+
+    return exitStatus;
+}
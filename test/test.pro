@@ -21,14 +21,18 @@
 #
 
 TEMPLATE = app
-QT += core testlib
+QT += core concurrent testlib
 CONFIG += testcase c++14
 
-HEADERS = test_qcontainer.h \
+HEADERS = test_qarena_device.h \
+          test_qcontainer.h \
+          test_qcontainer_block_cache.h \
           test_qfile_container.h
 
 SOURCES = test_ineqcontainer.cpp \
+          test_qarena_device.cpp \
           test_qcontainer.cpp \
+          test_qcontainer_block_cache.cpp \
           test_qfile_container.cpp
 
 ########################################################################################################################
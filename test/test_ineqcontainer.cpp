@@ -22,7 +22,9 @@
 
 #include <QtTest/QtTest>
 
+#include "test_qarena_device.h"
 #include "test_qcontainer.h"
+#include "test_qcontainer_block_cache.h"
 #include "test_qfile_container.h"
 
 #define TEST(_X) do {                                                  \
@@ -33,7 +35,9 @@
 int main(int argumentCount, char** argumentValues) {
     int testStatus = 0;
 
+    TEST(TestQArenaDevice);
     TEST(TestQContainer);
+    TEST(TestQContainerBlockCache);
     TEST(TestQFileContainer);
 
     return testStatus;
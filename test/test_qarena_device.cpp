@@ -0,0 +1,130 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests of the QArenaDevice class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QtTest/QtTest>
+#include <QIODevice>
+#include <QBuffer>
+#include <QByteArray>
+#include <QPointer>
+
+#include <qarena_device.h>
+#include <qcontainer.h>
+#include <qvirtual_file.h>
+
+#include "test_qarena_device.h"
+
+/***********************************************************************************************************************
+ * TestQArenaDevice
+ */
+
+void TestQArenaDevice::testReadWriteAndResize() {
+    QArenaDevice arena(chunkSize);
+    QVERIFY(arena.open(QIODevice::ReadWrite));
+
+    // Write spanning several chunks, starting past the end of the device.
+
+    QByteArray data(3 * chunkSize, 'x');
+    QVERIFY(arena.writeAt(chunkSize / 2, data.constData(), data.size()) == data.size());
+    QVERIFY(arena.size() == chunkSize / 2 + data.size());
+
+    QByteArray contents = arena.toByteArray();
+    QVERIFY(contents.left(chunkSize / 2) == QByteArray(chunkSize / 2, '\0'));
+    QVERIFY(contents.mid(chunkSize / 2) == data);
+
+    // Shrinking and then growing the device must not expose stale data.
+
+    QVERIFY(arena.resize(chunkSize));
+    QVERIFY(arena.size() == chunkSize);
+    QVERIFY(arena.resize(2 * chunkSize));
+
+    contents = arena.toByteArray();
+    QVERIFY(contents.mid(chunkSize / 2, chunkSize / 2) == QByteArray(chunkSize / 2, 'x'));
+    QVERIFY(contents.mid(chunkSize) == QByteArray(chunkSize, '\0'));
+
+    // Reads through the QIODevice interface track the device position.
+
+    QVERIFY(arena.seek(chunkSize / 2));
+    QVERIFY(arena.read(4) == QByteArray(4, 'x'));
+    QVERIFY(arena.pos() == chunkSize / 2 + 4);
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(arena.writeTo(&buffer) == 2 * chunkSize);
+    QVERIFY(buffer.data() == contents);
+
+    QVERIFY(!arena.resize(-1));
+}
+
+
+void TestQArenaDevice::testContainerOverArena() {
+    QArenaDevice* arena = new QArenaDevice;
+    arena->open(QIODevice::ReadWrite);
+
+    QContainer container(QString("Inesonic, LLC.\nAion Test"));
+    container.setDevice(arena);
+    container.setParent(Q_NULLPTR);
+
+    QVERIFY(container.open());
+
+    QByteArray payload(totalBytesAcrossFiles, '\0');
+    for (unsigned i=0 ; i<totalBytesAcrossFiles ; ++i) {
+        payload[i] = static_cast<char>(i % 251);
+    }
+
+    QPointer<QVirtualFile> vf = container.newVirtualFile(QString("payload.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::ReadWrite);
+    QVERIFY(vf->write(payload) == payload.size());
+    vf->close();
+
+    QVERIFY(container.close());
+
+    // Serialize the arena and confirm the result can be read back as a container.
+
+    QBuffer serialized;
+    serialized.open(QIODevice::WriteOnly);
+    QVERIFY(arena->writeTo(&serialized) == arena->size());
+    serialized.close();
+    serialized.open(QIODevice::ReadOnly);
+
+    QContainer readContainer(QString("Inesonic, LLC.\nAion Test"));
+    readContainer.setDevice(&serialized);
+    readContainer.setParent(Q_NULLPTR);
+
+    QVERIFY(readContainer.open());
+
+    QContainer::DirectoryMap directory = readContainer.directory();
+    QVERIFY(directory.size() == 1);
+
+    QPointer<QVirtualFile> readVf = directory.value(QString("payload.dat"));
+    QVERIFY(!readVf.isNull());
+
+    readVf->open(QIODevice::ReadOnly);
+    QVERIFY(readVf->readAll() == payload);
+    readVf->close();
+
+    QVERIFY(readContainer.close());
+
+    delete arena;
+}
@@ -24,16 +24,128 @@
 #include <QtTest/QtTest>
 #include <QIODevice>
 #include <QFile>
+#include <QFileInfo>
+#include <QBuffer>
 #include <QPointer>
+#include <QByteArray>
 
 #include <cstring>
 #include <random>
 
 #include <qcontainer.h>
+#include <qarena_device.h>
 #include <qvirtual_file.h>
+#include <qvirtual_file_handle.h>
 
 #include "test_qcontainer.h"
 
+/***********************************************************************************************************************
+ * SequentialDevice
+ */
+
+/**
+ * Minimal sequential device used to model pipes and sockets.  Written data is appended to a queue and reads consume
+ * data from the front of the queue.
+ */
+class SequentialDevice:public QIODevice {
+    public:
+        SequentialDevice() {}
+
+        ~SequentialDevice() override {}
+
+        bool isSequential() const override {
+            return true;
+        }
+
+        qint64 bytesAvailable() const override {
+            return queue.size() + QIODevice::bytesAvailable();
+        }
+
+    protected:
+        qint64 readData(char* data, qint64 maxSize) override {
+            qint64 count = qMin(maxSize, static_cast<qint64>(queue.size()));
+            std::memcpy(data, queue.constData(), static_cast<std::size_t>(count));
+            queue.remove(0, static_cast<int>(count));
+
+            return count;
+        }
+
+        qint64 writeData(const char* data, qint64 size) override {
+            queue.append(data, static_cast<int>(size));
+            return size;
+        }
+
+    private:
+        QByteArray queue;
+};
+
+/***********************************************************************************************************************
+ * RawContainer
+ */
+
+/**
+ * Container that exposes the device access methods used by the container engine so tests can exercise them directly.
+ * Raw data is only written past the end of the container and is truncated away before the container is closed.
+ */
+class RawContainer:public QContainer {
+    public:
+        RawContainer(QIODevice* device):QContainer(device, QString("Inesonic, LLC.\nAion Test")) {}
+
+        ~RawContainer() override {}
+
+        using QContainer::size;
+        using QContainer::position;
+        using QContainer::setPosition;
+        using QContainer::setPositionLast;
+        using QContainer::read;
+        using QContainer::write;
+        using QContainer::supportsTruncation;
+        using QContainer::truncate;
+        using QContainer::flush;
+
+        /**
+         * Method that writes data at an offset.
+         *
+         * \param[in] offset The device offset to write at.
+         *
+         * \param[in] data   The data to be written.
+         *
+         * \return Returns true on success, returns false on error.
+         */
+        bool writeAt(unsigned long long offset, const QByteArray& data) {
+            return (
+                   !setPosition(offset)
+                && write(reinterpret_cast<const std::uint8_t*>(data.constData()), data.size()).success()
+            );
+        }
+
+        /**
+         * Method that reads data at an offset.
+         *
+         * \param[in] offset The device offset to read from.
+         *
+         * \param[in] count  The number of bytes to read.
+         *
+         * \return Returns the data read.  A null byte array is returned on error.
+         */
+        QByteArray readAt(unsigned long long offset, unsigned count) {
+            QByteArray result(static_cast<int>(count), Qt::Uninitialized);
+
+            ::Container::Status status = setPosition(offset);
+            if (!status) {
+                status = read(reinterpret_cast<std::uint8_t*>(result.data()), count);
+            }
+
+            if (status.success()) {
+                result.resize(static_cast<int>(::Container::ReadSuccessful(status).bytesRead()));
+            } else {
+                result = QByteArray();
+            }
+
+            return result;
+        }
+};
+
 /***********************************************************************************************************************
  * TestQContainer
  */
@@ -62,6 +174,23 @@ void TestQContainer::testQContainerApi() {
     qint64 bytesWritten = vf->write(buffer, bufferSizeInBytes);
     QVERIFY(bytesWritten == bufferSizeInBytes);
 
+    // Erased files are removed from the directory immediately.
+
+    QPointer<QVirtualFile> erasedVf = writeContainer.newVirtualFile(QString("erased.dat"));
+    QVERIFY(!erasedVf.isNull());
+    QVERIFY(writeContainer.directory().size() == 2);
+    QVERIFY(writeContainer.virtualFile(QString("erased.dat")) == erasedVf);
+
+    // Erasing an open file with queued writes commits the writes and closes the device first.
+
+    erasedVf->open(QIODevice::ReadWrite);
+    erasedVf->writeAsync(0, QByteArray(buffer, 4096));
+
+    QVERIFY(erasedVf->erase());
+    QVERIFY(!erasedVf->isOpen());
+    QVERIFY(writeContainer.directory().size() == 1);
+    QVERIFY(writeContainer.virtualFile(QString("erased.dat")).isNull());
+
     success = writeContainer.close();
     QVERIFY(success);
 
@@ -77,11 +206,28 @@ void TestQContainer::testQContainerApi() {
     success = readContainer.open();
     QVERIFY(success);
 
+    // Handles are available without creating virtual file devices.
+
+    QContainer::HandleMap handles = readContainer.handles();
+    QVERIFY(handles.size() == 1);
+
+    QVirtualFileHandle handle = handles.value(QString("test.dat"));
+    QVERIFY(handle.isValid());
+    QVERIFY(handle.size() == bufferSizeInBytes);
+    QVERIFY(!readContainer.handle(QString("missing.dat")).isValid());
+
+    QVERIFY(readContainer.listPrefix(QString("test")).size() == 1);
+    QVERIFY(readContainer.listPrefix(QString("textures/")).isEmpty());
+    QVERIFY(readContainer.glob(QString("*.dat")).contains(QString("test.dat")));
+    QVERIFY(readContainer.glob(QString("t?st.*")).size() == 1);
+    QVERIFY(readContainer.glob(QString("*.bin")).isEmpty());
+
     QContainer::DirectoryMap directory = readContainer.directory();
     QVERIFY(directory.size() == 1);
 
     vf = directory.value(QString("test.dat"));
     QVERIFY(!vf.isNull());
+    QVERIFY(readContainer.virtualFile(QString("test.dat")) == vf);
 
     vf->open(QIODevice::ReadOnly);
 
@@ -97,3 +243,872 @@ void TestQContainer::testQContainerApi() {
 
     f->close();
 }
+
+
+void TestQContainer::testSequentialDevice() {
+    SequentialDevice pipe;
+    pipe.open(QIODevice::ReadWrite);
+
+    char buffer[bufferSizeInBytes];
+    for (unsigned i=0 ; i<bufferSizeInBytes ; ++i) {
+        buffer[i] = static_cast<char>(i % 253);
+    }
+
+    QContainer writeContainer(QString("Inesonic, LLC.\nAion Test"));
+    writeContainer.setDevice(&pipe);
+    writeContainer.setParent(Q_NULLPTR);
+    writeContainer.setStreamMode(QContainer::StreamMode::WRITE);
+
+    bool success = writeContainer.open();
+    QVERIFY(success);
+
+    QPointer<QVirtualFile> vf = writeContainer.newVirtualFile(QString("test.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::WriteOnly);
+    QVERIFY(vf->write(buffer, bufferSizeInBytes) == bufferSizeInBytes);
+    vf->close();
+
+    // Nothing is emitted until the container is closed.
+    QVERIFY(pipe.bytesAvailable() == 0);
+
+    success = writeContainer.close();
+    QVERIFY(success);
+    QVERIFY(pipe.bytesAvailable() > bufferSizeInBytes);
+
+    std::memset(buffer, 0, bufferSizeInBytes);
+
+    QContainer readContainer(QString("Inesonic, LLC.\nAion Test"));
+    readContainer.setDevice(&pipe);
+    readContainer.setParent(Q_NULLPTR);
+    readContainer.setStreamMode(QContainer::StreamMode::READ);
+
+    success = readContainer.open();
+    QVERIFY(success);
+    QVERIFY(pipe.bytesAvailable() == 0);
+
+    QContainer::DirectoryMap directory = readContainer.directory();
+    QVERIFY(directory.size() == 1);
+
+    vf = directory.value(QString("test.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::ReadOnly);
+    QVERIFY(vf->read(buffer, bufferSizeInBytes) == bufferSizeInBytes);
+
+    for (unsigned i=0 ; i<bufferSizeInBytes ; ++i) {
+        QVERIFY(buffer[i] == static_cast<char>(i % 253));
+    }
+
+    success = readContainer.close();
+    QVERIFY(success);
+}
+
+
+void TestQContainer::testGlob() {
+    QArenaDevice arena;
+    arena.open(QIODevice::ReadWrite);
+
+    QContainer container(QString("Inesonic, LLC.\nAion Test"));
+    container.setDevice(&arena);
+    container.setParent(Q_NULLPTR);
+
+    QVERIFY(container.open());
+
+    QStringList names = {
+        QString("a.bin"),
+        QString("textures/b.bin"),
+        QString("textures/large/c.bin"),
+        QString("textures/d.png"),
+        QString("[x].dat")
+    };
+
+    for (QStringList::const_iterator it=names.constBegin() ; it!=names.constEnd() ; ++it) {
+        QVERIFY(container.writeVirtualFile(*it, it->toUtf8()));
+    }
+
+    // '*' and '?' match across directory separators.
+
+    QVERIFY(container.glob(QString("*.bin")).size() == 3);
+    QVERIFY(container.glob(QString("*.bin")).contains(QString("textures/large/c.bin")));
+    QVERIFY(container.glob(QString("textures/*")).size() == 3);
+    QVERIFY(container.glob(QString("textures?d.png")).size() == 1);
+
+    // Patterns are anchored at both ends.
+
+    QVERIFY(container.glob(QString("*.bi")).isEmpty());
+    QVERIFY(container.glob(QString("b.bin")).isEmpty());
+
+    // Character classes, negation, and literal brackets.
+
+    QVERIFY(container.glob(QString("textures/[bd].*")).size() == 2);
+    QVERIFY(container.glob(QString("textures/[!b]*")).size() == 2);
+    QVERIFY(container.glob(QString("[[]x].dat")).size() == 1);
+    QVERIFY(container.glob(QString("[x].dat")).isEmpty());
+
+    QVERIFY(container.close());
+}
+
+
+void TestQContainer::testIoModes() {
+    QByteArray contents(static_cast<int>(totalBytesAcrossFiles), Qt::Uninitialized);
+    for (unsigned i=0 ; i<totalBytesAcrossFiles ; ++i) {
+        contents[static_cast<int>(i)] = static_cast<char>(i % 251);
+    }
+
+    #if (defined(Q_OS_UNIX))
+
+        QContainer::IoMode writableFallback = QContainer::IoMode::POSITIONAL;
+
+    #else
+
+        QContainer::IoMode writableFallback = QContainer::IoMode::DEVICE;
+
+    #endif
+
+    QList<QContainer::IoMode> modes = {
+        QContainer::IoMode::DEVICE,
+        QContainer::IoMode::POSITIONAL,
+        QContainer::IoMode::MAPPED
+    };
+
+    for (int writeIndex=0 ; writeIndex<modes.size() ; ++writeIndex) {
+        QContainer::IoMode writeMode = modes.at(writeIndex);
+
+        QFile* f = new QFile("test_io_modes.dat");
+        f->open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+        QContainer writeContainer(f, QString("Inesonic, LLC.\nAion Test"));
+        writeContainer.setIoMode(writeMode);
+
+        QVERIFY(writeContainer.open());
+        QVERIFY(writeContainer.requestedIoMode() == writeMode);
+
+        // Writable devices are never mapped.
+
+        if (writeMode == QContainer::IoMode::DEVICE) {
+            QVERIFY(writeContainer.ioMode() == QContainer::IoMode::DEVICE);
+        } else {
+            QVERIFY(writeContainer.ioMode() == writableFallback);
+        }
+
+        QVERIFY(writeContainer.writeVirtualFile(QString("test.dat"), contents));
+
+        // Partial writes at an offset must land where they were issued.
+
+        QPointer<QVirtualFile> vf = writeContainer.virtualFile(QString("test.dat"));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::ReadWrite);
+        QVERIFY(vf->seek(bufferSizeInBytes));
+        QVERIFY(vf->write(QByteArray(16, 'x')) == 16);
+        vf->close();
+
+        contents.replace(bufferSizeInBytes, 16, QByteArray(16, 'x'));
+
+        QVERIFY(writeContainer.close());
+        f->close();
+
+        for (int readIndex=0 ; readIndex<modes.size() ; ++readIndex) {
+            QContainer::IoMode readMode = modes.at(readIndex);
+
+            f = new QFile("test_io_modes.dat");
+            f->open(QIODevice::ReadOnly);
+
+            QContainer readContainer(f, QString("Inesonic, LLC.\nAion Test"));
+            readContainer.setIoMode(readMode);
+
+            QVERIFY(readContainer.open());
+
+            if (readMode == QContainer::IoMode::DEVICE) {
+                QVERIFY(readContainer.ioMode() == QContainer::IoMode::DEVICE);
+            } else if (readMode == QContainer::IoMode::POSITIONAL) {
+                QVERIFY(readContainer.ioMode() == writableFallback);
+            } else {
+                QVERIFY(readContainer.ioMode() == QContainer::IoMode::MAPPED);
+            }
+
+            QByteArray data;
+            QVERIFY(readContainer.readVirtualFile(QString("test.dat"), data));
+            QVERIFY(data == contents);
+
+            QVERIFY(readContainer.close());
+            f->close();
+        }
+    }
+
+    // An empty read-only file can not be mapped.
+
+    QFile* f = new QFile("test_io_modes_empty.dat");
+    f->open(QIODevice::ReadWrite | QIODevice::Truncate);
+    f->close();
+    f->open(QIODevice::ReadOnly);
+
+    QContainer emptyContainer(f, QString("Inesonic, LLC.\nAion Test"));
+    emptyContainer.setIoMode(QContainer::IoMode::MAPPED);
+    emptyContainer.open();
+
+    QVERIFY(emptyContainer.ioMode() == writableFallback);
+
+    emptyContainer.close();
+    f->close();
+}
+
+
+void TestQContainer::testView() {
+    QByteArray contents(static_cast<int>(totalBytesAcrossFiles), Qt::Uninitialized);
+    for (unsigned i=0 ; i<totalBytesAcrossFiles ; ++i) {
+        contents[static_cast<int>(i)] = static_cast<char>(i % 249);
+    }
+
+    QFile* f = new QFile("test_view.dat");
+    f->open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+    QContainer writeContainer(f, QString("Inesonic, LLC.\nAion Test"));
+    QVERIFY(writeContainer.open());
+    QVERIFY(writeContainer.writeVirtualFile(QString("test.dat"), contents));
+    QVERIFY(writeContainer.close());
+    f->close();
+
+    QList<QContainer::IoMode> modes = { QContainer::IoMode::DEVICE, QContainer::IoMode::MAPPED };
+    for (int modeIndex=0 ; modeIndex<modes.size() ; ++modeIndex) {
+        f = new QFile("test_view.dat");
+        f->open(QIODevice::ReadOnly);
+
+        QContainer readContainer(f, QString("Inesonic, LLC.\nAion Test"));
+        readContainer.setIoMode(modes.at(modeIndex));
+        QVERIFY(readContainer.open());
+
+        QPointer<QVirtualFile> vf = readContainer.virtualFile(QString("test.dat"));
+        QVERIFY(!vf.isNull());
+        vf->open(QIODevice::ReadOnly);
+
+        // The first view of a range discovers where it is stored, later views within the range may reference the
+        // mapping.  Both must return the same data.
+
+        QVERIFY(vf->view(0, totalBytesAcrossFiles) == contents);
+        QVERIFY(vf->view(bufferSizeInBytes, bufferSizeInBytes) == contents.mid(bufferSizeInBytes, bufferSizeInBytes));
+        QVERIFY(vf->view(totalBytesAcrossFiles - 10, 100) == contents.right(10));
+        QVERIFY(vf->view(totalBytesAcrossFiles, 1).isEmpty());
+        QVERIFY(vf->view(totalBytesAcrossFiles + 1, 1).isNull());
+        QVERIFY(vf->pos() == 0);
+
+        // Views detach from the mapping when modified.
+
+        QByteArray modified = vf->view(0, 16);
+        modified[0] = static_cast<char>(0xFF);
+        QVERIFY(vf->view(0, 16) == contents.left(16));
+
+        vf->close();
+
+        QVERIFY(readContainer.close());
+        f->close();
+    }
+}
+
+
+void TestQContainer::testPositionalIo() {
+    QFile* f = new QFile("test_positional.dat");
+    f->open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+    RawContainer container(f);
+    container.setIoMode(QContainer::IoMode::POSITIONAL);
+    QVERIFY(container.open());
+
+    #if (defined(Q_OS_UNIX))
+
+        QVERIFY(container.ioMode() == QContainer::IoMode::POSITIONAL);
+
+    #endif
+
+    unsigned long long headerSize     = static_cast<unsigned long long>(container.size());
+    qint64             devicePosition = f->pos();
+
+    // Append a region past the end of the container, then interleave writes and reads at scattered offsets within
+    // it.
+
+    QByteArray expected(static_cast<int>(bufferSizeInBytes), '\0');
+    QVERIFY(container.writeAt(headerSize, expected));
+    QVERIFY(container.size() == static_cast<long long>(headerSize + bufferSizeInBytes));
+
+    for (unsigned i=0 ; i<64 ; ++i) {
+        unsigned   offset = (i * 7919) % (bufferSizeInBytes - 256);
+        QByteArray data(static_cast<int>(i + 1), static_cast<char>('a' + i % 26));
+
+        QVERIFY(container.writeAt(headerSize + offset, data));
+        QVERIFY(container.position() == headerSize + offset + static_cast<unsigned>(data.size()));
+
+        expected.replace(static_cast<int>(offset), data.size(), data);
+        QVERIFY(container.readAt(headerSize + offset, static_cast<unsigned>(data.size())) == data);
+    }
+
+    unsigned long long rawSize = bufferSizeInBytes;
+    QVERIFY(container.size() == static_cast<long long>(headerSize + rawSize));
+    QVERIFY(container.readAt(headerSize, bufferSizeInBytes) == expected);
+
+    // Reads past the end are clipped.
+
+    QVERIFY(container.readAt(headerSize + rawSize - 4, 16).size() == 4);
+
+    // Positional accesses do not move the device.
+
+    #if (defined(Q_OS_UNIX))
+
+        QVERIFY(f->pos() == devicePosition);
+
+    #endif
+
+    QVERIFY(!container.flush());
+
+    QFile check("test_positional.dat");
+    check.open(QIODevice::ReadOnly);
+    QVERIFY(check.size() == static_cast<qint64>(headerSize + rawSize));
+    QVERIFY(check.seek(static_cast<qint64>(headerSize)));
+    QVERIFY(check.read(static_cast<qint64>(rawSize)) == expected);
+    check.close();
+
+    QVERIFY(!container.setPosition(headerSize));
+    QVERIFY(!container.truncate());
+
+    QVERIFY(container.close());
+    f->close();
+}
+
+
+void TestQContainer::testFlushAndTruncate() {
+    QList<QContainer::IoMode> modes = { QContainer::IoMode::DEVICE, QContainer::IoMode::POSITIONAL };
+    for (int modeIndex=0 ; modeIndex<modes.size() ; ++modeIndex) {
+        QFile* f = new QFile("test_truncate.dat");
+        f->open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+        RawContainer container(f);
+        container.setIoMode(modes.at(modeIndex));
+        container.setFlushMode(modeIndex == 0 ? QContainer::FlushMode::BUFFERED : QContainer::FlushMode::DURABLE);
+        QVERIFY(container.open());
+        QVERIFY(container.supportsTruncation());
+
+        unsigned long long headerSize = static_cast<unsigned long long>(container.size());
+
+        // Flushed data is visible through a second handle on the file.
+
+        QVERIFY(container.writeAt(headerSize, QByteArray(static_cast<int>(bufferSizeInBytes), 'z')));
+        QVERIFY(!container.flush());
+        QVERIFY(QFileInfo(QString("test_truncate.dat")).size() == static_cast<qint64>(headerSize + bufferSizeInBytes));
+
+        // Truncation resizes the file at the current position and discards cached data past it.
+
+        QVERIFY(!container.setPosition(headerSize + 100));
+        QVERIFY(!container.truncate());
+        QVERIFY(container.size() == static_cast<long long>(headerSize + 100));
+        QVERIFY(container.readAt(headerSize, bufferSizeInBytes) == QByteArray(100, 'z'));
+        QVERIFY(!container.flush());
+        QVERIFY(QFileInfo(QString("test_truncate.dat")).size() == static_cast<qint64>(headerSize + 100));
+
+        // Data written after a truncation extends the file from the new end.
+
+        QVERIFY(container.writeAt(headerSize + 100, QByteArray(10, 'y')));
+        QVERIFY(container.readAt(headerSize + 96, 16) == QByteArray(4, 'z') + QByteArray(10, 'y'));
+
+        QVERIFY(!container.setPosition(headerSize));
+        QVERIFY(!container.truncate());
+
+        QVERIFY(container.close());
+        f->close();
+    }
+
+    // Buffers support truncation.
+
+    QBuffer* buffer = new QBuffer;
+    buffer->open(QIODevice::ReadWrite);
+
+    RawContainer bufferContainer(buffer);
+    QVERIFY(bufferContainer.open());
+    QVERIFY(bufferContainer.supportsTruncation());
+
+    unsigned long long headerSize = static_cast<unsigned long long>(bufferContainer.size());
+    QVERIFY(bufferContainer.writeAt(headerSize, QByteArray(1000, 'x')));
+    QVERIFY(!bufferContainer.setPosition(headerSize + 10));
+    QVERIFY(!bufferContainer.truncate());
+    QVERIFY(!bufferContainer.flush());
+    QVERIFY(buffer->size() == static_cast<qint64>(headerSize + 10));
+
+    QVERIFY(!bufferContainer.setPosition(headerSize));
+    QVERIFY(!bufferContainer.truncate());
+    QVERIFY(bufferContainer.close());
+
+    // Mapped containers are read-only and can not be truncated.
+
+    QFile* f = new QFile("test_truncate.dat");
+    f->open(QIODevice::ReadOnly);
+
+    RawContainer mappedContainer(f);
+    mappedContainer.setIoMode(QContainer::IoMode::MAPPED);
+    QVERIFY(mappedContainer.open());
+    QVERIFY(mappedContainer.ioMode() == QContainer::IoMode::MAPPED);
+
+    QVERIFY(!mappedContainer.setPosition(0));
+    QVERIFY(mappedContainer.truncate());
+    QVERIFY(QFileInfo(QString("test_truncate.dat")).size() > 0);
+
+    QVERIFY(mappedContainer.close());
+    f->close();
+}
+
+
+void TestQContainer::testAccessHints() {
+    QByteArray contents(static_cast<int>(totalBytesAcrossFiles), Qt::Uninitialized);
+    for (unsigned i=0 ; i<totalBytesAcrossFiles ; ++i) {
+        contents[static_cast<int>(i)] = static_cast<char>(i % 241);
+    }
+
+    QFile* f = new QFile("test_hints.dat");
+    f->open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+    QContainer writeContainer(f, QString("Inesonic, LLC.\nAion Test"));
+    QVERIFY(writeContainer.open());
+    QVERIFY(writeContainer.writeVirtualFile(QString("test.dat"), contents));
+    QVERIFY(writeContainer.close());
+    f->close();
+
+    // Read the file front to back in small pieces with each access pattern.  Sequential readers are served from
+    // read-ahead so they miss the block cache far less often than random readers.
+
+    QList<QVirtualFile::AccessHint> hints = { QVirtualFile::AccessHint::SEQUENTIAL, QVirtualFile::AccessHint::RANDOM };
+    QList<unsigned long long>       misses;
+
+    for (int hintIndex=0 ; hintIndex<hints.size() ; ++hintIndex) {
+        f = new QFile("test_hints.dat");
+        f->open(QIODevice::ReadOnly);
+
+        QContainer readContainer(f, QString("Inesonic, LLC.\nAion Test"));
+        readContainer.setBlockCacheSize(8 * totalBytesAcrossFiles);
+        QVERIFY(readContainer.open());
+
+        QPointer<QVirtualFile> vf = readContainer.virtualFile(QString("test.dat"));
+        QVERIFY(!vf.isNull());
+        vf->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+        vf->setAccessHint(hints.at(hintIndex));
+        QVERIFY(vf->accessHint() == hints.at(hintIndex));
+
+        // One-shot hints do not change the access pattern.
+
+        vf->setAccessHint(QVirtualFile::AccessHint::WILL_NEED);
+        QVERIFY(vf->accessHint() == hints.at(hintIndex));
+
+        readContainer.resetBlockCacheStatistics();
+
+        QByteArray data;
+        QByteArray piece = vf->read(4000);
+        while (!piece.isEmpty()) {
+            data.append(piece);
+            piece = vf->read(4000);
+        }
+
+        QVERIFY(data == contents);
+        misses.append(readContainer.blockCacheMisses());
+
+        vf->setAccessHint(QVirtualFile::AccessHint::DONT_NEED);
+        vf->close();
+
+        QVERIFY(readContainer.close());
+        f->close();
+    }
+
+    QVERIFY(misses.at(0) * 4 < misses.at(1));
+}
+
+
+void TestQContainer::testWriteCombining() {
+    QFile* f = new QFile("test_combining.dat");
+    f->open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+    RawContainer container(f);
+    container.setIoMode(QContainer::IoMode::POSITIONAL);
+    QVERIFY(container.open());
+    QVERIFY(container.setWriteCombiningSize(bufferSizeInBytes));
+    QVERIFY(container.writeCombiningSize() == bufferSizeInBytes);
+
+    unsigned long long headerSize = static_cast<unsigned long long>(container.size());
+    qint64             fileSize   = QFileInfo(QString("test_combining.dat")).size();
+
+    // Adjacent small writes are held in the buffer.
+
+    QByteArray expected;
+    for (unsigned i=0 ; i<16 ; ++i) {
+        QByteArray data(100, static_cast<char>('a' + i));
+        QVERIFY(container.writeAt(headerSize + expected.size(), data));
+        expected.append(data);
+    }
+
+    #if (defined(Q_OS_UNIX))
+
+        QVERIFY(QFileInfo(QString("test_combining.dat")).size() == fileSize);
+
+    #endif
+
+    // Overlapping writes replace buffered data in place.
+
+    QVERIFY(container.writeAt(headerSize + 150, QByteArray(100, 'X')));
+    expected.replace(150, 100, QByteArray(100, 'X'));
+
+    // Reads see the buffered data.
+
+    QVERIFY(container.readAt(headerSize, static_cast<unsigned>(expected.size())) == expected);
+
+    // A write that does not follow the buffered data pushes the buffered data to the device first.
+
+    QVERIFY(container.writeAt(headerSize + 10, QByteArray(5, 'Y')));
+
+    #if (defined(Q_OS_UNIX))
+
+        QVERIFY(QFileInfo(QString("test_combining.dat")).size() == static_cast<qint64>(headerSize) + expected.size());
+
+    #endif
+
+    expected.replace(10, 5, QByteArray(5, 'Y'));
+
+    // Writes as large as the buffer bypass it.
+
+    QByteArray large(static_cast<int>(bufferSizeInBytes), 'L');
+    QVERIFY(container.writeAt(headerSize + expected.size(), large));
+    expected.append(large);
+
+    QVERIFY(!container.flush());
+
+    QFile check("test_combining.dat");
+    check.open(QIODevice::ReadOnly);
+    QVERIFY(check.size() == static_cast<qint64>(headerSize) + expected.size());
+    QVERIFY(check.seek(static_cast<qint64>(headerSize)));
+    QVERIFY(check.read(expected.size()) == expected);
+    check.close();
+
+    // Changing the buffer size pushes buffered data to the device.
+
+    QVERIFY(container.writeAt(headerSize + expected.size(), QByteArray(7, 'Z')));
+    expected.append(QByteArray(7, 'Z'));
+
+    QVERIFY(container.setWriteCombiningSize(0));
+    QVERIFY(QFileInfo(QString("test_combining.dat")).size() == static_cast<qint64>(headerSize) + expected.size());
+
+    QVERIFY(!container.setPosition(headerSize));
+    QVERIFY(!container.truncate());
+    QVERIFY(container.close());
+    f->close();
+
+    // Small virtual file writes from several files interleave correctly with combining enabled.
+
+    f = new QFile("test_combining.dat");
+    f->open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+    QContainer writeContainer(f, QString("Inesonic, LLC.\nAion Test"));
+    QVERIFY(writeContainer.setWriteCombiningSize(bufferSizeInBytes));
+    QVERIFY(writeContainer.open());
+
+    QList<QPointer<QVirtualFile>> files;
+    for (unsigned i=0 ; i<numberVirtualFiles ; ++i) {
+        QPointer<QVirtualFile> vf = writeContainer.newVirtualFile(QString("file%1.dat").arg(i));
+        QVERIFY(!vf.isNull());
+        vf->open(QIODevice::WriteOnly | QIODevice::Unbuffered);
+        files.append(vf);
+    }
+
+    for (unsigned block=0 ; block<64 ; ++block) {
+        for (unsigned i=0 ; i<numberVirtualFiles ; ++i) {
+            QVERIFY(files.at(static_cast<int>(i))->write(QByteArray(37, static_cast<char>(block + i))) == 37);
+        }
+    }
+
+    for (unsigned i=0 ; i<numberVirtualFiles ; ++i) {
+        files.at(static_cast<int>(i))->close();
+    }
+
+    QVERIFY(writeContainer.close());
+    f->close();
+
+    f = new QFile("test_combining.dat");
+    f->open(QIODevice::ReadOnly);
+
+    QContainer readContainer(f, QString("Inesonic, LLC.\nAion Test"));
+    QVERIFY(readContainer.open());
+
+    for (unsigned i=0 ; i<numberVirtualFiles ; ++i) {
+        QByteArray fileExpected;
+        for (unsigned block=0 ; block<64 ; ++block) {
+            fileExpected.append(QByteArray(37, static_cast<char>(block + i)));
+        }
+
+        QByteArray data;
+        QVERIFY(readContainer.readVirtualFile(QString("file%1.dat").arg(i), data));
+        QVERIFY(data == fileExpected);
+    }
+
+    QVERIFY(readContainer.close());
+    f->close();
+}
+
+
+void TestQContainer::testAsyncIo() {
+    QArenaDevice arena;
+    arena.open(QIODevice::ReadWrite);
+
+    QContainer container(QString("Inesonic, LLC.\nAion Test"));
+    container.setDevice(&arena);
+    container.setParent(Q_NULLPTR);
+
+    QVERIFY(container.open());
+
+    QPointer<QVirtualFile> vf = container.newVirtualFile(QString("async.dat"));
+    QVERIFY(!vf.isNull());
+    vf->open(QIODevice::ReadWrite);
+
+    QSignalSpy writtenSpy(vf.data(), SIGNAL(bytesWritten(qint64)));
+    QSignalSpy readSpy(vf.data(), SIGNAL(readyRead()));
+
+    // Operations run in the order they were issued, so a read sees every write queued before it and none queued
+    // after it.
+
+    QByteArray             expected;
+    QList<QFuture<qint64>> writes;
+    for (unsigned i=0 ; i<32 ; ++i) {
+        QByteArray data(1024, static_cast<char>('A' + i % 26));
+        writes.append(vf->writeAsync(expected.size(), data));
+        expected.append(data);
+    }
+
+    QFuture<QByteArray> firstRead = vf->readAsync(0, expected.size());
+
+    writes.append(vf->writeAsync(0, QByteArray(1024, '#')));
+
+    QFuture<QByteArray> secondRead = vf->readAsync(0, 1024);
+    QFuture<bool>       flushed    = vf->flushAsync();
+
+    // The flush was queued last so every earlier operation has finished once it completes.
+
+    QVERIFY(flushed.result());
+
+    for (int i=0 ; i<writes.size() ; ++i) {
+        QVERIFY(writes.at(i).isFinished());
+        QVERIFY(writes.at(i).result() == 1024);
+    }
+
+    QVERIFY(firstRead.isFinished());
+    QVERIFY(firstRead.result() == expected);
+    QVERIFY(secondRead.result() == QByteArray(1024, '#'));
+
+    // Reads past the end of the file are clipped.
+
+    QVERIFY(vf->readAsync(expected.size() - 10, 100).result() == expected.right(10));
+
+    // Asynchronous operations do not move the device position and are visible to synchronous readers.
+
+    QVERIFY(vf->pos() == 0);
+    QVERIFY(vf->read(2048) == QByteArray(1024, '#') + expected.mid(1024, 1024));
+
+    // Completion signals are delivered in the container's thread.
+
+    QTRY_COMPARE(writtenSpy.count(), writes.size());
+    QTRY_COMPARE(readSpy.count(), 3);
+
+    vf->close();
+    QVERIFY(container.close());
+}
+
+
+void TestQContainer::testVectoredIo() {
+    QArenaDevice arena;
+    arena.open(QIODevice::ReadWrite);
+
+    QContainer container(QString("Inesonic, LLC.\nAion Test"));
+    container.setDevice(&arena);
+    container.setParent(Q_NULLPTR);
+
+    QVERIFY(container.open());
+
+    QPointer<QVirtualFile> vf = container.newVirtualFile(QString("vectored.dat"));
+    QVERIFY(!vf.isNull());
+    vf->open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+
+    QVERIFY(vf->write(QByteArray(4010, '\0')) == 4010);
+    QVERIFY(vf->seek(0));
+
+    // Gather writes are issued out of order and include contiguous and disjoint ranges.
+
+    QByteArray first(1000, 'a');
+    QByteArray second(500, 'b');
+    QByteArray third(2000, 'c');
+    QByteArray fourth(10, 'd');
+
+    QList<QVirtualFile::WriteVector> writeVectors;
+    writeVectors.append({ 1500, third.constData(), third.size() });
+    writeVectors.append({ 0, first.constData(), first.size() });
+    writeVectors.append({ 4000, fourth.constData(), fourth.size() });
+    writeVectors.append({ 1000, second.constData(), second.size() });
+
+    QVERIFY(vf->writev(writeVectors) == first.size() + second.size() + third.size() + fourth.size());
+    QVERIFY(vf->pos() == 0);
+    QVERIFY(vf->size() == 4010);
+
+    QByteArray expected = first + second + third + QByteArray(500, '\0') + fourth;
+    QVERIFY(vf->read(4010) == expected);
+
+    // Scatter reads are issued out of order and the last range extends past the end of the file.
+
+    QByteArray head(100, Qt::Uninitialized);
+    QByteArray middle(1000, Qt::Uninitialized);
+    QByteArray tail(100, '\xFF');
+
+    QList<QVirtualFile::ReadVector> readVectors;
+    readVectors.append({ 3990, tail.data(), tail.size() });
+    readVectors.append({ 950, middle.data(), middle.size() });
+    readVectors.append({ 0, head.data(), head.size() });
+
+    QVERIFY(vf->seek(10));
+    QVERIFY(vf->readv(readVectors) == head.size() + middle.size() + 20);
+    QVERIFY(vf->pos() == 10);
+
+    QVERIFY(head == expected.left(100));
+    QVERIFY(middle == expected.mid(950, 1000));
+    QVERIFY(tail.left(20) == expected.right(20));
+    QVERIFY(tail.mid(20) == QByteArray(80, '\xFF'));
+
+    vf->close();
+    QVERIFY(container.close());
+}
+
+
+void TestQContainer::testDirectoryIndex() {
+    QArenaDevice arena;
+    arena.open(QIODevice::ReadWrite);
+
+    QContainer container(QString("Inesonic, LLC.\nAion Test"));
+    container.setDevice(&arena);
+    container.setParent(Q_NULLPTR);
+
+    QVERIFY(container.open());
+
+    for (unsigned i=0 ; i<50 ; ++i) {
+        QPointer<QVirtualFile> vf = container.newVirtualFile(QString("file%1.dat").arg(i));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::WriteOnly);
+        QVERIFY(vf->write(QByteArray(static_cast<int>(i + 1), 'a')) == i + 1);
+        vf->close();
+    }
+
+    // The directory and the lookup by name agree.
+
+    QContainer::DirectoryMap directory = container.directory();
+    QVERIFY(directory.size() == 50);
+
+    for (unsigned i=0 ; i<50 ; ++i) {
+        QString name = QString("file%1.dat").arg(i);
+        QVERIFY(container.virtualFile(name) == directory.value(name));
+        QVERIFY(container.virtualFile(name)->size() == i + 1);
+    }
+
+    // Erased files leave the directory immediately.
+
+    for (unsigned i=0 ; i<50 ; i+=2) {
+        QVERIFY(container.virtualFile(QString("file%1.dat").arg(i))->erase());
+    }
+
+    directory = container.directory();
+    QVERIFY(directory.size() == 25);
+    QVERIFY(!directory.contains(QString("file0.dat")));
+    QVERIFY(container.virtualFile(QString("file0.dat")).isNull());
+    QVERIFY(!container.virtualFile(QString("file1.dat")).isNull());
+
+    // Creating a file with the name of an existing, closed, file replaces it.
+
+    QPointer<QVirtualFile> replacement = container.newVirtualFile(QString("file1.dat"));
+    QVERIFY(!replacement.isNull());
+    QVERIFY(replacement->size() == 0);
+    QVERIFY(container.directory().size() == 25);
+    QVERIFY(container.virtualFile(QString("file1.dat")) == replacement);
+
+    // Names may be reused after an erase.
+
+    QVERIFY(!container.newVirtualFile(QString("file0.dat")).isNull());
+    QVERIFY(container.directory().size() == 26);
+
+    QVERIFY(container.close());
+
+    // The index is rebuilt from the engine directory when the container is opened.
+
+    QVERIFY(container.open());
+
+    directory = container.directory();
+    QVERIFY(directory.size() == 26);
+    QVERIFY(directory.contains(QString("file0.dat")));
+    QVERIFY(!directory.contains(QString("file2.dat")));
+    QVERIFY(container.virtualFile(QString("file1.dat"))->size() == 0);
+    QVERIFY(container.virtualFile(QString("file3.dat"))->size() == 4);
+
+    QVERIFY(container.close());
+}
+
+
+void TestQContainer::testHandles() {
+    QArenaDevice arena;
+    arena.open(QIODevice::ReadWrite);
+
+    QContainer writeContainer(QString("Inesonic, LLC.\nAion Test"));
+    writeContainer.setDevice(&arena);
+    writeContainer.setParent(Q_NULLPTR);
+
+    QVERIFY(writeContainer.open());
+
+    for (unsigned i=0 ; i<numberVirtualFiles ; ++i) {
+        QString name = QString("file%1.dat").arg(i);
+        QVERIFY(writeContainer.writeVirtualFile(name, QByteArray(static_cast<int>(i + 1), 'h')));
+    }
+
+    QVERIFY(writeContainer.close());
+
+    QContainer container(QString("Inesonic, LLC.\nAion Test"));
+    container.setDevice(&arena);
+    container.setParent(Q_NULLPTR);
+
+    QVERIFY(container.open());
+
+    // Handles do not create virtual file devices.
+
+    QContainer::HandleMap handles = container.handles();
+    QVERIFY(handles.size() == static_cast<int>(numberVirtualFiles));
+    QVERIFY(container.findChildren<QVirtualFile*>().isEmpty());
+
+    QVirtualFileHandle handle = handles.value(QString("file2.dat"));
+    QVERIFY(handle.isValid());
+    QVERIFY(handle.name() == QString("file2.dat"));
+    QVERIFY(handle.container() == &container);
+    QVERIFY(handle.size() == 3);
+    QVERIFY(handle == container.handle(QString("file2.dat")));
+    QVERIFY(handle != container.handle(QString("file1.dat")));
+    QVERIFY(container.findChildren<QVirtualFile*>().isEmpty());
+
+    QVERIFY(!QVirtualFileHandle().isValid());
+    QVERIFY(!container.handle(QString("missing.dat")).isValid());
+
+    // The device is created on first use and shared by later requests.
+
+    QPointer<QVirtualFile> vf = handle.open(QIODevice::ReadOnly);
+    QVERIFY(!vf.isNull());
+    QVERIFY(vf->isOpen());
+    QVERIFY(vf->readAll() == QByteArray(3, 'h'));
+    QVERIFY(handle.virtualFile() == vf);
+    QVERIFY(container.virtualFile(QString("file2.dat")) == vf);
+    QVERIFY(container.findChildren<QVirtualFile*>().size() == 1);
+
+    vf->close();
+
+    // Erasing through a handle invalidates every handle to the file.
+
+    QVirtualFileHandle copy = handle;
+    QVERIFY(copy.erase());
+    QVERIFY(!handle.isValid());
+    QVERIFY(!container.handle(QString("file2.dat")).isValid());
+    QVERIFY(container.handles().size() == static_cast<int>(numberVirtualFiles - 1));
+
+    QVERIFY(container.close());
+}
@@ -31,6 +31,18 @@ class TestQContainer:public QObject {
 
     private slots:
         void testQContainerApi();
+        void testSequentialDevice();
+        void testGlob();
+        void testIoModes();
+        void testView();
+        void testPositionalIo();
+        void testFlushAndTruncate();
+        void testAccessHints();
+        void testWriteCombining();
+        void testAsyncIo();
+        void testVectoredIo();
+        void testDirectoryIndex();
+        void testHandles();
 
     private:
         static constexpr unsigned bufferSizeInBytes     = 65536;
@@ -0,0 +1,106 @@
+/*-*-c++-*-*************************************************************************************************************
+* Copyright 2022 Inesonic, LLC.
+*
+* MIT License:
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+*   documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+*   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+*   permit persons to whom the Software is furnished to do so, subject to the following conditions:
+*   
+*   The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+*   Software.
+*   
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+*   WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+*   OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+*   OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+********************************************************************************************************************//**
+* \file
+*
+* This file implements tests of the QContainerBlockCache class.
+***********************************************************************************************************************/
+
+#include <QDebug>
+#include <QtTest/QtTest>
+#include <QByteArray>
+
+#include <cstdint>
+
+#include <qcontainer_block_cache.h>
+
+#include "test_qcontainer_block_cache.h"
+
+/***********************************************************************************************************************
+ * TestQContainerBlockCache
+ */
+
+void TestQContainerBlockCache::testLruEviction() {
+    QContainerBlockCache cache(3 * blockSize, blockSize);
+    QVERIFY(cache.isEnabled());
+
+    for (unsigned i=0 ; i<3 ; ++i) {
+        cache.insert(i, QByteArray(blockSize, static_cast<char>('a' + i)));
+    }
+
+    QVERIFY(cache.currentSize() == 3 * blockSize);
+
+    // Touch block 0 so that block 1 becomes the least recently used block.
+    QVERIFY(cache.block(0) != Q_NULLPTR);
+
+    cache.insert(3, QByteArray(blockSize, 'd'));
+
+    QVERIFY(cache.contains(0));
+    QVERIFY(!cache.contains(1));
+    QVERIFY(cache.contains(2));
+    QVERIFY(cache.contains(3));
+    QVERIFY(cache.currentSize() == 3 * blockSize);
+
+    QVERIFY(cache.block(1) == Q_NULLPTR);
+    QVERIFY(cache.hits() == 1);
+    QVERIFY(cache.misses() == 1);
+
+    cache.resetStatistics();
+    QVERIFY(cache.hits() == 0);
+    QVERIFY(cache.misses() == 0);
+
+    cache.setMaximumSize(0);
+    QVERIFY(!cache.isEnabled());
+    QVERIFY(cache.currentSize() == 0);
+}
+
+
+void TestQContainerBlockCache::testUpdateAndTruncate() {
+    QContainerBlockCache cache(4 * blockSize, blockSize);
+
+    cache.insert(0, QByteArray(blockSize, 'a'));
+    cache.insert(1, QByteArray(blockSize / 2, 'b'));
+
+    // Write spanning the end of block 0 and extending the partial block 1.
+    std::uint8_t data[blockSize];
+    for (unsigned i=0 ; i<blockSize ; ++i) {
+        data[i] = 'x';
+    }
+
+    cache.update(blockSize - 4, data, blockSize);
+
+    const QByteArray* block0 = cache.block(0);
+    QVERIFY(block0 != Q_NULLPTR);
+    QVERIFY(block0->size() == static_cast<int>(blockSize));
+    QVERIFY(block0->at(blockSize - 5) == 'a');
+    QVERIFY(block0->at(blockSize - 4) == 'x');
+
+    const QByteArray* block1 = cache.block(1);
+    QVERIFY(block1 != Q_NULLPTR);
+    QVERIFY(block1->size() == static_cast<int>(blockSize - 4));
+    QVERIFY(block1->at(blockSize - 5) == 'x');
+
+    // A write leaving a gap after the cached data invalidates the block.
+    cache.update(2 * blockSize - 1, data, 1);
+    QVERIFY(!cache.contains(1));
+
+    cache.truncate(blockSize / 2);
+    block0 = cache.block(0);
+    QVERIFY(block0 != Q_NULLPTR);
+    QVERIFY(block0->size() == static_cast<int>(blockSize / 2));
+    QVERIFY(cache.currentSize() == blockSize / 2);
+}
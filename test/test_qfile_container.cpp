@@ -23,13 +23,27 @@
 #include <QDebug>
 #include <QtTest/QtTest>
 #include <QIODevice>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
 #include <QPointer>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QFuture>
+#include <QtConcurrent>
+#include <QtEndian>
 
 #include <cstring>
 #include <random>
 
+#include <qcontainer.h>
 #include <qfile_container.h>
+#include <qcontainer_importer.h>
+#include <qcontainer_extractor.h>
 #include <qvirtual_file.h>
+#include <qvirtual_file_handle.h>
 
 #include "test_qfile_container.h"
 
@@ -86,3 +100,1003 @@ void TestQFileContainer::testQFileContainerApi() {
     success = readContainer.close();
     QVERIFY(success);
 }
+
+
+void TestQFileContainer::testLazyOpen() {
+    QFileContainer writeContainer(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = writeContainer.open(QString("test_lazy_container.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    QPointer<QVirtualFile> vf = writeContainer.newVirtualFile(QString("test.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::WriteOnly);
+    QVERIFY(vf->write("lazy", 4) == 4);
+    vf->close();
+
+    success = writeContainer.close();
+    QVERIFY(success);
+
+    // A lazy open only checks the file identifier.
+
+    QFileContainer wrongContainer(QString("Some Other Identifier"));
+    wrongContainer.setLazyOpen(true);
+
+    success = wrongContainer.open(QString("test_lazy_container.dat"), QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(!success);
+
+    // The identifier must be in the header field.  Matching bytes elsewhere in the file are not sufficient.
+
+    QFileContainer payloadContainer(QString("lazy"));
+    payloadContainer.setLazyOpen(true);
+
+    success = payloadContainer.open(QString("test_lazy_container.dat"), QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(!success);
+
+    QFileContainer readContainer(QString("Inesonic, LLC.\nAion Test"));
+    readContainer.setLazyOpen(true);
+    QVERIFY(readContainer.lazyOpen());
+
+    success = readContainer.open(QString("test_lazy_container.dat"), QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(success);
+
+    QVERIFY(readContainer.validate());
+    QVERIFY(readContainer.handles().size() == 1);
+    QVERIFY(readContainer.handle(QString("test.dat")).size() == 4);
+
+    success = readContainer.close();
+    QVERIFY(success);
+
+    // Closing a container before the deferred open completes must also succeed.
+
+    success = readContainer.open(QString("test_lazy_container.dat"), QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(success);
+
+    success = readContainer.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testConcurrentReaders() {
+    QFileContainer writeContainer(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = writeContainer.open(QString("test_reader_container.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QPointer<QVirtualFile> vf = writeContainer.newVirtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::WriteOnly);
+        QVERIFY(vf->write(QByteArray(bufferSizeInBytes, static_cast<char>('a' + fileIndex))) == bufferSizeInBytes);
+        vf->close();
+    }
+
+    success = writeContainer.close();
+    QVERIFY(success);
+
+    QFileContainer readContainer(QString("Inesonic, LLC.\nAion Test"));
+
+    success = readContainer.open(QString("test_reader_container.dat"), QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(success);
+
+    // Each worker uses its own reader so the reads proceed in parallel.
+
+    QList<QContainer*>   readers;
+    QList<QFuture<bool>> futures;
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QContainer* reader = readContainer.openReader(&readContainer);
+        QVERIFY(reader != Q_NULLPTR);
+
+        readers.append(reader);
+
+        QVirtualFile* vf = reader->virtualFile(QString("file%1.dat").arg(fileIndex)).data();
+        QVERIFY(vf != Q_NULLPTR);
+
+        futures.append(QtConcurrent::run([vf, fileIndex]() {
+            bool result = vf->open(QIODevice::ReadOnly);
+            if (result) {
+                result = (vf->readAll() == QByteArray(bufferSizeInBytes, static_cast<char>('a' + fileIndex)));
+                vf->close();
+            }
+
+            return result;
+        }));
+    }
+
+    for (QList<QFuture<bool>>::iterator it=futures.begin() ; it!=futures.end() ; ++it) {
+        QVERIFY(it->result());
+    }
+
+    for (QList<QContainer*>::iterator it=readers.begin() ; it!=readers.end() ; ++it) {
+        QVERIFY((*it)->close());
+        delete *it;
+    }
+
+    success = readContainer.close();
+    QVERIFY(success);
+
+    // A reader of a container that is still open for writing sees the current contents of the container, including
+    // virtual files created and erased since the container was opened and data still held by open devices.
+
+    success = writeContainer.open(QString("test_reader_container.dat"), QFileContainer::OpenMode::READ_WRITE);
+    QVERIFY(success);
+
+    QPointer<QVirtualFile> liveVf = writeContainer.newVirtualFile(QString("live.dat"));
+    QVERIFY(!liveVf.isNull());
+
+    liveVf->open(QIODevice::WriteOnly);
+    QVERIFY(liveVf->write(QByteArray(bufferSizeInBytes, 'z')) == bufferSizeInBytes);
+    QVERIFY(writeContainer.handle(QString("file0.dat")).erase());
+
+    QContainer* liveReader = writeContainer.openReader();
+    QVERIFY(liveReader != Q_NULLPTR);
+    QVERIFY(liveReader->handles().size() == static_cast<int>(numberVirtualFiles));
+    QVERIFY(!liveReader->handle(QString("file0.dat")).isValid());
+
+    QByteArray liveData;
+    QVERIFY(liveReader->readVirtualFile(QString("live.dat"), liveData));
+    QVERIFY(liveData == QByteArray(bufferSizeInBytes, 'z'));
+
+    QVERIFY(liveReader->close());
+    delete liveReader;
+
+    // The writer is unaffected by the reader.
+
+    QVERIFY(liveVf->write(QByteArray(bufferSizeInBytes, 'y')) == bufferSizeInBytes);
+    liveVf->close();
+
+    QVERIFY(writeContainer.readVirtualFile(QString("live.dat"), liveData));
+    QVERIFY(liveData == QByteArray(bufferSizeInBytes, 'z') + QByteArray(bufferSizeInBytes, 'y'));
+
+    success = writeContainer.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testStagedWriters() {
+    QFileContainer writeContainer(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = writeContainer.open(QString("test_staged_container.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    // Each producer writes its own virtual file using many small writes.
+
+    QList<QFuture<bool>> futures;
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QVirtualFile* vf = writeContainer.newVirtualFile(QString("file%1.dat").arg(fileIndex)).data();
+        QVERIFY(vf != Q_NULLPTR);
+
+        vf->setStagedWriteSize(4096);
+        QVERIFY(vf->stagedWriteSize() == 4096);
+
+        vf->open(QIODevice::WriteOnly);
+
+        futures.append(QtConcurrent::run([vf, fileIndex]() {
+            bool   result = true;
+            char   data[64];
+            qint64 bytesPerFile = totalBytesAcrossFiles / numberVirtualFiles;
+
+            for (qint64 offset=0 ; result && offset<bytesPerFile ; offset+=sizeof(data)) {
+                for (unsigned i=0 ; i<sizeof(data) ; ++i) {
+                    data[i] = static_cast<char>((offset + i + fileIndex) % 251);
+                }
+
+                result = (vf->write(data, sizeof(data)) == sizeof(data));
+            }
+
+            return result && vf->waitForCommit();
+        }));
+    }
+
+    for (QList<QFuture<bool>>::iterator it=futures.begin() ; it!=futures.end() ; ++it) {
+        QVERIFY(it->result());
+    }
+
+    // Seeks, views and reads observe data that is still staged.
+
+    QPointer<QVirtualFile> stagedVf = writeContainer.newVirtualFile(QString("staged.dat"));
+    QVERIFY(!stagedVf.isNull());
+
+    stagedVf->setStagedWriteSize(4096);
+    stagedVf->open(QIODevice::ReadWrite);
+
+    QVERIFY(stagedVf->write(QByteArray(100, 'a')) == 100);
+    QVERIFY(stagedVf->seek(0));
+    QVERIFY(stagedVf->write(QByteArray(10, 'b')) == 10);
+    QVERIFY(stagedVf->view(0, 100) == QByteArray(10, 'b') + QByteArray(90, 'a'));
+    QVERIFY(stagedVf->pos() == 10);
+    QVERIFY(stagedVf->read(90) == QByteArray(90, 'a'));
+
+    // Vectored and asynchronous writes are ordered after staged data.
+
+    QByteArray vectored(5, 'v');
+
+    QList<QVirtualFile::WriteVector> vectors;
+    vectors.append({ 20, vectored.constData(), vectored.size() });
+
+    QVERIFY(stagedVf->seek(20));
+    QVERIFY(stagedVf->write(QByteArray(10, 'c')) == 10);
+    QVERIFY(stagedVf->writev(vectors) == 5);
+    QVERIFY(stagedVf->write(QByteArray(5, 'd')) == 5);
+    QVERIFY(stagedVf->writeAsync(34, QByteArray(2, 'e')).result() == 2);
+    QVERIFY(stagedVf->view(20, 20) == QByteArray(5, 'v') + QByteArray(5, 'c') + QByteArray(4, 'd') +
+                                      QByteArray(2, 'e') + QByteArray(4, 'a'));
+
+    stagedVf->close();
+
+    success = writeContainer.close();
+    QVERIFY(success);
+
+    QFileContainer readContainer(QString("Inesonic, LLC.\nAion Test"));
+
+    success = readContainer.open(QString("test_staged_container.dat"), QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(success);
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QPointer<QVirtualFile> vf = readContainer.virtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::ReadOnly);
+        QByteArray contents = vf->readAll();
+        vf->close();
+
+        QVERIFY(contents.size() == static_cast<int>(totalBytesAcrossFiles / numberVirtualFiles));
+        for (int i=0 ; i<contents.size() ; ++i) {
+            QVERIFY(contents.at(i) == static_cast<char>((i + fileIndex) % 251));
+        }
+    }
+
+    success = readContainer.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testTransactions() {
+    QFileContainer writeContainer(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = writeContainer.open(QString("test_transaction_container.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    QVERIFY(!writeContainer.inTransaction());
+    QVERIFY(!writeContainer.commitTransaction());
+
+    success = writeContainer.beginTransaction();
+    QVERIFY(success);
+    QVERIFY(writeContainer.inTransaction());
+    QVERIFY(!writeContainer.beginTransaction());
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QPointer<QVirtualFile> vf = writeContainer.newVirtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::WriteOnly);
+        QVERIFY(vf->write(QByteArray(bufferSizeInBytes, static_cast<char>('a' + fileIndex))) == bufferSizeInBytes);
+        vf->close();
+    }
+
+    success = writeContainer.commitTransaction();
+    QVERIFY(success);
+    QVERIFY(!writeContainer.inTransaction());
+
+    // The committed transaction includes the directory so an independent reader sees the new files without the
+    // writer being closed.
+
+    {
+        QFileContainer committedContainer(QString("Inesonic, LLC.\nAion Test"));
+
+        success = committedContainer.open(
+            QString("test_transaction_container.dat"),
+            QFileContainer::OpenMode::READ_ONLY
+        );
+        QVERIFY(success);
+
+        QVERIFY(committedContainer.handles().size() == static_cast<int>(numberVirtualFiles));
+
+        QByteArray data;
+        QVERIFY(committedContainer.readVirtualFile(QString("file1.dat"), data));
+        QVERIFY(data == QByteArray(bufferSizeInBytes, 'b'));
+
+        QVERIFY(committedContainer.close());
+    }
+
+    // Starting a transaction on an unchanged container does not touch the file.
+
+    QFile file(QString("test_transaction_container.dat"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray committed = file.readAll();
+    file.close();
+
+    QVERIFY(writeContainer.beginTransaction());
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QVERIFY(file.readAll() == committed);
+    file.close();
+
+    QVERIFY(writeContainer.rollbackTransaction());
+
+    // Files created in a rolled back transaction must not appear in the directory.
+
+    success = writeContainer.beginTransaction();
+    QVERIFY(success);
+
+    QPointer<QVirtualFile> discarded = writeContainer.newVirtualFile(QString("discarded.dat"));
+    QVERIFY(!discarded.isNull());
+
+    discarded->open(QIODevice::WriteOnly);
+    QVERIFY(discarded->write("discarded", 9) == 9);
+    discarded->close();
+
+    success = writeContainer.rollbackTransaction();
+    QVERIFY(success);
+    QVERIFY(writeContainer.handle(QString("discarded.dat")).isValid() == false);
+
+    success = writeContainer.close();
+    QVERIFY(success);
+
+    QFileContainer readContainer(QString("Inesonic, LLC.\nAion Test"));
+
+    success = readContainer.open(QString("test_transaction_container.dat"), QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(success);
+
+    QVERIFY(readContainer.handles().size() == static_cast<int>(numberVirtualFiles));
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QPointer<QVirtualFile> vf = readContainer.virtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::ReadOnly);
+        QVERIFY(vf->readAll() == QByteArray(bufferSizeInBytes, static_cast<char>('a' + fileIndex)));
+        vf->close();
+    }
+
+    success = readContainer.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testJournal() {
+    QString filename = QString("test_journal_container.dat");
+    QString journal  = QFileContainer::journalFilename(filename);
+
+    QFileContainer writeContainer(QString("Inesonic, LLC.\nAion Test"));
+    writeContainer.setJournalEnabled();
+    QVERIFY(writeContainer.journalEnabled());
+
+    bool success = writeContainer.open(filename, QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+    QVERIFY(QFile::exists(journal));
+
+    QPointer<QVirtualFile> vf = writeContainer.newVirtualFile(QString("base.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::WriteOnly);
+    QVERIFY(vf->write(QByteArray(bufferSizeInBytes, 'b')) == bufferSizeInBytes);
+    vf->close();
+
+    success = writeContainer.beginTransaction();
+    QVERIFY(success);
+
+    // Starting the transaction writes the directory so the file holds the state at the start of the transaction.
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray before = file.readAll();
+    file.close();
+
+    vf = writeContainer.newVirtualFile(QString("journaled.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::WriteOnly);
+    QVERIFY(vf->write(QByteArray(3 * bufferSizeInBytes, 'j')) == 3 * bufferSizeInBytes);
+    vf->close();
+
+    success = writeContainer.commitTransaction();
+    QVERIFY(success);
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray committed = file.readAll();
+    file.close();
+
+    QFile::remove(QString("saved_journal.dat"));
+    QVERIFY(QFile::copy(journal, QString("saved_journal.dat")));
+
+    // Data written outside a transaction checkpoints the journal first so a replay can not overwrite it.
+
+    QVERIFY(QFileInfo(journal).size() > 0);
+
+    vf = writeContainer.virtualFile(QString("base.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::ReadWrite);
+    QVERIFY(vf->write(QByteArray(bufferSizeInBytes, 'u')) == bufferSizeInBytes);
+    vf->close();
+
+    QVERIFY(QFileInfo(journal).size() == 0);
+
+    // Directory updates written outside a transaction, here to open a reader, go through the journal.
+
+    QContainer* reader = writeContainer.openReader();
+    QVERIFY(reader != Q_NULLPTR);
+    QVERIFY(QFileInfo(journal).size() > 0);
+
+    vf = reader->virtualFile(QString("base.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::ReadOnly);
+    QVERIFY(vf->readAll() == QByteArray(bufferSizeInBytes, 'u'));
+    vf->close();
+
+    reader->close();
+    delete reader;
+
+    success = writeContainer.close();
+    QVERIFY(success);
+    QVERIFY(!QFile::exists(journal));
+
+    // Simulate a process that was interrupted after the journal was written, but before the pages reached the
+    // container file.  A partial record at the end of the journal must be ignored.
+
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QVERIFY(file.write(before) == before.size());
+    file.close();
+
+    QVERIFY(QFile::copy(QString("saved_journal.dat"), journal));
+
+    QFile journalFile(journal);
+    QVERIFY(journalFile.open(QIODevice::WriteOnly | QIODevice::Append));
+    QVERIFY(journalFile.write(QByteArray(20, 'x')) == 20);
+    journalFile.close();
+
+    success = QFileContainer::replayJournal(filename);
+    QVERIFY(success);
+    QVERIFY(!QFile::exists(journal));
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QVERIFY(file.readAll() == committed);
+    file.close();
+
+    // A read-only open must not modify the file, so it is refused until the journal is replayed by a writer.
+
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QVERIFY(file.write(before) == before.size());
+    file.close();
+
+    QVERIFY(QFile::copy(QString("saved_journal.dat"), journal));
+
+    QFileContainer readContainer(QString("Inesonic, LLC.\nAion Test"));
+    success = readContainer.open(filename, QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(!success);
+    QVERIFY(QFile::exists(journal));
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QVERIFY(file.readAll() == before);
+    file.close();
+
+    success = readContainer.open(filename, QFileContainer::OpenMode::READ_WRITE);
+    QVERIFY(success);
+    QVERIFY(!QFile::exists(journal));
+    QVERIFY(!readContainer.virtualFile(QString("journaled.dat")).isNull());
+
+    success = readContainer.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testCompaction() {
+    QFileContainer container(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = container.open(QString("test_compact_container.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QPointer<QVirtualFile> vf = container.newVirtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::WriteOnly);
+        QVERIFY(vf->write(QByteArray(bufferSizeInBytes, static_cast<char>('a' + fileIndex))) == bufferSizeInBytes);
+        vf->close();
+    }
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; fileIndex+=2) {
+        QVERIFY(container.handle(QString("file%1.dat").arg(fileIndex)).erase());
+    }
+
+    unsigned long long sizeBefore = container.statistics().totalSize;
+
+    unsigned steps = 0;
+    do {
+        success = container.compactStep(bufferSizeInBytes);
+        QVERIFY(success);
+
+        ++steps;
+    } while (!container.compactionComplete());
+
+    QVERIFY(steps > 1);
+    QVERIFY(container.statistics().totalSize < sizeBefore);
+
+    success = container.close();
+    QVERIFY(success);
+
+    success = container.open(QString("test_compact_container.dat"), QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(success);
+
+    QVERIFY(container.handles().size() == static_cast<int>(numberVirtualFiles / 2));
+
+    for (unsigned fileIndex=1 ; fileIndex<numberVirtualFiles ; fileIndex+=2) {
+        QPointer<QVirtualFile> vf = container.virtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::ReadOnly);
+        QVERIFY(vf->readAll() == QByteArray(bufferSizeInBytes, static_cast<char>('a' + fileIndex)));
+        vf->close();
+    }
+
+    success = container.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testCompactionRecovery() {
+    QString filename = QString("test_compaction_recovery.dat");
+
+    // Build the directory left by a process that ended part way through two moves.  The first move was copying
+    // lost.dat back from its hidden copy.  The second move was still copying kept.dat to its hidden copy.
+
+    QFileContainer writeContainer(QString("Inesonic, LLC.\nAion Test"));
+    bool success = writeContainer.open(filename, QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    QMap<QString, QByteArray> files;
+    files.insert(QString(".ineqcontainer/compaction/lost.dat"), QByteArray(bufferSizeInBytes, 'L'));
+    files.insert(QString(".ineqcontainer/restore/lost.dat"), QByteArray());
+    files.insert(QString("lost.dat"), QByteArray(bufferSizeInBytes / 2, 'p'));
+    files.insert(QString(".ineqcontainer/compaction/kept.dat"), QByteArray(bufferSizeInBytes / 2, 'x'));
+    files.insert(QString("kept.dat"), QByteArray(bufferSizeInBytes, 'k'));
+
+    for (QMap<QString, QByteArray>::const_iterator it=files.constBegin() ; it!=files.constEnd() ; ++it) {
+        QPointer<QVirtualFile> vf = writeContainer.newVirtualFile(it.key());
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::WriteOnly);
+        QVERIFY(vf->write(it.value()) == it.value().size());
+        vf->close();
+    }
+
+    success = writeContainer.close();
+    QVERIFY(success);
+
+    // A read-only open uses the hidden copy in place of the partly restored file and exposes no hidden files.
+
+    QFileContainer readContainer(QString("Inesonic, LLC.\nAion Test"));
+    success = readContainer.open(filename, QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(success);
+
+    QVERIFY(readContainer.handles().size() == 2);
+
+    QPointer<QVirtualFile> vf = readContainer.virtualFile(QString("lost.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::ReadOnly);
+    QVERIFY(vf->readAll() == QByteArray(bufferSizeInBytes, 'L'));
+    vf->close();
+
+    success = readContainer.close();
+    QVERIFY(success);
+
+    // A writable open completes the interrupted copy back and discards the unfinished copy.
+
+    QFileContainer container(QString("Inesonic, LLC.\nAion Test"));
+    success = container.open(filename, QFileContainer::OpenMode::READ_WRITE);
+    QVERIFY(success);
+
+    ::Container::Container::DirectoryMap directory = container.::Container::Container::directory();
+    QVERIFY(directory.size() == 2);
+    QVERIFY(directory.find("lost.dat") != directory.end());
+    QVERIFY(directory.find("kept.dat") != directory.end());
+
+    success = container.close();
+    QVERIFY(success);
+
+    success = container.open(filename, QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(success);
+
+    vf = container.virtualFile(QString("lost.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::ReadOnly);
+    QVERIFY(vf->readAll() == QByteArray(bufferSizeInBytes, 'L'));
+    vf->close();
+
+    vf = container.virtualFile(QString("kept.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::ReadOnly);
+    QVERIFY(vf->readAll() == QByteArray(bufferSizeInBytes, 'k'));
+    vf->close();
+
+    success = container.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testStatistics() {
+    QFileContainer container(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = container.open(QString("test_statistics_container.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QPointer<QVirtualFile> vf = container.newVirtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::WriteOnly);
+        QVERIFY(vf->write(QByteArray(bufferSizeInBytes, 'a')) == bufferSizeInBytes);
+        vf->close();
+    }
+
+    QContainer::Statistics statistics = container.statistics();
+    QVERIFY(statistics.fileSizes.size() == static_cast<int>(numberVirtualFiles));
+    QVERIFY(statistics.fileSizes.value(QString("file0.dat")) == bufferSizeInBytes);
+    QVERIFY(statistics.liveSize == numberVirtualFiles * bufferSizeInBytes);
+    QVERIFY(statistics.totalSize >= statistics.liveSize);
+    QVERIFY(statistics.slackSize == statistics.totalSize - statistics.liveSize);
+    QVERIFY(statistics.slackRatio >= 0.0 && statistics.slackRatio < 1.0);
+
+    QVERIFY(container.handle(QString("file0.dat")).erase());
+
+    statistics = container.statistics();
+    QVERIFY(statistics.fileSizes.size() == static_cast<int>(numberVirtualFiles - 1));
+    QVERIFY(statistics.liveSize == (numberVirtualFiles - 1) * bufferSizeInBytes);
+
+    success = container.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testSnapshots() {
+    QFileContainer container(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = container.open(QString("test_snapshot_container.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QPointer<QVirtualFile> vf = container.newVirtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::WriteOnly);
+        QVERIFY(vf->write(QByteArray(bufferSizeInBytes, static_cast<char>('a' + fileIndex))) == bufferSizeInBytes);
+        vf->close();
+    }
+
+    success = container.close();
+    QVERIFY(success);
+
+    success = container.open(QString("test_snapshot_container.dat"), QFileContainer::OpenMode::READ_WRITE);
+    QVERIFY(success);
+
+    QContainer* snapshot = container.snapshot();
+    QVERIFY(snapshot != Q_NULLPTR);
+
+    // Rewrite every file after the snapshot is taken.  The snapshot must continue to see the original contents.
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QPointer<QVirtualFile> vf = container.virtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::ReadWrite);
+        QVERIFY(vf->write(QByteArray(bufferSizeInBytes, 'z')) == bufferSizeInBytes);
+        vf->close();
+    }
+
+    success = container.close();
+    QVERIFY(success);
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QPointer<QVirtualFile> vf = snapshot->virtualFile(QString("file%1.dat").arg(fileIndex));
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::ReadOnly);
+        QVERIFY(vf->readAll() == QByteArray(bufferSizeInBytes, static_cast<char>('a' + fileIndex)));
+        vf->close();
+    }
+
+    success = snapshot->close();
+    QVERIFY(success);
+
+    delete snapshot;
+
+    // Files created and erased since the container was opened must be reflected by a snapshot without a close.
+
+    success = container.open(QString("test_snapshot_container.dat"), QFileContainer::OpenMode::READ_WRITE);
+    QVERIFY(success);
+
+    QVERIFY(container.handle(QString("file0.dat")).erase());
+
+    QPointer<QVirtualFile> created = container.newVirtualFile(QString("created.dat"));
+    QVERIFY(!created.isNull());
+
+    created->open(QIODevice::WriteOnly);
+    QVERIFY(created->write(QByteArray(bufferSizeInBytes, 'c')) == bufferSizeInBytes);
+    created->close();
+
+    snapshot = container.snapshot();
+    QVERIFY(snapshot != Q_NULLPTR);
+
+    QVERIFY(!snapshot->handle(QString("file0.dat")).isValid());
+    QVERIFY(snapshot->handles().size() == static_cast<int>(numberVirtualFiles));
+
+    QPointer<QVirtualFile> vf = snapshot->virtualFile(QString("created.dat"));
+    QVERIFY(!vf.isNull());
+
+    vf->open(QIODevice::ReadOnly);
+    QVERIFY(vf->readAll() == QByteArray(bufferSizeInBytes, 'c'));
+    vf->close();
+
+    success = snapshot->close();
+    QVERIFY(success);
+
+    delete snapshot;
+
+    success = container.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testBulkImport() {
+    QDir sourceDirectory(QString("test_import_source"));
+    QVERIFY(sourceDirectory.mkpath(QString("nested")));
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QString filename = fileIndex % 2 ? QString("nested/file%1.dat") : QString("file%1.dat");
+        QFile   file(sourceDirectory.filePath(filename.arg(fileIndex)));
+
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        QVERIFY(file.write(QByteArray(bufferSizeInBytes, static_cast<char>('a' + fileIndex))) == bufferSizeInBytes);
+        file.close();
+    }
+
+    QFileContainer container(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = container.open(QString("test_import_container.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    QContainerImporter importer(&container);
+    importer.setThreadCount(2);
+    importer.setMaximumPendingFiles(2);
+
+    success = importer.importDirectory(sourceDirectory.absolutePath());
+    QVERIFY(success);
+    QVERIFY(importer.filesImported() == numberVirtualFiles);
+    QVERIFY(importer.bytesImported() == numberVirtualFiles * bufferSizeInBytes);
+
+    importer.setCompressionEnabled();
+    success = importer.importDirectory(sourceDirectory.absolutePath(), QString("compressed/"));
+    QVERIFY(success);
+
+    success = container.close();
+    QVERIFY(success);
+
+    success = container.open(QString("test_import_container.dat"), QFileContainer::OpenMode::READ_ONLY);
+    QVERIFY(success);
+
+    // The compressed files are listed in the manifest, which is a metadata file that is not listed itself.
+
+    QVERIFY(container.handles().size() == static_cast<int>(2 * numberVirtualFiles));
+    QVERIFY(container.directory().size() == static_cast<int>(2 * numberVirtualFiles));
+    QVERIFY(container.glob(QString("*")).size() == static_cast<int>(2 * numberVirtualFiles));
+    QVERIFY(!container.handle(QString(QContainerImporter::compressionManifestName)).isValid());
+    QVERIFY(!container.virtualFile(QString(QContainerImporter::compressionManifestName)).isNull());
+
+    QSet<QString> compressedNames = QContainerImporter::compressedVirtualFiles(&container);
+    QVERIFY(compressedNames.size() == static_cast<int>(numberVirtualFiles));
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QString    filename = (fileIndex % 2 ? QString("nested/file%1.dat") : QString("file%1.dat")).arg(fileIndex);
+        QByteArray expected(bufferSizeInBytes, static_cast<char>('a' + fileIndex));
+
+        QPointer<QVirtualFile> vf = container.virtualFile(filename);
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::ReadOnly);
+        QVERIFY(vf->readAll() == expected);
+        vf->close();
+
+        QVERIFY(!compressedNames.contains(filename));
+        QVERIFY(compressedNames.contains(QString("compressed/") + filename));
+
+        vf = container.virtualFile(QString("compressed/") + filename);
+        QVERIFY(!vf.isNull());
+
+        vf->open(QIODevice::ReadOnly);
+        QByteArray stored = vf->readAll();
+        vf->close();
+
+        QVERIFY(stored.size() > 4);
+        QVERIFY(qFromLittleEndian<quint32>(stored.constData()) == static_cast<quint32>(stored.size() - 4));
+        QVERIFY(qUncompress(stored.mid(4)) == expected);
+    }
+
+    success = container.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testBulkExtract() {
+    QFileContainer container(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = container.open(QString("test_extract_container.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    QDir sourceDirectory(QString("test_extract_source"));
+    QVERIFY(sourceDirectory.mkpath(QString("nested")));
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QString    filename = (fileIndex % 2 ? QString("nested/file%1.dat") : QString("file%1.dat")).arg(fileIndex);
+        QByteArray contents(bufferSizeInBytes, static_cast<char>('a' + fileIndex));
+
+        QVERIFY(container.writeVirtualFile(QString("plain/") + filename, contents));
+
+        QFile file(sourceDirectory.filePath(filename));
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        QVERIFY(file.write(contents) == bufferSizeInBytes);
+        file.close();
+    }
+
+    // A file spanning several chunks is imported, compressed, one chunk at a time.
+
+    QByteArray largeContents(static_cast<int>(QContainerImporter::sourceChunkSize + bufferSizeInBytes), '\0');
+    for (int index=0 ; index<largeContents.size() ; ++index) {
+        largeContents[index] = static_cast<char>(index * 7 + index / 4096);
+    }
+
+    QFile largeFile(sourceDirectory.filePath(QString("large.dat")));
+    QVERIFY(largeFile.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QVERIFY(largeFile.write(largeContents) == largeContents.size());
+    largeFile.close();
+
+    QContainerImporter importer(&container);
+    importer.setCompressionEnabled();
+    importer.setMaximumPendingFiles(2);
+
+    success = importer.importDirectory(sourceDirectory.absolutePath(), QString("compressed/"));
+    QVERIFY(success);
+    QVERIFY(importer.filesImported() == numberVirtualFiles + 1);
+
+    QByteArray contents;
+    QVERIFY(container.readVirtualFile(QString("plain/file0.dat"), contents));
+    QVERIFY(contents == QByteArray(bufferSizeInBytes, 'a'));
+
+    QContainerExtractor extractor(&container);
+    extractor.setThreadCount(2);
+    extractor.setMaximumPendingFiles(2);
+
+    success = extractor.extractDirectory(QString("test_extract_output/plain"), QString("plain/"));
+    QVERIFY(success);
+    QVERIFY(extractor.filesExtracted() == numberVirtualFiles);
+    QVERIFY(extractor.bytesExtracted() == numberVirtualFiles * bufferSizeInBytes);
+
+    // Compressed files are detected from the manifest and the manifest itself is not extracted.
+
+    success = extractor.extractDirectory(QString("test_extract_output/compressed"), QString("compressed/"));
+    QVERIFY(success);
+    QVERIFY(extractor.filesExtracted() == numberVirtualFiles + 1);
+    QVERIFY(extractor.bytesExtracted() == numberVirtualFiles * bufferSizeInBytes + largeContents.size());
+
+    success = extractor.extractDirectory(QString("test_extract_output/all"));
+    QVERIFY(success);
+    QVERIFY(!QFileInfo(QString("test_extract_output/all/.ineqcontainer")).exists());
+
+    QFile largeOutput(QString("test_extract_output/compressed/large.dat"));
+    QVERIFY(largeOutput.open(QIODevice::ReadOnly));
+    QVERIFY(largeOutput.readAll() == largeContents);
+    largeOutput.close();
+
+    for (unsigned fileIndex=0 ; fileIndex<numberVirtualFiles ; ++fileIndex) {
+        QString    filename = (fileIndex % 2 ? QString("nested/file%1.dat") : QString("file%1.dat")).arg(fileIndex);
+        QByteArray expected(bufferSizeInBytes, static_cast<char>('a' + fileIndex));
+
+        QFile plainFile(QString("test_extract_output/plain/") + filename);
+        QVERIFY(plainFile.open(QIODevice::ReadOnly));
+        QVERIFY(plainFile.readAll() == expected);
+        plainFile.close();
+
+        QFile decompressedFile(QString("test_extract_output/compressed/") + filename);
+        QVERIFY(decompressedFile.open(QIODevice::ReadOnly));
+        QVERIFY(decompressedFile.readAll() == expected);
+        decompressedFile.close();
+    }
+
+    // Uncompressed files larger than a chunk are streamed in pieces rather than read whole.
+
+    QVERIFY(container.writeVirtualFile(QString("streamed/large.dat"), largeContents));
+
+    QByteArray range;
+    QVERIFY(container.readVirtualFile(QString("streamed/large.dat"), bufferSizeInBytes, bufferSizeInBytes, range));
+    QVERIFY(range == largeContents.mid(bufferSizeInBytes, bufferSizeInBytes));
+
+    QVERIFY(container.readVirtualFile(QString("streamed/large.dat"), largeContents.size() - 1, 16, range));
+    QVERIFY(range == largeContents.right(1));
+
+    QVERIFY(container.storageOffset(QString("streamed/missing.dat")) == ~0ULL);
+
+    success = extractor.extractDirectory(QString("test_extract_output/streamed"), QString("streamed/"));
+    QVERIFY(success);
+    QVERIFY(extractor.filesExtracted() == 1);
+    QVERIFY(extractor.bytesExtracted() == static_cast<unsigned long long>(largeContents.size()));
+
+    QFile streamedOutput(QString("test_extract_output/streamed/large.dat"));
+    QVERIFY(streamedOutput.open(QIODevice::ReadOnly));
+    QVERIFY(streamedOutput.readAll() == largeContents);
+    streamedOutput.close();
+
+    // Names that resolve outside of the output directory must be rejected.
+
+    QVERIFY(container.writeVirtualFile(QString("unsafe/../../escaped.dat"), QByteArray("x")));
+    QVERIFY(!extractor.extractDirectory(QString("test_extract_output/unsafe"), QString("unsafe/")));
+
+    success = container.close();
+    QVERIFY(success);
+}
+
+
+void TestQFileContainer::testCopyVirtualFile() {
+    QFileContainer source(QString("Inesonic, LLC.\nAion Test"));
+    QFileContainer destination(QString("Inesonic, LLC.\nAion Test"));
+
+    bool success = source.open(QString("test_copy_source.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    success = destination.open(QString("test_copy_destination.dat"), QFileContainer::OpenMode::OVERWRITE);
+    QVERIFY(success);
+
+    // Larger than a single copy chunk so the chunked path is exercised.
+
+    QByteArray contents(40 * bufferSizeInBytes, '\0');
+    for (int index=0 ; index<contents.size() ; ++index) {
+        contents[index] = static_cast<char>(index * 7);
+    }
+
+    QVERIFY(source.writeVirtualFile(QString("original.dat"), contents));
+
+    QVERIFY(source.copyVirtualFile(QString("original.dat"), &destination, QString("copy.dat")));
+    QVERIFY(source.duplicateVirtualFile(QString("original.dat"), QString("clone.dat")));
+    QVERIFY(!source.duplicateVirtualFile(QString("original.dat"), QString("original.dat")));
+    QVERIFY(!source.copyVirtualFile(QString("missing.dat"), &destination, QString("missing.dat")));
+
+    QByteArray copied;
+    QVERIFY(destination.readVirtualFile(QString("copy.dat"), copied));
+    QVERIFY(copied == contents);
+
+    QByteArray cloned;
+    QVERIFY(source.readVirtualFile(QString("clone.dat"), cloned));
+    QVERIFY(cloned == contents);
+
+    // Data still staged by an open device must be committed before the file is read or copied.
+
+    QPointer<QVirtualFile> stagedVf = source.newVirtualFile(QString("staged.dat"));
+    QVERIFY(!stagedVf.isNull());
+
+    stagedVf->setStagedWriteSize(4096);
+    stagedVf->open(QIODevice::WriteOnly);
+    QVERIFY(stagedVf->write(QByteArray(100, 's')) == 100);
+
+    QByteArray staged;
+    QVERIFY(source.readVirtualFile(QString("staged.dat"), staged));
+    QVERIFY(staged == QByteArray(100, 's'));
+
+    QVERIFY(stagedVf->write(QByteArray(100, 't')) == 100);
+    QVERIFY(source.duplicateVirtualFile(QString("staged.dat"), QString("staged_clone.dat")));
+
+    stagedVf->close();
+
+    QVERIFY(source.readVirtualFile(QString("staged_clone.dat"), staged));
+    QVERIFY(staged == QByteArray(100, 's') + QByteArray(100, 't'));
+
+    success = destination.close();
+    QVERIFY(success);
+
+    success = source.close();
+    QVERIFY(success);
+}
@@ -31,6 +31,18 @@ class TestQFileContainer:public QObject {
 
     private slots:
         void testQFileContainerApi();
+        void testLazyOpen();
+        void testConcurrentReaders();
+        void testStagedWriters();
+        void testTransactions();
+        void testJournal();
+        void testCompaction();
+        void testCompactionRecovery();
+        void testStatistics();
+        void testSnapshots();
+        void testBulkImport();
+        void testBulkExtract();
+        void testCopyVirtualFile();
 
     private:
         static constexpr unsigned bufferSizeInBytes     = 65536;